@@ -0,0 +1,32 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: bench.h
+ * funx: micro benchmark of tstools libraries
+ */
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h> /* for uintN_t, etc */
+#include <stddef.h> /* for size_t, etc */
+
+/* each bench prints its result to stdout
+ * return: 0 if the result of the code under test is right, -1 if not */
+typedef int (*bench_func)(void);
+
+int bench_crc(void); /* ts_crc() of libzts */
+int bench_hex(void); /* b2t() and next_nbyte_hex() of libzutil */
+int bench_line(void); /* next_tag_id() of libzutil, for catts line */
+int bench_mp(void); /* buddy_create_mt() of libzbuddy */
+
+double bench_now(void); /* monotonic time(s) */
+void bench_fill(uint8_t *buf, size_t size, uint32_t seed); /* pseudo random data */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BENCH_H */
@@ -0,0 +1,101 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: bench_crc.c
+ * funx: ts_crc() against bit by bit CRC
+ */
+
+#include <stdio.h>
+#include <stdint.h> /* for uintN_t, etc */
+
+#include "ts.h"
+#include "bench.h"
+
+#define BUF_SIZE        (8192)
+#define LEN_MAX         (1200) /* check each length up to */
+#define BYTE_PER_SIZE   (200 * 1000 * 1000) /* data for each size of ts_crc() */
+
+/* MSB first, init with all '1', no final xor, one bit each time, as the old ts_crc() */
+static uint32_t crc_bit(const uint8_t *p, size_t size, int mode)
+{
+        uint32_t poly;
+        uint32_t mask;
+        uint32_t top;
+        uint32_t crc;
+        int k;
+
+        switch(mode) {
+                case 8: poly = 0x07; break;
+                case 16: poly = 0x9001; break;
+                default: mode = 32; poly = 0x04C11DB7; break;
+        }
+        top = (uint32_t)1 << (mode - 1);
+        mask = top | (top - 1);
+
+        crc = mask;
+        for(; size; size--, p++) {
+                for(k = 7; k >= 0; k--) {
+                        if((!!(crc & top)) ^ ((*p >> k) & 1)) {
+                                crc = ((crc << 1) ^ poly) & mask;
+                        }
+                        else {
+                                crc = (crc << 1) & mask;
+                        }
+                }
+        }
+        return crc;
+}
+
+int bench_crc(void)
+{
+        static uint8_t buf[BUF_SIZE];
+        static const size_t sizes[] = {12, 184, 1024, 4093};
+        static const int modes[] = {8, 16, 32};
+        volatile uint32_t sink = 0;
+        size_t len;
+        size_t off;
+        double t0;
+        double t1;
+        double t2;
+        long cnt;
+        long k;
+        int bad = 0;
+        int i;
+
+        bench_fill(buf, BUF_SIZE, 0x1234);
+
+        /* each mode, each length, unaligned too */
+        for(i = 0; i < 3; i++) {
+                for(len = 0; len <= LEN_MAX; len++) {
+                        for(off = 0; off < 5; off++) {
+                                if(crc_bit(buf + off, len, modes[i]) != ts_crc(buf + off, len, modes[i])) {
+                                        bad++;
+                                }
+                        }
+                }
+        }
+        for(len = BUF_SIZE - 200; len <= BUF_SIZE - 3; len++) {
+                if(crc_bit(buf + 3, len, 32) != ts_crc(buf + 3, len, 32)) {
+                        bad++;
+                }
+        }
+        fprintf(stdout, "*check, CRC-8/16/32, %d, bad, %d, \n", 3 * (LEN_MAX + 1) * 5 + 198, bad);
+
+        for(i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+                cnt = BYTE_PER_SIZE / sizes[i];
+
+                t0 = bench_now();
+                for(k = 0; k < cnt / 100; k++) {
+                        sink ^= crc_bit(buf, sizes[i], 32);
+                }
+                t1 = bench_now();
+                for(k = 0; k < cnt; k++) {
+                        sink ^= ts_crc(buf, sizes[i], 32);
+                }
+                t2 = bench_now();
+
+                fprintf(stdout, "*crc32, %zu, *bit, %.1f, *ts_crc, %.1f, MB/s\n",
+                        sizes[i],
+                        sizes[i] * (cnt / 100) / (t1 - t0) / 1e6,
+                        sizes[i] * cnt / (t2 - t1) / 1e6);
+        }
+        return (bad ? -1 : 0);
+}
@@ -0,0 +1,194 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: bench_hex.c
+ * funx: b2t() and next_nbyte_hex() against byte by byte hex convert
+ */
+
+#include <stdio.h>
+#include <string.h> /* for strcmp(), etc */
+#include <stdint.h> /* for uintN_t, etc */
+
+#include "if.h"
+#include "bench.h"
+
+#define LEN_MAX         (300) /* check each length up to */
+#define CHECK_CNT       (200000) /* random line with bad char for next_nbyte_hex() */
+#define BYTE_PER_SIZE   (400 * 1000 * 1000) /* data for each size */
+
+static const char hex_char[] = "0123456789ABCDEF";
+
+/* xorshift32 */
+static uint32_t next_rnd(uint32_t *x)
+{
+        *x ^= *x << 13;
+        *x ^= *x >> 17;
+        *x ^= *x << 5;
+        return *x;
+}
+
+/* "XX XX ... XX, \0" one byte each time, as the old b2t() */
+static void ref_b2t(char *dst, const uint8_t *src, int len)
+{
+        int i;
+
+        for(i = 0; i < len; i++) {
+                *dst++ = hex_char[src[i] >> 4];
+                *dst++ = hex_char[src[i] & 0x0F];
+                *dst++ = ((i == len - 1) ? ',' : ' ');
+        }
+        *dst++ = ' ';
+        *dst = '\0';
+}
+
+static uint8_t ref_nibble(uint8_t c)
+{
+        if('0' <= c && c <= '9') {
+                return c - '0';
+        }
+        if('A' <= c && c <= 'F') {
+                return c - 'A' + 10;
+        }
+        if('a' <= c && c <= 'f') {
+                return c - 'a' + 10;
+        }
+        return 0; /* the same as t2b_table */
+}
+
+/* " XX XX ... XX,?" one byte each time, as the old next_nbyte_hex() */
+static int ref_t2b(uint8_t *byte, char **text, int max)
+{
+        char *p = *text;
+        int cnt;
+
+        for(cnt = 0; cnt < max; cnt++) {
+                uint8_t s = p[0];
+                uint8_t h;
+                uint8_t l;
+
+                if('\0' == s || 0x0A == s || 0x0D == s) {
+                        break;
+                }
+                if(',' == s) {
+                        p++;
+                        break;
+                }
+                h = p[1];
+                if('\0' == h || 0x0A == h || 0x0D == h) {
+                        p += 1;
+                        break;
+                }
+                l = p[2];
+                if('\0' == l || 0x0A == l || 0x0D == l) {
+                        p += 2;
+                        break;
+                }
+                p += 3;
+                *byte++ = (ref_nibble(h) << 4) | ref_nibble(l);
+        }
+        *text = p;
+        return cnt;
+}
+
+int bench_hex(void)
+{
+        static uint8_t buf[LEN_MAX + 16];
+        static uint8_t out0[LEN_MAX + 16];
+        static uint8_t out1[LEN_MAX + 16];
+        static char txt0[LEN_MAX * 3 + 16];
+        static char txt1[LEN_MAX * 3 + 16];
+        static const char bad_char[] = ",\n\r\0aGg@` \x80\xC1\x30\x10";
+        static const int sizes[] = {16, 24, 32, 48, 188, 204};
+        volatile uint32_t sink = 0;
+        uint32_t rnd = 0x5678;
+        char *p0;
+        char *p1;
+        double t0;
+        double t1;
+        double t2;
+        long cnt;
+        long k;
+        int len;
+        int max;
+        int n0;
+        int n1;
+        int bad = 0;
+        int i;
+        int j;
+
+        /* b2t() of each length */
+        for(len = 1; len <= LEN_MAX; len++) {
+                bench_fill(buf, len, len);
+                b2t(txt0, buf, len);
+                ref_b2t(txt1, buf, len);
+                if(0 != strcmp(txt0, txt1)) {
+                        bad++;
+                }
+        }
+
+        /* next_nbyte_hex() of good line, and line with bad char at random place */
+        for(i = 0; i < CHECK_CNT; i++) {
+                len = 1 + next_rnd(&rnd) % LEN_MAX;
+                bench_fill(buf, len, rnd);
+                b2t(txt0, buf, len);
+                if(i & 1) {
+                        int tlen = (int)strlen(txt0);
+
+                        for(j = next_rnd(&rnd) % 4; j >= 0; j--) {
+                                txt0[next_rnd(&rnd) % (tlen + 1)] = bad_char[next_rnd(&rnd) % (sizeof(bad_char) - 1)];
+                        }
+                }
+                memcpy(txt1, txt0, sizeof(txt0));
+                memset(out0, 0xAA, sizeof(out0));
+                memset(out1, 0xAA, sizeof(out1));
+                max = (i & 2) ? len : (int)(next_rnd(&rnd) % (len + 5));
+
+                p0 = txt0;
+                p1 = txt1;
+                n0 = next_nbyte_hex(out0, &p0, max);
+                n1 = ref_t2b(out1, &p1, max);
+                if(n0 != n1 || (p0 - txt0) != (p1 - txt1) || 0 != memcmp(out0, out1, sizeof(out0))) {
+                        bad++;
+                }
+        }
+        fprintf(stdout, "*check, b2t and next_nbyte_hex, %d, bad, %d, \n", LEN_MAX + CHECK_CNT, bad);
+
+        for(i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+                cnt = BYTE_PER_SIZE / sizes[i];
+                bench_fill(buf, sizes[i], 0x9ABC);
+
+                t0 = bench_now();
+                for(k = 0; k < cnt / 10; k++) {
+                        buf[0] = (uint8_t)k;
+                        ref_b2t(txt1, buf, sizes[i]);
+                        sink += txt1[1];
+                }
+                t1 = bench_now();
+                for(k = 0; k < cnt; k++) {
+                        buf[0] = (uint8_t)k;
+                        b2t(txt0, buf, sizes[i]);
+                        sink += txt0[1];
+                }
+                t2 = bench_now();
+                fprintf(stdout, "*b2t, %d, *byte, %.1f, *b2t, %.1f, MB/s\n",
+                        sizes[i],
+                        sizes[i] * (cnt / 10) / (t1 - t0) / 1e6,
+                        sizes[i] * cnt / (t2 - t1) / 1e6);
+
+                /* txt0 is the line of buf now */
+                t0 = bench_now();
+                for(k = 0; k < cnt / 10; k++) {
+                        p1 = txt0;
+                        sink += ref_t2b(out1, &p1, sizes[i]);
+                }
+                t1 = bench_now();
+                for(k = 0; k < cnt; k++) {
+                        p0 = txt0;
+                        sink += next_nbyte_hex(out0, &p0, sizes[i]);
+                }
+                t2 = bench_now();
+                fprintf(stdout, "*t2b, %d, *byte, %.1f, *next_nbyte_hex, %.1f, MB/s\n",
+                        sizes[i],
+                        sizes[i] * (cnt / 10) / (t1 - t0) / 1e6,
+                        sizes[i] * cnt / (t2 - t1) / 1e6);
+        }
+        return (bad ? -1 : 0);
+}
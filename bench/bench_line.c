@@ -0,0 +1,154 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: bench_line.c
+ * funx: parse catts text line, next_tag_id() against next_tag() and strcmp()
+ */
+
+#include <stdio.h>
+#include <string.h> /* for strcmp(), etc */
+#include <stdint.h> /* for uintN_t, etc */
+
+#include "if.h"
+#include "bench.h"
+
+#define LINE_CNT        (4096) /* different line in memory */
+#define LINE_SIZE       (188 * 3 + 64)
+#define PARSE_CNT       (4 * 1000 * 1000) /* line parsed for each way */
+
+/* what a line gives, as struct ts_ipt of tsana */
+struct line_ipt {
+        uint8_t TS[188];
+        long long int ADDR;
+        long long int MTS;
+        int has; /* IF_HAS_xxx */
+};
+
+/* tag by next_tag() and strcmp(), as tsana before next_tag_id() */
+static void parse_old(struct line_ipt *ipt, char *pt)
+{
+        char *tag;
+
+        ipt->has = 0;
+        while(0 == next_tag(&tag, &pt)) {
+                if(0 == strcmp(tag, "*ts")) {
+                        next_nbyte_hex(ipt->TS, &pt, 188);
+                        ipt->has |= IF_HAS_TS;
+                }
+                else if(0 == strcmp(tag, "*rs")) {
+                        uint8_t RS[16];
+
+                        next_nbyte_hex(RS, &pt, 16);
+                        ipt->has |= IF_HAS_RS;
+                }
+                else if(0 == strcmp(tag, "*addr")) {
+                        next_nuint_hex(&(ipt->ADDR), &pt, 1);
+                        ipt->has |= IF_HAS_ADDR;
+                }
+                else if(0 == strcmp(tag, "*mts")) {
+                        next_nuint_hex(&(ipt->MTS), &pt, 1);
+                        ipt->has |= IF_HAS_MTS;
+                }
+                else if(0 == strcmp(tag, "*cts")) {
+                        long long int CTS;
+
+                        next_nuint_hex(&CTS, &pt, 1);
+                        ipt->has |= IF_HAS_CTS;
+                }
+        }
+}
+
+/* tag by next_tag_id(), as tsana now */
+static void parse_new(struct line_ipt *ipt, char *pt)
+{
+        uint8_t RS[16];
+        long long int CTS;
+
+        ipt->has = 0;
+        while(1) {
+                switch(next_tag_id(&pt)) {
+                        case IF_TAG_TS:
+                                next_nbyte_hex(ipt->TS, &pt, 188);
+                                ipt->has |= IF_HAS_TS;
+                                break;
+                        case IF_TAG_RS:
+                                next_nbyte_hex(RS, &pt, 16);
+                                ipt->has |= IF_HAS_RS;
+                                break;
+                        case IF_TAG_ADDR:
+                                next_nuint_hex(&(ipt->ADDR), &pt, 1);
+                                ipt->has |= IF_HAS_ADDR;
+                                break;
+                        case IF_TAG_MTS:
+                                next_nuint_hex(&(ipt->MTS), &pt, 1);
+                                ipt->has |= IF_HAS_MTS;
+                                break;
+                        case IF_TAG_CTS:
+                                next_nuint_hex(&CTS, &pt, 1);
+                                ipt->has |= IF_HAS_CTS;
+                                break;
+                        case IF_TAG_BAD:
+                                break; /* skip it */
+                        default: /* IF_TAG_EOL */
+                                return;
+                }
+        }
+}
+
+int bench_line(void)
+{
+        static char line[LINE_CNT][LINE_SIZE];
+        static char tbuf[LINE_SIZE]; /* line got by fgets() */
+        static char tbak[LINE_SIZE]; /* line for -dump */
+        struct line_ipt ipt0;
+        struct line_ipt ipt1;
+        uint8_t TS[188];
+        char *p;
+        double t0;
+        double t1;
+        double t2;
+        long k;
+        int bad = 0;
+        int i;
+
+        /* the same format as catts, with color tag in some line */
+        for(i = 0; i < LINE_CNT; i++) {
+                bench_fill(TS, 188, i + 1);
+                TS[0] = 0x47;
+                p = line[i];
+                p += sprintf(p, "%s", ((i % 64) ? "*ts, " : "*ts\033[0m, "));
+                b2t(p, TS, 188);
+                p += strlen(p);
+                sprintf(p, "*addr, %X, *mts, %X, \n", i * 188, i * 4);
+        }
+
+        for(i = 0; i < LINE_CNT; i++) {
+                strcpy(tbuf, line[i]);
+                parse_old(&ipt0, tbuf);
+                strcpy(tbuf, line[i]);
+                parse_new(&ipt1, tbuf);
+                if(ipt0.has != ipt1.has || 0 != memcmp(ipt0.TS, ipt1.TS, 188) ||
+                   ipt0.ADDR != ipt1.ADDR || ipt0.MTS != ipt1.MTS ||
+                   (IF_HAS_TS | IF_HAS_ADDR | IF_HAS_MTS) != ipt1.has) {
+                        bad++;
+                }
+        }
+        fprintf(stdout, "*check, next_tag_id, %d, bad, %d, \n", LINE_CNT, bad);
+
+        /* line copy of fgets() is counted, old way copied each line for -dump too */
+        t0 = bench_now();
+        for(k = 0; k < PARSE_CNT; k++) {
+                strcpy(tbuf, line[k & (LINE_CNT - 1)]);
+                strcpy(tbak, tbuf);
+                parse_old(&ipt0, tbuf);
+        }
+        t1 = bench_now();
+        for(k = 0; k < PARSE_CNT; k++) {
+                strcpy(tbuf, line[k & (LINE_CNT - 1)]);
+                parse_new(&ipt1, tbuf);
+        }
+        t2 = bench_now();
+        fprintf(stdout, "*line, %d, *next_tag, %.1f, *next_tag_id, %.1f, ns/line\n",
+                PARSE_CNT,
+                (t1 - t0) * 1e9 / PARSE_CNT,
+                (t2 - t1) * 1e9 / PARSE_CNT);
+        return (bad ? -1 : 0);
+}
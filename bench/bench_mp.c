@@ -0,0 +1,236 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: bench_mp.c
+ * funx: buddy pool shared by threads, buddy_create_mt() against malloc() and locked buddy_create()
+ */
+
+#include <stdio.h>
+#include <stdlib.h> /* for malloc(), etc */
+#include <string.h> /* for memset(), etc */
+#include <stdint.h> /* for uintN_t, etc */
+#include <pthread.h> /* for pthread_create(), etc */
+
+#include "buddy.h"
+#include "bench.h"
+
+#define MP_ORDER        (20) /* arena: 1MB, as tsana */
+#define LIVE_CNT        (256) /* block kept by each thread */
+#define OP_CNT          (1000 * 1000) /* malloc and free of each thread */
+#define BIG_SIZE        (16 * 1024) /* to add and return arena */
+#define BIG_CNT         (96) /* big block of each thread in each round */
+#define BIG_ROUND       (200)
+#define THREAD_MAX      (4)
+
+enum {
+        WAY_MALLOC, /* malloc() of libc */
+        WAY_LOCK, /* buddy_create() with a mutex */
+        WAY_MT, /* buddy_create_mt() */
+        WAY_CNT
+};
+
+static const char *way_name[WAY_CNT] = {"malloc", "buddy_lock", "buddy_mt"};
+
+struct mp_arg {
+        int way;
+        intptr_t mp;
+        pthread_mutex_t *lock;
+        uint32_t seed;
+        int bad; /* block changed by others */
+};
+
+static void *mp_malloc(struct mp_arg *arg, size_t size)
+{
+        void *ptr;
+
+        switch(arg->way) {
+                case WAY_MALLOC:
+                        return malloc(size);
+                case WAY_LOCK:
+                        pthread_mutex_lock(arg->lock);
+                        ptr = buddy_malloc(arg->mp, size);
+                        pthread_mutex_unlock(arg->lock);
+                        return ptr;
+                default:
+                        return buddy_malloc(arg->mp, size);
+        }
+}
+
+static void mp_free(struct mp_arg *arg, void *ptr)
+{
+        switch(arg->way) {
+                case WAY_MALLOC:
+                        free(ptr);
+                        break;
+                case WAY_LOCK:
+                        pthread_mutex_lock(arg->lock);
+                        buddy_free(arg->mp, ptr);
+                        pthread_mutex_unlock(arg->lock);
+                        break;
+                default:
+                        buddy_free(arg->mp, ptr);
+                        break;
+        }
+}
+
+/* the first byte of each block is its owner, check it before free */
+static void mark(struct mp_arg *arg, uint8_t *ptr, size_t size)
+{
+        memset(ptr, (uint8_t)arg->seed, (size < 64) ? size : 64);
+        ptr[size - 1] = (uint8_t)arg->seed;
+}
+
+static void check(struct mp_arg *arg, uint8_t *ptr, size_t size)
+{
+        if((uint8_t)arg->seed != ptr[0] || (uint8_t)arg->seed != ptr[size - 1]) {
+                arg->bad++;
+        }
+}
+
+/* nodes and section buffers, as a parser thread */
+static void *small_thread(void *p)
+{
+        struct mp_arg *arg = (struct mp_arg *)p;
+        uint8_t *live[LIVE_CNT];
+        size_t size[LIVE_CNT];
+        uint32_t x = arg->seed;
+        long i;
+        int k;
+
+        memset(live, 0, sizeof(live));
+        for(i = 0; i < OP_CNT; i++) {
+                k = i % LIVE_CNT;
+                if(live[k]) {
+                        check(arg, live[k], size[k]);
+                        mp_free(arg, live[k]);
+                }
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                size[k] = (i & 1) ? 72 : 8 + x % 1024;
+                live[k] = (uint8_t *)mp_malloc(arg, size[k]);
+                if(NULL == live[k]) {
+                        arg->bad++;
+                        continue;
+                }
+                mark(arg, live[k], size[k]);
+        }
+        for(k = 0; k < LIVE_CNT; k++) {
+                if(live[k]) {
+                        check(arg, live[k], size[k]);
+                        mp_free(arg, live[k]);
+                }
+        }
+        return NULL;
+}
+
+/* all thread grow the pool, then return all of it */
+static void *big_thread(void *p)
+{
+        struct mp_arg *arg = (struct mp_arg *)p;
+        uint8_t *live[BIG_CNT];
+        int round;
+        int k;
+
+        for(round = 0; round < BIG_ROUND; round++) {
+                for(k = 0; k < BIG_CNT; k++) {
+                        live[k] = (uint8_t *)mp_malloc(arg, BIG_SIZE);
+                        if(NULL == live[k]) {
+                                arg->bad++;
+                                continue;
+                        }
+                        mark(arg, live[k], BIG_SIZE);
+                }
+                for(k = 0; k < BIG_CNT; k++) {
+                        if(live[k]) {
+                                check(arg, live[k], BIG_SIZE);
+                                mp_free(arg, live[k]);
+                        }
+                }
+        }
+        return NULL;
+}
+
+/* return: ns per malloc and free pair, -1.0 if failed */
+static double run(int way, int thread_cnt, void *(*func)(void *), int *bad)
+{
+        pthread_mutex_t lock;
+        pthread_t tid[THREAD_MAX];
+        struct mp_arg arg[THREAD_MAX];
+        intptr_t mp = 0;
+        double t0;
+        double t1;
+        int n;
+        int i;
+
+        if(WAY_LOCK == way) {
+                mp = buddy_create(MP_ORDER, 6);
+        }
+        else if(WAY_MT == way) {
+                mp = buddy_create_mt(MP_ORDER, 6);
+        }
+        if(WAY_MALLOC != way) {
+                if(0 == mp) {
+                        return -1.0;
+                }
+                buddy_init(mp);
+        }
+        pthread_mutex_init(&lock, NULL);
+
+        t0 = bench_now();
+        for(n = 0; n < thread_cnt; n++) {
+                arg[n].way = way;
+                arg[n].mp = mp;
+                arg[n].lock = &lock;
+                arg[n].seed = 0x1234 + n;
+                arg[n].bad = 0;
+                if(0 != pthread_create(&(tid[n]), NULL, func, &(arg[n]))) {
+                        break;
+                }
+        }
+        for(i = 0; i < n; i++) {
+                pthread_join(tid[i], NULL);
+                *bad += arg[i].bad;
+        }
+        t1 = bench_now();
+
+        pthread_mutex_destroy(&lock);
+        if(mp) {
+                buddy_destroy(mp);
+        }
+        if(n != thread_cnt) {
+                return -1.0;
+        }
+        if(big_thread == func) {
+                return (t1 - t0) * 1e9 / ((double)BIG_CNT * BIG_ROUND * n);
+        }
+        return (t1 - t0) * 1e9 / ((double)OP_CNT * n);
+}
+
+int bench_mp(void)
+{
+        static const int thread_cnt[] = {1, 2, THREAD_MAX};
+        double ns[WAY_CNT];
+        int bad = 0;
+        int way;
+        int i;
+
+        for(i = 0; i < (int)(sizeof(thread_cnt) / sizeof(thread_cnt[0])); i++) {
+                for(way = 0; way < WAY_CNT; way++) {
+                        ns[way] = run(way, thread_cnt[i], small_thread, &bad);
+                }
+                fprintf(stdout, "*small, %d, *%s, %.1f, *%s, %.1f, *%s, %.1f, ns/op\n",
+                        thread_cnt[i],
+                        way_name[WAY_MALLOC], ns[WAY_MALLOC],
+                        way_name[WAY_LOCK], ns[WAY_LOCK],
+                        way_name[WAY_MT], ns[WAY_MT]);
+        }
+
+        /* arena added, returned and added again, by all threads */
+        ns[WAY_MT] = run(WAY_MT, THREAD_MAX, big_thread, &bad);
+        fprintf(stdout, "*big, %d, *%s, %.1f, ns/op\n", THREAD_MAX, way_name[WAY_MT], ns[WAY_MT]);
+        if(ns[WAY_MT] < 0.0) {
+                bad++;
+        }
+
+        fprintf(stdout, "*check, block of each thread, bad, %d, \n", bad);
+        return (bad ? -1 : 0);
+}
@@ -0,0 +1,112 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: tsbench.c
+ * funx: run micro benchmark of tstools libraries, check the result and report the speed
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* for strcmp(), etc */
+#include <time.h> /* for clock_gettime(), etc */
+
+#include "tstool_config.h"
+#include "bench.h"
+
+struct bench_table {
+        const char *name;
+        bench_func func;
+        const char *des;
+};
+
+static const struct bench_table BENCH_TABLE[] = {
+        {"crc", bench_crc, "ts_crc() against bit by bit CRC, MB/s of CRC-32"},
+        {"hex", bench_hex, "b2t() and next_nbyte_hex() against byte by byte convert, MB/s of binary"},
+        {"line", bench_line, "catts line parse by next_tag_id() against next_tag(), ns/line"},
+        {"mp", bench_mp, "buddy_create_mt() against malloc() and locked buddy_create(), ns/op"},
+        {NULL, NULL, NULL}
+};
+
+static void show_help();
+
+int main(int argc, char *argv[])
+{
+        const struct bench_table *b;
+        int i;
+        int fail = 0;
+
+        for(i = 1; i < argc; i++) {
+                if('-' == argv[i][0]) {
+                        show_help();
+                        return 0;
+                }
+                for(b = BENCH_TABLE; b->name; b++) {
+                        if(0 == strcmp(argv[i], b->name)) {
+                                break;
+                        }
+                }
+                if(NULL == b->name) {
+                        fprintf(stderr, "Wrong bench: %s\n", argv[i]);
+                        return -1;
+                }
+        }
+
+        for(b = BENCH_TABLE; b->name; b++) {
+                if(argc > 1) {
+                        /* only the named bench */
+                        for(i = 1; i < argc; i++) {
+                                if(0 == strcmp(argv[i], b->name)) {
+                                        break;
+                                }
+                        }
+                        if(i == argc) {
+                                continue;
+                        }
+                }
+                fprintf(stdout, "*bench, %s, \n", b->name);
+                if(0 != b->func()) {
+                        fprintf(stdout, "*fail, %s, \n", b->name);
+                        fail++;
+                }
+        }
+        return (fail ? -1 : 0);
+}
+
+double bench_now(void)
+{
+        struct timespec tp;
+
+        clock_gettime(CLOCK_MONOTONIC, &tp);
+        return tp.tv_sec + tp.tv_nsec * 1e-9;
+}
+
+void bench_fill(uint8_t *buf, size_t size, uint32_t seed)
+{
+        /* xorshift32, the same data on each platform */
+        if(0 == seed) {
+                seed = 1;
+        }
+        for(; size; size--) {
+                seed ^= seed << 13;
+                seed ^= seed >> 17;
+                seed ^= seed << 5;
+                *buf++ = (uint8_t)seed;
+        }
+        return;
+}
+
+static void show_help()
+{
+        const struct bench_table *b;
+
+        puts("'tsbench' run micro benchmark of tstools libraries, check the result and report the speed.");
+        puts("");
+        puts("Usage: tsbench [BENCH]...");
+        puts("");
+        puts("Bench, all of them if no one is given:");
+        puts("");
+        for(b = BENCH_TABLE; b->name; b++) {
+                fprintf(stdout, " %-16s %s\n", b->name, b->des);
+        }
+        puts("");
+        puts("Build it with 'make bench' in the top directory, it is not installed.");
+        return;
+}
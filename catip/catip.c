@@ -18,8 +18,14 @@ static struct url *fd_i = NULL;
 static char file_i[FILENAME_MAX] = "";
 static int npline = 188; /* data number per line */
 static long long int pkt_addr = 0;
+static int is_frame = 0; /* output binary frame, instead of text */
+static int is_cts = UDP_TS_OFF; /* output receive time of datagram as CTS, UDP_TS_xxx */
+static int rcvbuf = 0; /* receive buffer size of socket, 0 means system default */
+
+#define STC_OVF ((int64_t)0x200000000 * 300) /* the same as STC_OVF in ts.h */
 
 static int deal_with_parameter(int argc, char *argv[]);
+static int64_t ns2cts(int64_t ns);
 static void show_help();
 static void show_version();
 
@@ -27,6 +33,7 @@ int main(int argc, char *argv[])
 {
         unsigned char bbuf[ 204 + 10]; /* bin data buffer */
         char tbuf[1024 + 10]; /* txt data buffer */
+        struct if_frame frm;
 
         if(0 != deal_with_parameter(argc, argv)) {
                 return -1;
@@ -38,13 +45,45 @@ int main(int argc, char *argv[])
                 return -1;
         }
 
+        if(SCH_UDP == fd_i->scheme) {
+                if(rcvbuf) {
+                        udp_ioctl(fd_i->udp, UDP_RCVBUF, rcvbuf);
+                }
+                if(is_cts && 0 != udp_ioctl(fd_i->udp, UDP_TIMESTAMP, is_cts)) {
+                        is_cts = UDP_TS_OFF;
+                }
+        }
+        else {
+                is_cts = UDP_TS_OFF;
+        }
+
         pkt_addr = 0;
+        frame_init(&frm);
         while(1 == url_read(bbuf, npline, 1, fd_i)) {
+                int has_cts = (is_cts && fd_i->ns >= 0);
+
+                if(is_frame) {
+                        memcpy(frm.TS, bbuf, 188);
+                        frm.ADDR = pkt_addr;
+                        frm.flags = IF_HAS_TS | IF_HAS_ADDR;
+                        if(has_cts) {
+                                frm.CTS = ns2cts(fd_i->ns);
+                                frm.flags |= IF_HAS_CTS;
+                        }
+                        frame_write(&frm, stdout);
+                        pkt_addr += npline;
+                        continue;
+                }
+
                 fprintf(stdout, "*ts, ");
                 b2t(tbuf, bbuf, 188);
                 fprintf(stdout, "%s", tbuf);
 
-                fprintf(stdout, "*addr, %llX, \n", pkt_addr);
+                fprintf(stdout, "*addr, %llX, ", pkt_addr);
+                if(has_cts) {
+                        fprintf(stdout, "*cts, %llX, ", (long long int)ns2cts(fd_i->ns));
+                }
+                fprintf(stdout, "\n");
 
                 pkt_addr += npline;
         }
@@ -77,6 +116,27 @@ static int deal_with_parameter(int argc, char *argv[])
                                 show_version();
                                 return -1;
                         }
+                        else if(0 == strcmp(argv[i], "-f") ||
+                                0 == strcmp(argv[i], "--frame")) {
+                                is_frame = 1;
+                        }
+                        else if(0 == strcmp(argv[i], "-t") ||
+                                0 == strcmp(argv[i], "--timestamp")) {
+                                is_cts = UDP_TS_SW;
+                        }
+                        else if(0 == strcmp(argv[i], "-T") ||
+                                0 == strcmp(argv[i], "--hwtimestamp")) {
+                                is_cts = UDP_TS_HW;
+                        }
+                        else if(0 == strcmp(argv[i], "-r") ||
+                                0 == strcmp(argv[i], "--rcvbuf")) {
+                                i++;
+                                if(i >= argc) {
+                                        RPT(RPT_ERR, "no parameter for '%s'", argv[i - 1]);
+                                        return -1;
+                                }
+                                sscanf(argv[i], "%i", &rcvbuf);
+                        }
                         else {
                                 RPT(RPT_ERR, "wrong parameter: %s", argv[i]);
                                 return -1;
@@ -90,6 +150,15 @@ static int deal_with_parameter(int argc, char *argv[])
         return 0;
 }
 
+/* receive time(unit: ns) to 27MHz clock, in [0, STC_OVF) */
+static int64_t ns2cts(int64_t ns)
+{
+        int64_t cts;
+
+        cts = (ns / 1000) * 27 + (ns % 1000) * 27 / 1000; /* avoid overflow of ns * 27 */
+        return cts % STC_OVF;
+}
+
 static void show_help()
 {
         puts("'catip' read TS over IP, translate 0xXY to 'XY ' format, then send to stdout.");
@@ -98,11 +167,18 @@ static void show_help()
         puts("");
         puts("Options:");
         puts("");
+        puts(" -f, --frame      output binary frame instead of text");
+        puts(" -t, --timestamp  output receive time of datagram as \"*cts, \", by kernel");
+        puts(" -T, --hwtimestamp the same, by NIC if it can, e.g. after \"hwstamp_ctl -i eth0 -r 1\"");
+        puts(" -r, --rcvbuf <n> receive buffer size of socket(byte), e.g. 8388608");
         puts(" -h, --help       print this information only");
         puts(" -v, --version    print my version only");
         puts("");
         puts("Examples:");
         puts("  catip udp://:1234");
+        puts("  catip -f udp://:1234 | tsana -frame");
+        puts("  catip -t -r 8388608 udp://:1234 | tsana -pcr");
+        puts("  catip -T udp://:1234 | tsana -pcr -oj");
         puts("  catip udp://224.165.54.31:1234");
         puts("  catip udp://192.165.54.36@224.165.54.31:1234");
         puts("");
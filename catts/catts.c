@@ -8,9 +8,17 @@
 #include <string.h> /* for strcmp, etc */
 #include <stdint.h> /* for uintN_t, etc */
 
+#include "config.h" /* for SYS_* macro, generated by configure */
+
+#ifdef SYS_WINDOWS
+#include <io.h> /* for _setmode() */
+#include <fcntl.h> /* for _O_BINARY */
+#endif
+
 #include "tstool_config.h"
 #include "common.h"
 #include "if.h"
+#include "bin.h" /* for bin_map(), bin_sync(), etc */
 
 static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
 
@@ -23,74 +31,139 @@ enum FILE_TYPE
         FILE_UNKNOWN
 };
 
-static FILE *fd_i = NULL;
+#define BUF_SIZE        (204 * 188 * 8) /* read buffer for pipe, etc, n * 188 and n * 204 */
+
+static uint8_t *buf = NULL; /* the whole file mapped, or read buffer */
+static size_t buf_size = 0;
+static size_t head = 0; /* first byte not output */
+static size_t tail = 0; /* first byte not filled */
+static int is_map = 0;
+static int is_eof = 0;
+static FILE *fd_i = NULL; /* if not mapped */
 static char file_i[FILENAME_MAX] = "";
 static int npline = 16; /* data number per line */
 static int type = FILE_TS;
 static int aim_start = 0; /* first byte */
 static int aim_stop = 0; /* last byte */
-static long long int pkt_addr = 0;
+static size_t pkt_addr = 0;
 static long long int pkt_mts = 0;
+static int is_frame = 0; /* output binary frame, instead of text */
 
 static int deal_with_parameter(int argc, char *argv[]);
 static int show_help();
 static int show_version();
+static int fill();
 static int judge_type();
 static int mts_time(long long int *mts, uint8_t *bin);
+static int put_frame(const uint8_t *ts, const uint8_t *rs, const long long int *mts);
 
 int main(int argc, char *argv[])
 {
         int cnt;
-        unsigned char bbuf[LINE_LENGTH_MAX / 3 + 10]; /* bin data buffer */
+        uint8_t *bbuf; /* bin data, point into buf[] */
         char tbuf[LINE_LENGTH_MAX + 10]; /* txt data buffer */
 
         if(0 != deal_with_parameter(argc, argv)) {
                 return -1;
         }
 
-        fd_i = fopen(file_i, "rb");
-        if(NULL == fd_i) {
-                RPT(RPT_ERR, "open \"%s\" failed", file_i);
-                return -1;
+        /* regular file is mapped, pipe, device, empty file, etc are read */
+        buf = bin_map(file_i, &buf_size);
+        if(NULL != buf) {
+                is_map = 1;
+                is_eof = 1; /* all data in buf[] already */
+                tail = buf_size;
+        }
+        else {
+                if(0 == strcmp(file_i, "-")) {
+#ifdef SYS_WINDOWS
+                        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+                        fd_i = stdin;
+                }
+                else {
+                        fd_i = fopen(file_i, "rb");
+                        if(NULL == fd_i) {
+                                RPT(RPT_ERR, "open \"%s\" failed", file_i);
+                                return -1;
+                        }
+                }
+                buf_size = BUF_SIZE;
+                buf = (uint8_t *)malloc(buf_size);
+                if(NULL == buf) {
+                        RPT(RPT_ERR, "malloc failed");
+                        goto main_exit;
+                }
+        }
+
+        /* pass the bytes before aim_start */
+        while(pkt_addr < aim_start) {
+                if(head == tail && 0 != fill()) {
+                        break;
+                }
+                cnt = (int)(((tail - head) < (aim_start - pkt_addr)) ? (tail - head) : (aim_start - pkt_addr));
+                head += cnt;
+                pkt_addr += cnt;
         }
 
-        pkt_addr = 0;
         judge_type();
-        while(0 < (cnt = fread(bbuf, 1, npline, fd_i))) {
+        while(1) {
+                while(tail - head < npline && 0 == fill()) {
+                        /* read more */
+                }
+                if(head >= tail) {
+                        break;
+                }
+                bbuf = buf + head;
+                cnt = ((tail - head < npline) ? (int)(tail - head) : npline);
+                if(FILE_BIN != type && cnt < npline) {
+                        RPT(RPT_WRN, "drop %d-byte at the end", cnt);
+                        break;
+                }
+
                 switch(type) {
                         case FILE_TS:
                                 if(0x47 != bbuf[0]) {
-                                        pkt_addr -= ((pkt_addr >= npline) ? npline : 0);
                                         judge_type();
                                         continue;
                                 }
+                                if(is_frame) {
+                                        put_frame(bbuf, NULL, NULL);
+                                        break;
+                                }
                                 fprintf(stdout, "*ts, ");
                                 b2t(tbuf, bbuf, 188);
                                 fprintf(stdout, "%s", tbuf);
 
-                                fprintf(stdout, "*addr, %llX, \n", pkt_addr);
+                                fprintf(stdout, "*addr, %zX, \n", pkt_addr);
                                 break;
                         case FILE_MTS:
                                 if(0x47 != bbuf[4]) {
-                                        pkt_addr -= ((pkt_addr >= npline) ? npline : 0);
                                         judge_type();
                                         continue;
                                 }
+                                mts_time(&pkt_mts, bbuf);
+                                if(is_frame) {
+                                        put_frame(bbuf + 4, NULL, &pkt_mts);
+                                        break;
+                                }
                                 fprintf(stdout, "*ts, ");
                                 b2t(tbuf, bbuf + 4, 188);
                                 fprintf(stdout, "%s", tbuf);
 
-                                fprintf(stdout, "*addr, %llX, ", pkt_addr);
+                                fprintf(stdout, "*addr, %zX, ", pkt_addr);
 
-                                mts_time(&pkt_mts, bbuf);
                                 fprintf(stdout, "*mts, %llX, \n", pkt_mts);
                                 break;
                         case FILE_TSRS:
                                 if(0x47 != bbuf[0]) {
-                                        pkt_addr -= ((pkt_addr >= npline) ? npline : 0);
                                         judge_type();
                                         continue;
                                 }
+                                if(is_frame) {
+                                        put_frame(bbuf, bbuf + 188, NULL);
+                                        break;
+                                }
                                 fprintf(stdout, "*ts, ");
                                 b2t(tbuf, bbuf, 188);
                                 fprintf(stdout, "%s", tbuf);
@@ -99,16 +172,21 @@ int main(int argc, char *argv[])
                                 b2t(tbuf, bbuf + 188, 16);
                                 fprintf(stdout, "%s", tbuf);
 
-                                fprintf(stdout, "*addr, %llX, \n", pkt_addr);
+                                fprintf(stdout, "*addr, %zX, \n", pkt_addr);
                                 break;
                         default: /* FILE_BIN */
+                                if(is_frame) {
+                                        RPT(RPT_ERR, "not TS file, can not output binary frame");
+                                        goto main_exit;
+                                }
                                 fprintf(stdout, "*data, ");
                                 b2t(tbuf, bbuf, cnt);
                                 fprintf(stdout, "%s", tbuf);
 
-                                fprintf(stdout, "*addr, %llX, \n", pkt_addr);
+                                fprintf(stdout, "*addr, %zX, \n", pkt_addr);
                                 break;
                 }
+                head += cnt;
                 pkt_addr += cnt;
 
                 if(0 != aim_stop && pkt_addr >= aim_stop) {
@@ -116,7 +194,16 @@ int main(int argc, char *argv[])
                 }
         }
 
-        fclose(fd_i);
+main_exit:
+        if(is_map) {
+                bin_unmap(buf, buf_size);
+        }
+        else {
+                free(buf);
+                if(stdin != fd_i) {
+                        fclose(fd_i);
+                }
+        }
 
         return 0;
 }
@@ -134,7 +221,7 @@ static int deal_with_parameter(int argc, char *argv[])
         }
 
         for(i = 1; i < argc; i++) {
-                if('-' == argv[i][0]) {
+                if('-' == argv[i][0] && '\0' != argv[i][1]) {
                         if(0 == strcmp(argv[i], "-s") ||
                            0 == strcmp(argv[i], "--start")) {
                                 i++;
@@ -186,6 +273,10 @@ static int deal_with_parameter(int argc, char *argv[])
                                                 dat, LINE_LENGTH_MAX / 3);
                                 }
                         }
+                        else if(0 == strcmp(argv[i], "-f") ||
+                                0 == strcmp(argv[i], "--frame")) {
+                                is_frame = 1;
+                        }
                         else if(0 == strcmp(argv[i], "-l"))
                         {
                                 i++;
@@ -243,12 +334,14 @@ static int show_help()
         puts("'catts' read binary file, translate 0xXY to 'XY ' format, then send to stdout.");
         puts("");
         puts("Usage: catts [OPTION] file [OPTION]");
+        puts("  file: '-' for stdin");
         puts("");
         puts("Options:");
         puts("");
         puts(" -w, --width <n>          n-byte per line for FILE_BIN, default: 16");
         puts(" -s, --start <a>          cat from, default: 0(from first byte)");
         puts(" -p, --stop <b>           cat to, default: 0(to last byte)");
+        puts(" -f, --frame              output binary frame instead of text, for TS file only");
         puts("");
         puts(" -l <level>               set report level(dbg|inf|wrn|err), default: wrn");
         puts(" -h, --help               display this information");
@@ -256,6 +349,7 @@ static int show_help()
         puts("");
         puts("Examples:");
         puts("  catts xxx.ts");
+        puts("  catts -f xxx.ts | tsana -frame");
         puts("");
         puts("Report bugs to <zhoucheng@tsinghua.org.cn>.");
         return 0;
@@ -282,118 +376,77 @@ static int show_version()
 
 #define SYNC_TIME       3 /* SYNC_TIME syncs means TS sync */
 #define ASYNC_BYTE      4096 /* head ASYNC_BYTE bytes async means BIN file */
-/* for TS data: use "state machine" to determine sync position and packet size */
+/* move the data left to buf[0], then read more data, return -1 if no more */
+static int fill()
+{
+        size_t cnt;
+
+        if(is_eof) {
+                return -1;
+        }
+
+        if(head > 0) {
+                memmove(buf, buf + head, tail - head);
+                tail -= head;
+                head = 0;
+        }
+
+        cnt = fread(buf + tail, 1, buf_size - tail, fd_i);
+        if(0 == cnt) {
+                is_eof = 1;
+                return -1;
+        }
+        tail += cnt;
+        return 0;
+}
+
+/* for TS data: search sync position and packet size in buf[] */
 static int judge_type()
 {
-        uint8_t dat;
-        int sync_cnt = 0;
-        int state = FILE_UNKNOWN;
-        long long int off = 0;
-
-        RPT(RPT_INF, "judge type from 0x%llX +%lld", pkt_addr, off);
-        type = FILE_UNKNOWN;
-        while(FILE_UNKNOWN == type) {
-                switch(state) {
-                        case FILE_UNKNOWN:
-                                fseek(fd_i, pkt_addr + off, SEEK_SET);
-                                if(1 != fread(&dat, 1, 1, fd_i)) {
-                                        return -1;
-                                }
-                                if(0x47 == dat) {
-                                        RPT(RPT_INF, "first 0x47 at +%lld, maybe TS", off);
-                                        sync_cnt = 1;
-                                        state = FILE_TS;
-                                }
-                                else {
-                                        off++;
-                                        if(off > ASYNC_BYTE) {
-                                                RPT(RPT_INF, "unlock over %d-byte, it is BIN", ASYNC_BYTE);
-                                                off = 0;
-                                                type = FILE_BIN;
-                                                state = FILE_BIN;
-                                        }
-                                }
-                                break;
-                        case FILE_TS:
-                                fseek(fd_i, +187, SEEK_CUR);
-                                if(1 != fread(&dat, 1, 1, fd_i)) {
-                                        return -1;
-                                }
-                                if(0x47 == dat) {
-                                        RPT(RPT_INF, "meet 0x47, maybe TS");
-                                        sync_cnt++;
-                                        if(sync_cnt >= SYNC_TIME) {
-                                                RPT(RPT_INF, "it is TS");
-                                                npline = 188;
-                                                type = FILE_TS;
-                                        }
-                                }
-                                else {
-                                        fseek(fd_i, pkt_addr + off + 1, SEEK_SET);
-                                        sync_cnt = 1;
-                                        state = FILE_MTS;
-                                }
-                                break;
-                        case FILE_MTS:
-                                fseek(fd_i, +191, SEEK_CUR);
-                                if(1 != fread(&dat, 1, 1, fd_i)) {
-                                        return -1;
-                                }
-                                if(0x47 == dat) {
-                                        RPT(RPT_INF, "meet 0x47, maybe MTS");
-                                        sync_cnt++;
-                                        if(sync_cnt >= SYNC_TIME) {
-                                                if(off < 4) {
-                                                        fseek(fd_i, pkt_addr + off + 1, SEEK_SET);
-                                                        sync_cnt = 1;
-                                                        state = FILE_TSRS;
-                                                }
-                                                else {
-                                                        RPT(RPT_INF, "it is MTS");
-                                                        off -= 4;
-                                                        npline = 192;
-                                                        type = FILE_MTS;
-                                                }
-                                        }
-                                }
-                                else {
-                                        fseek(fd_i, pkt_addr + off + 1, SEEK_SET);
-                                        sync_cnt = 1;
-                                        state = FILE_TSRS;
-                                }
-                                break;
-                        case FILE_TSRS:
-                                fseek(fd_i, +203, SEEK_CUR);
-                                if(1 != fread(&dat, 1, 1, fd_i)) {
-                                        return -1;
-                                }
-                                if(0x47 == dat) {
-                                        RPT(RPT_INF, "meet 0x47, maybe TSRS");
-                                        sync_cnt++;
-                                        if(sync_cnt >= SYNC_TIME) {
-                                                RPT(RPT_INF, "it is TSRS");
-                                                npline = 204;
-                                                type = FILE_TSRS;
-                                        }
-                                }
-                                else {
-                                        off++;
-                                        type = FILE_UNKNOWN;
-                                        state = FILE_UNKNOWN;
-                                        RPT(RPT_INF, "judge type from 0x%llX +%lld", pkt_addr, off);
-                                }
-                                break;
-                        default:
-                                RPT(RPT_ERR, "bad state: %d", state);
-                                return -1;
-                }
+        size_t off;
+        size_t len;
+
+        while(tail - head < ASYNC_BYTE + 204 * (SYNC_TIME - 1) + 1 && 0 == fill()) {
+                /* read more */
+        }
+        if(head >= tail) {
+                return -1;
+        }
+        len = tail - head;
+
+        RPT(RPT_INF, "judge type from 0x%zX", pkt_addr);
+        if(len > ASYNC_BYTE + 204 * (SYNC_TIME - 1) + 1) {
+                len = ASYNC_BYTE + 204 * (SYNC_TIME - 1) + 1;
+        }
+
+        switch(bin_sync(buf + head, len, &off)) {
+                case BIN_TYPE_TS:
+                        RPT(RPT_INF, "it is TS");
+                        npline = 188;
+                        type = FILE_TS;
+                        break;
+                case BIN_TYPE_MTS:
+                        RPT(RPT_INF, "it is MTS");
+                        npline = 192;
+                        type = FILE_MTS;
+                        break;
+                case BIN_TYPE_TSRS:
+                        RPT(RPT_INF, "it is TSRS");
+                        npline = 204;
+                        type = FILE_TSRS;
+                        break;
+                default:
+                        RPT(RPT_INF, "unlock over %d-byte, it is BIN", ASYNC_BYTE);
+                        off = 0;
+                        type = FILE_BIN;
+                        break;
         }
 
         if(off != 0) {
-                RPT(RPT_WRN, "pass %lld-byte from 0x%llX (%lld)", off, pkt_addr, pkt_addr);
+                RPT(RPT_WRN, "pass %zd-byte from 0x%zX (%zd)", off, pkt_addr, pkt_addr);
         }
+        head += off;
         pkt_addr += off;
-        fseek(fd_i, pkt_addr, SEEK_SET);
         return 0;
 }
 
@@ -408,3 +461,25 @@ static int mts_time(long long int *mts, uint8_t *bin)
 
         return 0;
 }
+
+static int put_frame(const uint8_t *ts, const uint8_t *rs, const long long int *mts)
+{
+        static struct if_frame frm;
+
+        if('Z' != frm.magic[0]) {
+                frame_init(&frm);
+        }
+
+        memcpy(frm.TS, ts, 188);
+        frm.flags = IF_HAS_TS | IF_HAS_ADDR;
+        frm.ADDR = pkt_addr;
+        if(rs) {
+                memcpy(frm.RS, rs, 16);
+                frm.flags |= IF_HAS_RS;
+        }
+        if(mts) {
+                frm.MTS = *mts;
+                frm.flags |= IF_HAS_MTS;
+        }
+        return frame_write(&frm, stdout);
+}
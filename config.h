@@ -0,0 +1,7 @@
+#define HAVE_MALLOC_H 1
+#define ARCH_X86_64 1
+#define SYS_LINUX 1
+#define HAVE_LOG2F 1
+#define fseek fseeko
+#define ftell ftello
+#define HAVE_XML 1
@@ -0,0 +1,27 @@
+SRCPATH=.
+prefix=/usr/local
+exec_prefix=${prefix}
+bindir=${exec_prefix}/bin
+libdir=${exec_prefix}/lib
+includedir=${prefix}/include
+ARCH=X86_64
+SYS=LINUX
+CC=gcc
+CFLAGS=-O3 -ffast-math -m64  -Wall -Werror -Wno-error=stringop-truncation -Wno-error=unused-const-variable -Wno-error=format-overflow -Wno-error=format-truncation -I. -I.. -std=gnu99 -fPIC -fomit-frame-pointer -fno-tree-vectorize
+DEPMM=-MM -g0
+DEPMT=-MT
+LD=gcc -o 
+LDFLAGS=-m64  -lm -Wl,-rpath-link,../libzlst:../libzbuddy:../libzutil:../libzts
+AR=ar rc 
+RANLIB=ranlib
+STRIP=strip
+AS=
+ASFLAGS= -f elf -m amd64 -DHAVE_ALIGNED_STACK=1 -DPIC
+RC=
+RCFLAGS=
+EXE=
+HAVE_GETOPT_LONG=1
+DEVNULL=/dev/null
+SOSUFFIX=so
+SOFLAGS=-shared -Wl,-soname,$(SONAME)  -Wl,-Bsymbolic
+LIB=shared
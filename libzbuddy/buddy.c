@@ -1,9 +1,16 @@
 /* vim: set tabstop=8 shiftwidth=8: */
+#include "config.h" /* for SYS_* macro, generated by configure */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h> /* for memcpy */
 #include <stdint.h> /* for uintN_t, etc */
 
+#ifdef SYS_LINUX
+#define BUDDY_MT /* buddy_create_mt() is supported */
+#include <pthread.h>
+#endif
+
 #include "buddy.h"
 
 /* report level */
@@ -39,18 +46,85 @@ static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
 #define RSUBTREE(index) (((index) << 1) + 2)
 #define PARENT(index)   ((((index) + 1) >> 1) - 1)
 
+#define MAG_SIZE   (32) /* node count in each magazine */
+#define MAG_ORDERS (8) /* magazine for order: [omin, omin + MAG_ORDERS) */
+
+/* one region of (1 << omax) byte, with its own tree */
+struct buddy_arena
+{
+        struct buddy_arena *next;
+        uint8_t *tree; /* binary tree, the array to describe the status of arena */
+        uint8_t *pool; /* arena buffer, NULL if returned to OS in shared pool */
+        uint8_t *omap; /* order of malloced node, index: offset >> omin, for shared pool only */
+};
+
+#ifdef BUDDY_MT
+/* node of the same order freed by this thread recently, malloc from here first */
+struct buddy_mag
+{
+        struct buddy_mag *next; /* all magazine of the pool */
+        struct buddy_pool *p;
+        size_t cnt[MAG_ORDERS];
+        void *node[MAG_ORDERS][MAG_SIZE];
+};
+#endif
+
 struct buddy_pool
 {
         size_t omax; /* max order */
         size_t omin; /* min order */
-        uint8_t *tree; /* binary tree, the array to describe the status of pool */
-        size_t size; /* pool size: (1 << omax) */
-        uint8_t *pool; /* pool buffer */
+        size_t size; /* arena size: (1 << omax) */
+        size_t tree_size; /* node count of each tree */
+        struct buddy_arena *arena0; /* arena list, the first one is never returned to OS */
+        size_t arena_cnt;
+
+        int is_mt; /* shared by threads, see buddy_create_mt() */
+#ifdef BUDDY_MT
+        pthread_mutex_t lock; /* for tree and arena list */
+        pthread_key_t key; /* magazine of each thread */
+        struct buddy_mag *mag0; /* all magazine, for buddy_init() and buddy_destroy() */
+#endif
 };
 
+static intptr_t pool_create(size_t order_max, size_t order_min, int is_mt);
+static void *pool_malloc(struct buddy_pool *p, size_t order);
 static size_t smallest_order(size_t size);
+static struct buddy_arena *arena_create(struct buddy_pool *p);
+static void arena_destroy(struct buddy_arena *a);
+static void arena_init(struct buddy_pool *p, struct buddy_arena *a);
+static void *arena_malloc(struct buddy_pool *p, struct buddy_arena *a, size_t order);
+static size_t arena_order(struct buddy_pool *p, struct buddy_arena *a, void *ptr, size_t *index);
+static void arena_release(struct buddy_pool *p, struct buddy_arena *a, size_t i, size_t order);
+static struct buddy_arena *arena_find(struct buddy_pool *p, void *ptr);
+static void arena_reclaim(struct buddy_pool *p, struct buddy_arena *a);
+static int arena_wake(struct buddy_pool *p, struct buddy_arena *a);
+static size_t node_order(struct buddy_pool *p, struct buddy_arena *a, void *ptr, size_t *index);
+
+#ifdef BUDDY_MT
+static void lock(struct buddy_pool *p);
+static void unlock(struct buddy_pool *p);
+static void *mt_malloc(struct buddy_pool *p, size_t order);
+static void mt_free(struct buddy_pool *p, void *ptr);
+static struct buddy_mag *mag_get(struct buddy_pool *p);
+static void mag_exit(void *arg);
+#endif
 
 intptr_t buddy_create(size_t order_max, size_t order_min)
+{
+        return pool_create(order_max, order_min, 0);
+}
+
+intptr_t buddy_create_mt(size_t order_max, size_t order_min)
+{
+#ifdef BUDDY_MT
+        return pool_create(order_max, order_min, 1);
+#else
+        RPT(RPT_ERR, "create: shared pool is not supported in this system");
+        return 0; /* failed */
+#endif
+}
+
+static intptr_t pool_create(size_t order_max, size_t order_min, int is_mt)
 {
         if(order_max > BUDDY_ORDER_MAX) {
                 RPT(RPT_ERR, "create: bad order_max: %zd > %zd", order_max, BUDDY_ORDER_MAX);
@@ -76,48 +150,67 @@ intptr_t buddy_create(size_t order_max, size_t order_min)
         p->omax = order_max;
         p->omin = order_min;
         p->size = (1 << order_max);
+        p->tree_size = (1 << (p->omax - p->omin + 1)) - 1;
+        p->arena_cnt = 0;
+        p->is_mt = is_mt;
 
-        size_t tree_size = (1 << (p->omax - p->omin + 1)) - 1;
-        p->tree = (uint8_t *)malloc(tree_size); /* FIXME: memalign? */
-        if(NULL == p->tree) {
-                RPT(RPT_ERR, "create: malloc tree(%zd-byte) failed", tree_size);
+        p->arena0 = arena_create(p);
+        if(NULL == p->arena0) {
                 free(p);
                 return 0; /* failed */
         }
-        RPT(RPT_DBG, "create: tree: %8zX-byte @ %p", tree_size, p->tree);
-
-        p->pool = (uint8_t *)malloc(p->size); /* FIXME: memalign? */
-        if(NULL == p->pool) {
-                RPT(RPT_ERR, "create: malloc pool(%zd-byte) failed", p->size);
-                free(p->tree);
-                free(p);
-                return 0; /* failed */
+        RPT(RPT_DBG, "create: min space: %zX", (size_t)1 << order_min);
+
+#ifdef BUDDY_MT
+        if(is_mt) {
+                pthread_mutex_init(&(p->lock), NULL);
+                if(0 != pthread_key_create(&(p->key), mag_exit)) {
+                        RPT(RPT_ERR, "create: create key for magazine failed");
+                        pthread_mutex_destroy(&(p->lock));
+                        arena_destroy(p->arena0);
+                        free(p);
+                        return 0; /* failed */
+                }
+                p->mag0 = NULL;
         }
-        RPT(RPT_DBG, "create: pool: %8zX-byte @ %p, min space: %zX", p->size, p->pool, (size_t)1 << order_min);
+#endif
 
-        p->tree[0] = 0; /* to avoid use malloc() before init() */
+        p->arena0->tree[0] = 0; /* to avoid use malloc() before init() */
         return (intptr_t)p;
 }
 
 int buddy_destroy(intptr_t id)
 {
         struct buddy_pool *p = (struct buddy_pool *)id;
+        struct buddy_arena *a;
 
         if(NULL == p) {
                 RPT(RPT_ERR, "destroy: bad id");
                 return -1;
         }
-        if(NULL == p->tree) {
-                RPT(RPT_ERR, "destroy: bad tree");
+        if(NULL == p->arena0) {
+                RPT(RPT_ERR, "destroy: bad arena");
                 return -1;
         }
-        if(NULL == p->pool) {
-                RPT(RPT_ERR, "destroy: bad pool");
-                return -1;
+
+#ifdef BUDDY_MT
+        if(p->is_mt) {
+                struct buddy_mag *mag;
+
+                /* other threads should not use the pool now */
+                pthread_key_delete(p->key);
+                while(NULL != (mag = p->mag0)) {
+                        p->mag0 = mag->next;
+                        free(mag);
+                }
+                pthread_mutex_destroy(&(p->lock));
         }
+#endif
 
-        free(p->pool);
-        free(p->tree);
+        while(NULL != (a = p->arena0)) {
+                p->arena0 = a->next;
+                arena_destroy(a);
+        }
         free(p);
         return 0;
 }
@@ -125,23 +218,39 @@ int buddy_destroy(intptr_t id)
 int buddy_init(intptr_t id)
 {
         struct buddy_pool *p = (struct buddy_pool *)id;
+        struct buddy_arena *a;
 
         if(NULL == p) {
                 RPT(RPT_ERR, "init: bad id");
                 return -1;
         }
-        if(NULL == p->tree) {
-                RPT(RPT_ERR, "init: bad tree");
+        if(NULL == p->arena0) {
+                RPT(RPT_ERR, "init: bad arena");
                 return -1;
         }
 
-        size_t tree_size = (1 << (p->omax - p->omin + 1)) - 1;
-        for(size_t order = p->omax + 1, i = 0; i < tree_size; i++) {
-                if(IS_POWER_OF_2(i + 1)) {
-                        order--;
+#ifdef BUDDY_MT
+        if(p->is_mt) {
+                struct buddy_mag *mag;
+
+                /* other threads should not use the pool now */
+                lock(p);
+                for(mag = p->mag0; mag; mag = mag->next) {
+                        memset(mag->cnt, 0, sizeof(mag->cnt));
                 }
-                p->tree[i] = order;
+                unlock(p);
         }
+#endif
+
+        /* keep the first arena only */
+        while(NULL != (a = p->arena0->next)) {
+                p->arena0->next = a->next;
+                if(a->pool) {
+                        p->arena_cnt--; /* sleeping arena is not counted */
+                }
+                arena_destroy(a);
+        }
+        arena_init(p, p->arena0);
         return 0;
 }
 
@@ -153,8 +262,8 @@ int buddy_status(intptr_t id, int enable, const char *hint)
                 RPT(RPT_ERR, "status: bad id");
                 return -1;
         }
-        if(NULL == p->tree) {
-                RPT(RPT_ERR, "status: bad tree");
+        if(NULL == p->arena0) {
+                RPT(RPT_ERR, "status: bad arena");
                 return -1;
         }
         if(!enable) {
@@ -166,64 +275,68 @@ int buddy_status(intptr_t id, int enable, const char *hint)
         size_t tree_size;
         size_t cnt;
         size_t acc;
+        struct buddy_arena *a;
 
-        order = p->omax + 1;
-        tree_size = (1 << (p->omax - p->omin + 1)) - 1;
-        cnt = 0;
+#ifdef BUDDY_MT
+        if(p->is_mt) {
+                lock(p);
+        }
+#endif
+
+        tree_size = p->tree_size;
         acc = 0;
         fprintf(stderr,"buddy: ");
 #if 0
         fprintf(stderr,"\n");
 #endif
-        for(size_t i = 0; i < tree_size; i++) {
-                if(IS_POWER_OF_2(i + 1)) {
-                        order--;
-                        cnt = 0;
+        for(a = p->arena0; a; a = a->next) {
+                if(NULL == a->pool) {
+                        continue; /* sleeping arena of shared pool */
                 }
-                if(0 == p->tree[i]) {
-                        if(LSUBTREE(i) >= tree_size || RSUBTREE(i) >= tree_size) {
-                                /* no subtree */
-                                cnt++;
-                                acc += (1 << order);
-#if 0
-                                uint8_t *buf = (p->pool + (i + 1) * (1<<order) - (p->size));
-                                for(size_t x = 0; x <(1 << order); x++) {
-                                        fprintf(stderr, "%c", *(buf + x));
-                                }
-                                fprintf(stderr, "\n");
-                                for(size_t x = 0; x <(1 << order); x++) {
-                                        fprintf(stderr, "%02X ", *(buf + x));
-                                }
-                                fprintf(stderr, "\n");
-#endif
+                order = p->omax + 1;
+                cnt = 0;
+                for(size_t i = 0; i < tree_size; i++) {
+                        if(IS_POWER_OF_2(i + 1)) {
+                                order--;
+                                cnt = 0;
                         }
-                        else {
-                                /* depend on subtree */
-                                if(0 != p->tree[LSUBTREE(i)] || 0 != p->tree[RSUBTREE(i)]) {
+                        if(0 == a->tree[i]) {
+                                if(LSUBTREE(i) >= tree_size || RSUBTREE(i) >= tree_size) {
+                                        /* no subtree */
                                         cnt++;
                                         acc += (1 << order);
-#if 0
-                                        uint8_t *buf = (p->pool + (i + 1) * (1<<order) - (p->size));
-                                        for(size_t x = 0; x <(1 << order); x++) {
-                                                fprintf(stderr, "%c", *(buf + x));
-                                        }
-                                        fprintf(stderr, "\n");
-                                        for(size_t x = 0; x <(1 << order); x++) {
-                                                fprintf(stderr, "%02X ", *(buf + x));
+                                }
+                                else {
+                                        /* depend on subtree */
+                                        if(0 != a->tree[LSUBTREE(i)] || 0 != a->tree[RSUBTREE(i)]) {
+                                                cnt++;
+                                                acc += (1 << order);
                                         }
-                                        fprintf(stderr, "\n");
-#endif
                                 }
                         }
-                }
-                if(IS_POWER_OF_2(i + 2) && (0 != cnt)) {
-                        fprintf(stderr,"%3zd x 0x%zX, ", cnt, (size_t)1 << order);
+                        if(IS_POWER_OF_2(i + 2) && (0 != cnt)) {
+                                fprintf(stderr,"%3zd x 0x%zX, ", cnt, (size_t)1 << order);
 #if 0
-                        fprintf(stderr, "\n");
+                                fprintf(stderr, "\n");
 #endif
+                        }
                 }
         }
-        fprintf(stderr,"(%zu / %zu) used", acc, (size_t)1 << p->omax);
+        fprintf(stderr,"(%zu / %zu) used in %zu arena", acc, p->arena_cnt * p->size, p->arena_cnt);
+#ifdef BUDDY_MT
+        if(p->is_mt) {
+                struct buddy_mag *mag;
+                size_t cached = 0;
+
+                for(mag = p->mag0; mag; mag = mag->next) {
+                        for(size_t k = 0; k < MAG_ORDERS; k++) {
+                                cached += mag->cnt[k] << (p->omin + k);
+                        }
+                }
+                fprintf(stderr,", %zu in magazine", cached);
+                unlock(p);
+        }
+#endif
         fprintf(stderr,": %s\n", ((hint) ? hint : ""));
         return 0;
 }
@@ -236,12 +349,8 @@ void *buddy_malloc(intptr_t id, size_t size)
                 RPT(RPT_ERR, "malloc: bad id");
                 return NULL;
         }
-        if(NULL == p->tree) {
-                RPT(RPT_ERR, "malloc: bad tree");
-                return NULL;
-        }
-        if(NULL == p->pool) {
-                RPT(RPT_ERR, "malloc: bad pool");
+        if(NULL == p->arena0) {
+                RPT(RPT_ERR, "malloc: bad arena");
                 return NULL;
         }
 
@@ -252,49 +361,70 @@ void *buddy_malloc(intptr_t id, size_t size)
 
         /* determine aim order in tree */
         size_t order = MAX(smallest_order(size), p->omin);
-        if((int)(p->tree[0]) < order) {
-                RPT(RPT_ERR, "malloc: not enough space in pool");
+        if(order > p->omax) {
+                RPT(RPT_ERR, "malloc: size(%zX) is bigger than arena(%zX)", size, p->size);
                 return NULL;
         }
 
-        /* search aim node in the tree */
-        size_t i = 0; /* index of binary tree array */
-        for(size_t current_order = p->omax; current_order > order; current_order--) {
-                if(p->tree[LSUBTREE(i)] >= order) {
-                        i = LSUBTREE(i);
-                }
-                else {
-                        i = RSUBTREE(i);
-                }
+#ifdef BUDDY_MT
+        if(p->is_mt) {
+                return mt_malloc(p, order);
         }
-        p->tree[i] = 0; /* find the aim node */
+#endif
+        return pool_malloc(p, order);
+}
 
-        uint8_t *rslt = (p->pool + (i + 1) * (1<<order) - (p->size));
-        RPT(RPT_DBG, "malloc:  @ %p %zX %zX", rslt, (size_t)1 << order, size);
+/* search in all arena, add arena if needed */
+static void *pool_malloc(struct buddy_pool *p, size_t order)
+{
+        struct buddy_arena *a;
+        struct buddy_arena *last;
+        void *rslt;
+
+        /* search in all arena */
+        last = NULL;
+        for(a = p->arena0; a; a = a->next) {
+                rslt = arena_malloc(p, a, order);
+                if(rslt) {
+                        return rslt;
+                }
+                last = a;
+        }
 
-        /* modify parent order */
-        while(i) {
-                i = PARENT(i);
-                p->tree[i] = MAX(p->tree[LSUBTREE(i)], p->tree[RSUBTREE(i)]) ;
+        /* grow: wake a sleeping arena of shared pool */
+        for(a = p->arena0; a; a = a->next) {
+                if(NULL == a->pool) {
+                        if(0 != arena_wake(p, a)) {
+                                return NULL;
+                        }
+                        RPT(RPT_INF, "malloc: wake arena, %zd now", p->arena_cnt);
+                        return arena_malloc(p, a, order);
+                }
         }
 
-        return rslt;
+        /* grow: add a new arena */
+        a = arena_create(p);
+        if(NULL == a) {
+                RPT(RPT_ERR, "malloc: not enough space in pool");
+                return NULL;
+        }
+        arena_init(p, a);
+        __atomic_store_n(&(last->next), a, __ATOMIC_RELEASE); /* arena_find() without lock */
+        RPT(RPT_INF, "malloc: add arena %zd", p->arena_cnt);
+        return arena_malloc(p, a, order);
 }
 
 void *buddy_realloc(intptr_t id, void *ptr, size_t size) /* FIXME: need to be test */
 {
         struct buddy_pool *p = (struct buddy_pool *)id;
+        struct buddy_arena *a;
 
         if(NULL == p) {
                 RPT(RPT_ERR, "realloc: bad id");
                 return NULL;
         }
-        if(NULL == p->tree) {
-                RPT(RPT_ERR, "realloc: bad tree");
-                return NULL;
-        }
-        if(NULL == p->pool) {
-                RPT(RPT_ERR, "realloc: bad pool");
+        if(NULL == p->arena0) {
+                RPT(RPT_ERR, "realloc: bad arena");
                 return NULL;
         }
         if(NULL == ptr) {
@@ -306,102 +436,53 @@ void *buddy_realloc(intptr_t id, void *ptr, size_t size) /* FIXME: need to be te
                 return NULL;
         }
 
-        /* determine offset, then search old node in the tree */
-        size_t offset = (uint8_t *)ptr - p->pool;
-        if(offset < 0 || offset >= p->size) {
+        /* search old node in the tree */
+        a = arena_find(p, ptr);
+        if(NULL == a) {
                 RPT(RPT_ERR, "realloc: bad ptr: %p, out of pool", ptr);
                 return NULL;
         }
 
-        size_t old_order = p->omin;
-        size_t oi = 0; /* index of binary tree array */
-        size_t found = 0;
-        while(offset % (1<<old_order) == 0) {
-                oi = (1<<(p->omax - old_order)) - 1 + offset / (1<<old_order);
-                if(0 == p->tree[oi]) {
-                        found = 1;
-                        break;
-                }
-                old_order++;
-        }
-        if(!found) {
+        size_t oi; /* index of binary tree array */
+        size_t old_order = node_order(p, a, ptr, &oi);
+        if(0 == old_order) {
                 RPT(RPT_ERR, "realloc: bad ptr: %p, illegal node or module bug", ptr);
                 return NULL;
         }
 
-        /* determine new_order in tree */
-        size_t new_order = MAX(smallest_order(size), p->omin);
-        if((int)(p->tree[0]) < new_order) {
-                RPT(RPT_ERR, "realloc: not enough space in pool");
-                return NULL;
-        }
-
         /* maybe do not need to realloc */
+        size_t new_order = MAX(smallest_order(size), p->omin);
         if(new_order <= old_order) {
                 return ptr;
         }
 
-        /* search new node in the tree */
-        size_t ni = 0; /* index of binary tree array */
-        for(size_t current_order = p->omax; current_order > new_order; current_order--) {
-                if(p->tree[LSUBTREE(ni)] >= new_order) {
-                        ni = LSUBTREE(ni);
-                }
-                else {
-                        ni = RSUBTREE(ni);
-                }
+        /* new node maybe in another arena */
+        uint8_t *rslt = buddy_malloc(id, size);
+        if(NULL == rslt) {
+                return NULL;
         }
-
-        uint8_t *rslt = (p->pool + (ni + 1) * (1<<new_order) - (p->size));
         RPT(RPT_DBG, "realloc: @ %p %zX %zX", rslt, (size_t)1 << new_order, size);
 
-        /* modify tree for new */
-        p->tree[ni] = 0;
-        while(ni) {
-                ni = PARENT(ni);
-                p->tree[ni] = MAX(p->tree[LSUBTREE(ni)], p->tree[RSUBTREE(ni)]) ;
-        }
-
         /* copy data */
         memcpy(rslt, ptr, (1<<old_order));
 
-        /* modify tree for old */
-        size_t lorder;
-        size_t rorder;
+        /* free old */
         RPT(RPT_DBG, "realloc: @ %p %zX", ptr, (size_t)1 << old_order);
-        p->tree[oi] = old_order;
-        while(oi) {
-                oi = PARENT(oi) ;
-                old_order++;
-
-                lorder = p->tree[LSUBTREE(oi)];
-                rorder = p->tree[RSUBTREE(oi)];
-                if(lorder == (old_order - 1) &&
-                   rorder == (old_order - 1)) {
-                        p->tree[oi] = old_order;
-                }
-                else {
-                        p->tree[oi] = MAX(lorder, rorder);
-                }
-        }
-
+        buddy_free(id, ptr);
         return rslt;
 }
 
 void buddy_free(intptr_t id, void *ptr)
 {
         struct buddy_pool *p = (struct buddy_pool *)id;
+        struct buddy_arena *a;
 
         if(NULL == p) {
                 RPT(RPT_ERR, "free: bad id");
                 return;
         }
-        if(NULL == p->tree) {
-                RPT(RPT_ERR, "free: bad tree");
-                return;
-        }
-        if(NULL == p->pool) {
-                RPT(RPT_ERR, "free: bad pool");
+        if(NULL == p->arena0) {
+                RPT(RPT_ERR, "free: bad arena");
                 return;
         }
         if(NULL == ptr) {
@@ -409,52 +490,412 @@ void buddy_free(intptr_t id, void *ptr)
                 return;
         }
 
-        /* determine offset, then search aim node in the tree */
-        size_t offset = (uint8_t *)ptr - p->pool;
-        if(offset < 0 || offset >= p->size) {
+#ifdef BUDDY_MT
+        if(p->is_mt) {
+                mt_free(p, ptr);
+                return;
+        }
+#endif
+
+        /* determine arena, then search aim node in the tree */
+        a = arena_find(p, ptr);
+        if(NULL == a) {
                 RPT(RPT_ERR, "free: bad ptr: %p, out of pool", ptr);
                 return;
         }
 
-        size_t order = p->omin;
+        size_t i; /* index of binary tree array */
+        size_t order = node_order(p, a, ptr, &i);
+        if(0 == order) {
+                RPT(RPT_ERR, "free: bad ptr: %p, illegal node or module bug", ptr);
+                return;
+        }
+
+        RPT(RPT_DBG, "free:    @ %p %zX", ptr, (size_t)1 << order);
+        arena_release(p, a, i, order);
+        arena_reclaim(p, a);
+        return;
+}
+
+static struct buddy_arena *arena_create(struct buddy_pool *p)
+{
+        struct buddy_arena *a = (struct buddy_arena *)malloc(sizeof(struct buddy_arena));
+        if(NULL == a) {
+                RPT(RPT_ERR, "create: create arena object failed");
+                return NULL;
+        }
+
+        a->tree = (uint8_t *)malloc(p->tree_size); /* FIXME: memalign? */
+        if(NULL == a->tree) {
+                RPT(RPT_ERR, "create: malloc tree(%zd-byte) failed", p->tree_size);
+                free(a);
+                return NULL;
+        }
+        RPT(RPT_DBG, "create: tree: %8zX-byte @ %p", p->tree_size, a->tree);
+
+        a->pool = (uint8_t *)malloc(p->size); /* FIXME: memalign? */
+        if(NULL == a->pool) {
+                RPT(RPT_ERR, "create: malloc pool(%zd-byte) failed", p->size);
+                free(a->tree);
+                free(a);
+                return NULL;
+        }
+        RPT(RPT_DBG, "create: pool: %8zX-byte @ %p", p->size, a->pool);
+
+        a->omap = NULL;
+        if(p->is_mt) {
+                a->omap = (uint8_t *)malloc((size_t)1 << (p->omax - p->omin));
+                if(NULL == a->omap) {
+                        RPT(RPT_ERR, "create: malloc omap failed");
+                        free(a->pool);
+                        free(a->tree);
+                        free(a);
+                        return NULL;
+                }
+        }
+
+        a->next = NULL;
+        p->arena_cnt++;
+        return a;
+}
+
+static void arena_destroy(struct buddy_arena *a)
+{
+        if(a->omap) {
+                free(a->omap);
+        }
+        free(a->pool);
+        free(a->tree);
+        free(a);
+        return;
+}
+
+static void arena_init(struct buddy_pool *p, struct buddy_arena *a)
+{
+        for(size_t order = p->omax + 1, i = 0; i < p->tree_size; i++) {
+                if(IS_POWER_OF_2(i + 1)) {
+                        order--;
+                }
+                a->tree[i] = order;
+        }
+        return;
+}
+
+static void *arena_malloc(struct buddy_pool *p, struct buddy_arena *a, size_t order)
+{
+        if((int)(a->tree[0]) < order) {
+                return NULL; /* not enough space in this arena */
+        }
+
+        /* search aim node in the tree */
         size_t i = 0; /* index of binary tree array */
-        int found = 0;
-        while(offset % (1<<order) == 0) {
+        for(size_t current_order = p->omax; current_order > order; current_order--) {
+                if(a->tree[LSUBTREE(i)] >= order) {
+                        i = LSUBTREE(i);
+                }
+                else {
+                        i = RSUBTREE(i);
+                }
+        }
+        a->tree[i] = 0; /* find the aim node */
+
+        uint8_t *rslt = (a->pool + (i + 1) * (1<<order) - (p->size));
+        RPT(RPT_DBG, "malloc:  @ %p %zX", rslt, (size_t)1 << order);
+        if(a->omap) {
+                a->omap[(rslt - a->pool) >> p->omin] = order;
+        }
+
+        /* modify parent order */
+        while(i) {
+                i = PARENT(i);
+                a->tree[i] = MAX(a->tree[LSUBTREE(i)], a->tree[RSUBTREE(i)]) ;
+        }
+
+        return rslt;
+}
+
+/* order of the node malloced at ptr, 0 if not found */
+static size_t arena_order(struct buddy_pool *p, struct buddy_arena *a, void *ptr, size_t *index)
+{
+        size_t offset = (uint8_t *)ptr - a->pool;
+        size_t order = p->omin;
+        size_t i;
+
+        while(order <= p->omax && offset % (1<<order) == 0) {
                 i = (1<<(p->omax - order)) - 1 + offset / (1<<order);
-                if(0 == p->tree[i]) {
-                        found = 1;
-                        break;
+                if(0 == a->tree[i]) {
+                        *index = i;
+                        return order;
                 }
                 order++;
         }
-        if(!found) {
-                RPT(RPT_ERR, "free: bad ptr: %p, illegal node or module bug", ptr);
-                return;
-        }
+        return 0;
+}
 
-        /* modify tree */
+/* mark node i of order as free, then merge with its buddy */
+static void arena_release(struct buddy_pool *p, struct buddy_arena *a, size_t i, size_t order)
+{
         size_t lorder;
         size_t rorder;
-        RPT(RPT_DBG, "free:    @ %p %zX", ptr, (size_t)1 << order);
-        p->tree[i] = order;
+
+        a->tree[i] = order;
         while(i) {
                 i = PARENT(i) ;
                 order++;
 
-                lorder = p->tree[LSUBTREE(i)];
-                rorder = p->tree[RSUBTREE(i)];
+                lorder = a->tree[LSUBTREE(i)];
+                rorder = a->tree[RSUBTREE(i)];
                 if(lorder == (order - 1) &&
                    rorder == (order - 1)) {
-                        p->tree[i] = order;
+                        a->tree[i] = order;
                 }
                 else {
-                        p->tree[i] = MAX(lorder, rorder);
+                        a->tree[i] = MAX(lorder, rorder);
                 }
         }
+        return;
+}
 
+static struct buddy_arena *arena_find(struct buddy_pool *p, void *ptr)
+{
+        struct buddy_arena *a;
+
+        for(a = p->arena0; a; a = __atomic_load_n(&(a->next), __ATOMIC_ACQUIRE)) {
+                uint8_t *pool = __atomic_load_n(&(a->pool), __ATOMIC_ACQUIRE);
+
+                if(pool && (uint8_t *)ptr >= pool && (uint8_t *)ptr < pool + p->size) {
+                        return a;
+                }
+        }
+        return NULL;
+}
+
+/* return empty arena to OS, except the first one,
+ * keep it if no other arena is empty, to avoid add and del again and again
+ * shared pool: arena_find() runs without lock, so the arena stays in list and sleeps,
+ * only its buffer is returned, arena_wake() gives it a new one */
+static void arena_reclaim(struct buddy_pool *p, struct buddy_arena *a)
+{
+        struct buddy_arena *prev = NULL;
+        struct buddy_arena *x;
+        int has_empty = 0;
+
+        if(a == p->arena0 || a->tree[0] != p->omax) {
+                return;
+        }
+
+        for(x = p->arena0; x; x = x->next) {
+                if(x->next == a) {
+                        prev = x;
+                }
+                if(x != a && x->pool && x->tree[0] == p->omax) {
+                        has_empty = 1;
+                }
+        }
+        if(!has_empty) {
+                return;
+        }
+
+        p->arena_cnt--;
+        if(p->is_mt) {
+                uint8_t *pool = a->pool;
+
+                a->tree[0] = 0; /* no space, pool_malloc() will not search in it */
+                __atomic_store_n(&(a->pool), NULL, __ATOMIC_RELEASE);
+                free(pool);
+                RPT(RPT_INF, "free: arena sleeps, %zd left", p->arena_cnt);
+                return;
+        }
+        prev->next = a->next;
+        arena_destroy(a);
+        RPT(RPT_INF, "free: del arena, %zd left", p->arena_cnt);
         return;
 }
 
+/* new buffer for sleeping arena of shared pool */
+static int arena_wake(struct buddy_pool *p, struct buddy_arena *a)
+{
+        uint8_t *pool = (uint8_t *)malloc(p->size);
+
+        if(NULL == pool) {
+                RPT(RPT_ERR, "malloc: malloc pool(%zd-byte) failed", p->size);
+                return -1;
+        }
+        arena_init(p, a);
+        __atomic_store_n(&(a->pool), pool, __ATOMIC_RELEASE); /* arena_find() without lock */
+        p->arena_cnt++;
+        return 0;
+}
+
+/* order of the node malloced at ptr, 0 if not found */
+static size_t node_order(struct buddy_pool *p, struct buddy_arena *a, void *ptr, size_t *index)
+{
+        size_t offset;
+        size_t order;
+
+        if(NULL == a->omap) {
+                return arena_order(p, a, ptr, index);
+        }
+
+        /* shared pool: the tree maybe changed by other thread, use omap */
+        offset = (uint8_t *)ptr - a->pool;
+        order = a->omap[offset >> p->omin];
+        if(order < p->omin || order > p->omax || offset % (1<<order) != 0) {
+                return 0;
+        }
+        *index = (1<<(p->omax - order)) - 1 + offset / (1<<order);
+        return order;
+}
+
+#ifdef BUDDY_MT
+static void lock(struct buddy_pool *p)
+{
+        pthread_mutex_lock(&(p->lock));
+        return;
+}
+
+static void unlock(struct buddy_pool *p)
+{
+        pthread_mutex_unlock(&(p->lock));
+        return;
+}
+
+static void *mt_malloc(struct buddy_pool *p, size_t order)
+{
+        struct buddy_mag *mag;
+        size_t k = order - p->omin;
+        void *rslt;
+
+        mag = (k < MAG_ORDERS) ? mag_get(p) : NULL;
+        if(NULL == mag) {
+                /* big node, or no magazine */
+                lock(p);
+                rslt = pool_malloc(p, order);
+                unlock(p);
+                return rslt;
+        }
+
+        if(0 == mag->cnt[k]) {
+                /* refill half magazine in one lock */
+                lock(p);
+                while(mag->cnt[k] < MAG_SIZE / 2) {
+                        rslt = pool_malloc(p, order);
+                        if(NULL == rslt) {
+                                break;
+                        }
+                        mag->node[k][mag->cnt[k]++] = rslt;
+                }
+                unlock(p);
+                if(0 == mag->cnt[k]) {
+                        return NULL;
+                }
+        }
+        return mag->node[k][--(mag->cnt[k])];
+}
+
+static void mt_free(struct buddy_pool *p, void *ptr)
+{
+        struct buddy_arena *a;
+        struct buddy_mag *mag;
+        size_t i; /* index of binary tree array */
+        size_t order;
+        size_t k;
+
+        a = arena_find(p, ptr);
+        if(NULL == a) {
+                RPT(RPT_ERR, "free: bad ptr: %p, out of pool", ptr);
+                return;
+        }
+        order = node_order(p, a, ptr, &i);
+        if(0 == order) {
+                RPT(RPT_ERR, "free: bad ptr: %p, illegal node or module bug", ptr);
+                return;
+        }
+
+        k = order - p->omin;
+        mag = (k < MAG_ORDERS) ? mag_get(p) : NULL;
+        if(NULL == mag) {
+                lock(p);
+                arena_release(p, a, i, order);
+                arena_reclaim(p, a);
+                unlock(p);
+                return;
+        }
+
+        if(MAG_SIZE == mag->cnt[k]) {
+                /* return half magazine in one lock */
+                lock(p);
+                while(mag->cnt[k] > MAG_SIZE / 2) {
+                        void *node = mag->node[k][--(mag->cnt[k])];
+                        struct buddy_arena *na = arena_find(p, node);
+
+                        order = node_order(p, na, node, &i);
+                        arena_release(p, na, i, order);
+                        arena_reclaim(p, na);
+                }
+                unlock(p);
+        }
+        mag->node[k][mag->cnt[k]++] = ptr;
+        return;
+}
+
+/* magazine of this thread, create it for the first time */
+static struct buddy_mag *mag_get(struct buddy_pool *p)
+{
+        struct buddy_mag *mag = (struct buddy_mag *)pthread_getspecific(p->key);
+
+        if(mag) {
+                return mag;
+        }
+
+        mag = (struct buddy_mag *)malloc(sizeof(struct buddy_mag));
+        if(NULL == mag) {
+                RPT(RPT_WRN, "malloc magazine failed, use pool directly");
+                return NULL;
+        }
+        memset(mag->cnt, 0, sizeof(mag->cnt));
+        mag->p = p;
+
+        lock(p);
+        mag->next = p->mag0;
+        p->mag0 = mag;
+        unlock(p);
+
+        pthread_setspecific(p->key, mag);
+        return mag;
+}
+
+/* thread exit: return all node in magazine to pool */
+static void mag_exit(void *arg)
+{
+        struct buddy_mag *mag = (struct buddy_mag *)arg;
+        struct buddy_pool *p = mag->p;
+        struct buddy_mag **pm;
+
+        lock(p);
+        for(size_t k = 0; k < MAG_ORDERS; k++) {
+                while(mag->cnt[k]) {
+                        void *node = mag->node[k][--(mag->cnt[k])];
+                        struct buddy_arena *a = arena_find(p, node);
+                        size_t i;
+                        size_t order = node_order(p, a, node, &i);
+
+                        arena_release(p, a, i, order);
+                        arena_reclaim(p, a);
+                }
+        }
+        for(pm = &(p->mag0); *pm; pm = &((*pm)->next)) {
+                if(*pm == mag) {
+                        *pm = mag->next;
+                        break;
+                }
+        }
+        unlock(p);
+        free(mag);
+        return;
+}
+#endif
+
 /* get the smallest order to cover the size */
 static size_t smallest_order(size_t size)
 {
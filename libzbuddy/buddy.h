@@ -14,7 +14,13 @@ extern "C" {
 
 #define BUDDY_ORDER_MAX (8 * sizeof(size_t))
 
-intptr_t buddy_create(size_t order_max, size_t order_min);
+intptr_t buddy_create(size_t order_max, size_t order_min); /* arena: (1 << order_max), add arena if needed */
+
+/* pool shared by threads, linux only
+ * each thread keeps recently freed node in its own magazine, and uses the locked tree
+ * only when the magazine is empty or full; buffer of empty arena is returned to OS;
+ * buddy_init() and buddy_destroy() should be called when no other thread uses the pool */
+intptr_t buddy_create_mt(size_t order_max, size_t order_min);
 int buddy_destroy(intptr_t id);
 int buddy_init(intptr_t id);
 int buddy_status(intptr_t id, int enable, const char *hint); /* for debug */
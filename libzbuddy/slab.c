@@ -0,0 +1,233 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: slab.c
+ * funx: slab cache of fixed-size object, page from buddy memory pool
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h> /* for uintN_t, etc */
+
+#include "buddy.h"
+#include "slab.h"
+
+/* report level */
+#define RPT_ERR (1) /* error, system error */
+#define RPT_WRN (2) /* warning, maybe wrong, maybe OK */
+#define RPT_INF (3) /* important information */
+#define RPT_DBG (4) /* debug information */
+
+/* report micro */
+#define RPT(lvl, ...) do \
+{ \
+        if(lvl <= rpt_lvl) \
+        { \
+                switch(lvl) \
+                { \
+                        case RPT_ERR: fprintf(stderr, "%s: %d: err: ", __FILE__, __LINE__); break; \
+                        case RPT_WRN: fprintf(stderr, "%s: %d: wrn: ", __FILE__, __LINE__); break; \
+                        case RPT_INF: fprintf(stderr, "%s: %d: inf: ", __FILE__, __LINE__); break; \
+                        case RPT_DBG: fprintf(stderr, "%s: %d: dbg: ", __FILE__, __LINE__); break; \
+                        default:      fprintf(stderr, "%s: %d: ???: ", __FILE__, __LINE__); break; \
+                } \
+                fprintf(stderr, __VA_ARGS__); \
+                fprintf(stderr, "\n"); \
+        } \
+} while (0)
+
+static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
+
+#define SLAB_ALIGN (sizeof(void *)) /* object alignment */
+
+/* head of each page, objects follow it */
+struct slab_page {
+        struct slab_page *next;
+};
+
+/* free object, the first bytes of object are used as link */
+struct slab_node {
+        struct slab_node *next;
+};
+
+struct slab {
+        intptr_t mp; /* buddy memory pool for page */
+        size_t size; /* object size, aligned */
+        size_t page_size;
+        size_t per_page; /* object count in each page */
+
+        struct slab_page *page0; /* all page, for slab_destroy() */
+        struct slab_node *free0; /* free object list */
+
+        /* statistic */
+        size_t page_cnt;
+        size_t used; /* object in use */
+        size_t peak; /* max of used */
+        size_t malloc_cnt;
+        size_t hit_cnt; /* malloc without new page */
+};
+
+static int new_page(struct slab *slab);
+
+intptr_t slab_create(intptr_t mp, size_t size, size_t page_order)
+{
+        struct slab *slab;
+
+        if(0 == mp) {
+                RPT(RPT_ERR, "create: bad mp");
+                return 0; /* failed */
+        }
+        if(0 == size) {
+                RPT(RPT_ERR, "create: bad size: 0");
+                return 0; /* failed */
+        }
+
+        slab = (struct slab *)malloc(sizeof(struct slab));
+        if(NULL == slab) {
+                RPT(RPT_ERR, "create: malloc slab object failed");
+                return 0; /* failed */
+        }
+
+        if(size < sizeof(struct slab_node)) {
+                size = sizeof(struct slab_node);
+        }
+        slab->mp = mp;
+        slab->size = (size + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+        slab->page_size = (size_t)1 << page_order;
+        if(slab->page_size < sizeof(struct slab_page) + slab->size) {
+                RPT(RPT_ERR, "create: page(0x%zX) is too small for object(0x%zX)",
+                    slab->page_size, slab->size);
+                free(slab);
+                return 0; /* failed */
+        }
+        slab->per_page = (slab->page_size - sizeof(struct slab_page)) / slab->size;
+
+        slab->page0 = NULL;
+        slab->free0 = NULL;
+        slab->page_cnt = 0;
+        slab->used = 0;
+        slab->peak = 0;
+        slab->malloc_cnt = 0;
+        slab->hit_cnt = 0;
+        RPT(RPT_DBG, "create: 0x%zX-byte x %zd per page", slab->size, slab->per_page);
+        return (intptr_t)slab;
+}
+
+int slab_destroy(intptr_t id)
+{
+        struct slab *slab = (struct slab *)id;
+        struct slab_page *page;
+
+        if(NULL == slab) {
+                RPT(RPT_ERR, "destroy: bad id");
+                return -1;
+        }
+
+        while(NULL != (page = slab->page0)) {
+                slab->page0 = page->next;
+                buddy_free(slab->mp, page);
+        }
+        free(slab);
+        return 0;
+}
+
+int slab_status(intptr_t id, int enable, const char *hint)
+{
+        struct slab *slab = (struct slab *)id;
+        size_t total;
+
+        if(NULL == slab) {
+                RPT(RPT_ERR, "status: bad id");
+                return -1;
+        }
+        if(!enable) {
+                RPT(RPT_INF, "status: disable: do nothing");
+                return 0;
+        }
+
+        /* fragmentation: page space not used by object in use */
+        total = slab->page_cnt * slab->page_size;
+        fprintf(stderr, "slab: 0x%zX x %zu used(peak %zu), %zu page x 0x%zX, ",
+                slab->size, slab->used, slab->peak, slab->page_cnt, slab->page_size);
+        fprintf(stderr, "hit %.1f%%, frag %.1f%%",
+                (slab->malloc_cnt) ? 100.0 * slab->hit_cnt / slab->malloc_cnt : 0.0,
+                (total) ? 100.0 - 100.0 * slab->used * slab->size / total : 0.0);
+        fprintf(stderr, ": %s\n", ((hint) ? hint : ""));
+        return 0;
+}
+
+void *slab_malloc(intptr_t id)
+{
+        struct slab *slab = (struct slab *)id;
+        struct slab_node *node;
+
+        if(NULL == slab) {
+                RPT(RPT_ERR, "malloc: bad id");
+                return NULL;
+        }
+
+        slab->malloc_cnt++;
+        if(NULL == slab->free0) {
+                if(0 != new_page(slab)) {
+                        return NULL;
+                }
+        }
+        else {
+                slab->hit_cnt++;
+        }
+
+        node = slab->free0;
+        slab->free0 = node->next;
+        slab->used++;
+        if(slab->peak < slab->used) {
+                slab->peak = slab->used;
+        }
+        return node;
+}
+
+int slab_free(intptr_t id, void *ptr)
+{
+        struct slab *slab = (struct slab *)id;
+        struct slab_node *node = (struct slab_node *)ptr;
+
+        if(NULL == slab) {
+                RPT(RPT_ERR, "free: bad id");
+                return -1;
+        }
+        if(NULL == ptr) {
+                RPT(RPT_ERR, "free: bad ptr");
+                return -1;
+        }
+
+        node->next = slab->free0;
+        slab->free0 = node;
+        slab->used--;
+        return 0;
+}
+
+/* get a page from buddy, cut it into free object */
+static int new_page(struct slab *slab)
+{
+        struct slab_page *page;
+        uint8_t *p;
+        size_t i;
+
+        page = (struct slab_page *)buddy_malloc(slab->mp, slab->page_size);
+        if(NULL == page) {
+                RPT(RPT_ERR, "malloc: get page from buddy failed");
+                return -1;
+        }
+        page->next = slab->page0;
+        slab->page0 = page;
+        slab->page_cnt++;
+
+        /* keep object order in page, the first one is at the head of free list */
+        p = (uint8_t *)(page + 1) + slab->size * slab->per_page;
+        for(i = 0; i < slab->per_page; i++) {
+                struct slab_node *node;
+
+                p -= slab->size;
+                node = (struct slab_node *)p;
+                node->next = slab->free0;
+                slab->free0 = node;
+        }
+        return 0;
+}
@@ -0,0 +1,33 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: slab.h
+ * funx: slab cache of fixed-size object, page from buddy memory pool
+ */
+
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h> /* for intptr_t, etc */
+#include <stddef.h> /* for size_t, etc */
+
+/* object of the same size are cut from one page, and recycled in a free list,
+ * so malloc and free of small node do not need to search the buddy tree
+ *      mp: id of buddy memory pool, buddy_init() should be called before
+ *      size: object size(byte)
+ *      page_order: page size is (1 << page_order) byte, page is kept until slab_destroy() */
+intptr_t slab_create(intptr_t mp, size_t size, size_t page_order);
+int slab_destroy(intptr_t id); /* return all page to buddy memory pool */
+int slab_status(intptr_t id, int enable, const char *hint); /* for debug */
+
+void *slab_malloc(intptr_t id);
+/* ptr must be got by slab_malloc() of this slab; return: 0 for OK, -1 for bad id or ptr */
+int slab_free(intptr_t id, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SLAB_H */
@@ -7,10 +7,17 @@
 #include <stdlib.h>
 #include <stdint.h> /* for uint?_t, etc */
 #include <string.h> /* for memset, memcpy, etc */
+#include <math.h> /* for exp() */
 
 #include "buddy.h"
+#include "slab.h"
 #include "ts.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC_CLMUL /* PCLMULQDQ for CRC-32, check CPU when running */
+#include <immintrin.h>
+#endif
+
 /* report level */
 #define RPT_ERR (1) /* error, system error */
 #define RPT_WRN (2) /* warning, maybe wrong, maybe OK */
@@ -38,6 +45,13 @@
 #define BIT(n) (1<<(n))
 #define NORMAL_SECTION_LENGTH_MAX (1021)
 #define PRIVATE_SECTION_LENGTH_MAX (4093)
+#define SLAB_PAGE_ORDER (12) /* 4KB page from buddy for ts_pid and ts_sect */
+#define CLK_JUMP (1 * STC_1S) /* CTS jump more than this is not time passed */
+#define OJ_TAU ((double)60 * STC_1S) /* PCR_OJ fit forgets PCR packet older than this */
+#define CAT_WAIT (500 * STC_MS) /* scrambled packet before the first CAT is not CAT_error at once */
+#define TB_SIZE (512) /* byte, size of TB_n in T-STD */
+#define TB_RX_VID (96 * 1000 * 1000) /* bit/s, 1.2 * Rmax of MP@HL */
+#define TB_RX_AUD (2 * 1000 * 1000) /* bit/s */
 
 static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
 
@@ -163,6 +177,33 @@ static const struct stream_type_table STREAM_TYPE_TABLE[] = {
         {0xFF, TS_TYPE_UNO}  /* "UNKNOWN", "Unknown stream" loop stop condition! */
 };
 
+/* TR 101 211 repetition of SI table, TR 101 290 3.1 ~ 3.8 */
+struct si_rep_table {
+        uint8_t min; /* table ID range */
+        uint8_t max; /* table ID range */
+        uint16_t PID; /* PID of the table */
+        int idx; /* TS_ERR_xxx of the table, besides TS_ERR_3_2 */
+        int64_t rep_max; /* max interval of the table, 0 means no limit */
+        int64_t rep_min; /* min interval of the same section, 0 means no limit */
+        int is_required; /* bool, report the table missing if its PID is present */
+};
+
+static const struct si_rep_table SI_REP_TABLE[] = {
+        {0x40, 0x40, 0x0010, TS_ERR_3_1A, 10 * STC_1S, 25 * STC_MS, 1}, /* NIT actual */
+        {0x41, 0x41, 0x0010, TS_ERR_3_1B, 10 * STC_1S,           0, 0}, /* NIT other */
+        {0x42, 0x42, 0x0011, TS_ERR_3_5A,  2 * STC_1S, 25 * STC_MS, 1}, /* SDT actual */
+        {0x46, 0x46, 0x0011, TS_ERR_3_5B, 10 * STC_1S,           0, 0}, /* SDT other */
+        {0x4A, 0x4A, 0x0011, TS_ERR_3_2,  10 * STC_1S, 25 * STC_MS, 0}, /* BAT */
+        {0x4E, 0x4E, 0x0012, TS_ERR_3_6A,  2 * STC_1S, 25 * STC_MS, 1}, /* EIT P/F actual */
+        {0x4F, 0x4F, 0x0012, TS_ERR_3_6B, 10 * STC_1S,           0, 0}, /* EIT P/F other */
+        {0x50, 0x5F, 0x0012, TS_ERR_3_2,  30 * STC_1S, 25 * STC_MS, 0}, /* EIT schedule actual */
+        {0x60, 0x6F, 0x0012, TS_ERR_3_2,  30 * STC_1S,           0, 0}, /* EIT schedule other */
+        {0x70, 0x70, 0x0014, TS_ERR_3_8,  30 * STC_1S, 25 * STC_MS, 1}, /* TDT */
+        {0x71, 0x71, 0x0013, TS_ERR_3_7,            0, 25 * STC_MS, 0}, /* RST */
+        {0x73, 0x73, 0x0014, TS_ERR_3_2,  30 * STC_1S, 25 * STC_MS, 0}, /* TOT */
+        {0xFF, 0xFF, 0x1FFF, TS_ERR_MAX,            0,           0, 0}  /* loop stop condition! */
+};
+
 enum {
         /* note, in any state:  */
         /*     * meet new PID -> add to pid_list */
@@ -173,15 +214,30 @@ enum {
         STATE_NEXT_PKT  /* parse packet with current lists */
 };
 
+enum {
+        TMR_PAT, /* PAT not met */
+        TMR_CAT, /* scrambled packet, but CAT not met */
+        TMR_RATE, /* rate window */
+        TMR_TABL, /* repetition of table */
+        TMR_PID /* timeout of PID */
+};
+
 static int init(struct ts_obj *obj);
 static int tidy(struct ts_obj *obj);
 static int state_next_pat(struct ts_obj *obj);
 static int state_next_pmt(struct ts_obj *obj);
 static int state_next_pkt(struct ts_obj *obj);
 
+static int parse_tsh(struct ts_obj *obj); /* TS head of obj->TS */
+static int parse_tsb(struct ts_obj *obj); /* TS body of obj->TS */
+
 static int ts_parse_af(struct ts_obj *obj); /* Adaption Fields information */
 static int ts_ts2sect(struct ts_obj *obj); /* collect PSI/SI section data */
+static int sect_create(struct ts_obj *obj);
+static int sect_append(struct ts_obj *obj, uint8_t *p, int len);
 static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect);
+static struct ts_tabl *sect_tabl(struct ts_obj *obj, struct ts_sect *sect);
+static struct ts_sect *sect_cached(struct ts_obj *obj, struct ts_sect *new_sect);
 static int ts_parse_secb_pat(struct ts_obj *obj);
 static int ts_parse_secb_cat(struct ts_obj *obj);
 static int ts_parse_secb_pmt(struct ts_obj *obj);
@@ -191,15 +247,42 @@ static int ts_parse_pesh_switch(struct ts_obj *obj);
 static int ts_parse_pesh_detail(struct ts_obj *obj);
 
 static struct ts_pid *update_pid_list(struct ts_obj *obj, struct ts_pid *new_pid);
-static int free_pid(intptr_t mp, struct ts_pid *pid);
-static int free_sect(intptr_t mp, struct ts_sect *sect);
-static int free_tabl(intptr_t mp, struct ts_tabl *tabl);
-static int free_prog(intptr_t mp, struct ts_prog *prog);
+static int free_pid(struct ts_obj *obj, struct ts_pid *pid);
+static int free_sect(struct ts_obj *obj, struct ts_sect *sect);
+static int free_tabl(struct ts_obj *obj, struct ts_tabl *tabl);
+static int free_prog(struct ts_obj *obj, struct ts_prog *prog);
 static int is_all_prog_parsed(struct ts_obj *obj);
 static int pid_type(uint16_t pid);
 static const struct table_id_table *table_type(uint8_t id);
 static const struct stream_type_table *elem_type(uint8_t stream_type);
 static int dump(uint8_t *buf, int len);
+static void event(struct ts_obj *obj, int evt);
+static void error(struct ts_obj *obj, int idx);
+static void error_si(struct ts_obj *obj, int idx, int is_rep);
+static const struct si_rep_table *si_rep(uint8_t table_id);
+static void check_sect(struct ts_obj *obj, struct ts_sect *sect, int64_t interval);
+static void on_timer(struct wnode *node, void *arg);
+static void tmr_pat(struct ts_obj *obj);
+static void tmr_cat(struct ts_obj *obj);
+static void tmr_tabl(struct ts_obj *obj, struct ts_tabl *tabl);
+static void tmr_pid(struct ts_obj *obj, struct ts_pid *pid);
+static void tmr_pid_arm(struct ts_obj *obj, struct ts_pid *pid, int64_t expire);
+static int64_t tabl_rep_max(struct ts_tabl *tabl);
+static int64_t clk_min(int64_t a, int64_t b);
+static void pid_tb_init(struct ts_pid *pid);
+static void rate_init(struct ts_obj *obj);
+static void rate_clear(struct ts_obj *obj);
+static void rate_close(struct ts_obj *obj);
+static void rate_pid_clear(struct ts_obj *obj, uint16_t PID);
+static void prog_oj_init(struct ts_prog *prog);
+static void calc_pcr_oj(struct ts_obj *obj, struct ts_prog *prog);
+
+static void crc_table_init(void) __attribute__((constructor)); /* before main() and any thread */
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t *p, size_t size);
+#ifdef CRC_CLMUL
+static uint32_t crc32_xn(int n);
+static uint32_t crc32_clmul(uint32_t crc, const uint8_t *p, size_t size);
+#endif
 
 struct ts_obj *ts_create(intptr_t mp)
 {
@@ -213,13 +296,45 @@ struct ts_obj *ts_create(intptr_t mp)
 
         obj->mp = mp;
 
+        /* slab cache for the node malloc and free frequently */
+        obj->slab_pid = slab_create(mp, sizeof(struct ts_pid), SLAB_PAGE_ORDER);
+        if(0 == obj->slab_pid) {
+                RPT(RPT_ERR, "create slab for pid failed");
+                goto create_failed_with_obj;
+        }
+        obj->slab_sect = slab_create(mp, sizeof(struct ts_sect), SLAB_PAGE_ORDER);
+        if(0 == obj->slab_sect) {
+                RPT(RPT_ERR, "create slab for sect failed");
+                goto create_failed_with_slab_pid;
+        }
+
+        /* timer wheel for timeout check and rate window, 1ms per tick */
+        obj->wheel = wheel_create(STC_MS);
+        if(0 == obj->wheel) {
+                RPT(RPT_ERR, "create timer wheel failed");
+                goto create_failed_with_slab_sect;
+        }
+        wheel_node_init(&(obj->tmr_pat), TMR_PAT, NULL);
+        wheel_node_init(&(obj->tmr_cat), TMR_CAT, NULL);
+        wheel_node_init(&(obj->tmr_rate), TMR_RATE, NULL);
+
         /* prepare for ts_init() */
         /* do NOT forgot to call ts_init() before use */
         obj->pid0 = NULL; /* no pid list now */
+        memset(obj->pid_table, 0, sizeof(obj->pid_table));
         obj->prog0 = NULL; /* no prog list now */
         obj->tabl0 = NULL; /* no tabl list now */
+        memset(obj->evt_cb, 0, sizeof(obj->evt_cb)); /* no event callback now */
 
         return obj;
+
+create_failed_with_slab_sect:
+        slab_destroy(obj->slab_sect);
+create_failed_with_slab_pid:
+        slab_destroy(obj->slab_pid);
+create_failed_with_obj:
+        free(obj);
+        return NULL;
 }
 
 int ts_destroy(struct ts_obj *obj)
@@ -230,6 +345,9 @@ int ts_destroy(struct ts_obj *obj)
         }
 
         init(obj); /* free all list */
+        wheel_destroy(obj->wheel);
+        slab_destroy(obj->slab_sect);
+        slab_destroy(obj->slab_pid);
         free(obj);
         return 0;
 }
@@ -257,6 +375,10 @@ int ts_ioctl(struct ts_obj *obj, int cmd, intptr_t arg)
                 case TS_TIDY:
                         tidy(obj);
                         break;
+                case TS_MEM:
+                        slab_status(obj->slab_pid, (int)arg, "pid");
+                        slab_status(obj->slab_sect, (int)arg, "sect");
+                        break;
                 default:
                         RPT(RPT_ERR, "bad cmd");
                         break;
@@ -264,30 +386,51 @@ int ts_ioctl(struct ts_obj *obj, int cmd, intptr_t arg)
         return 0;
 }
 
+int ts_event(struct ts_obj *obj, int evt, ts_event_cb cb, void *arg)
+{
+        if(!obj) {
+                RPT(RPT_ERR, "bad obj");
+                return -1;
+        }
+        if(evt < 0 || evt >= TS_EVT_MAX) {
+                RPT(RPT_ERR, "bad evt(%d)", evt);
+                return -1;
+        }
+
+        obj->evt_cb[evt] = cb;
+        obj->evt_arg[evt] = arg;
+        return 0;
+}
+
 static int init(struct ts_obj *obj)
 {
+        /* clear the timer, before the node in list is freed */
+        wheel_reset(obj->wheel, 0);
+
         /* clear the pid list */
         struct ts_pid *pid;
         while(NULL != (pid = (struct ts_pid *)zlst_pop(&(obj->pid0)))) {
-                free_pid(obj->mp, pid);
+                free_pid(obj, pid);
         }
         obj->pid0 = NULL;
+        memset(obj->pid_table, 0, sizeof(obj->pid_table));
 
         /* clear the prog list */
         struct ts_prog *prog;
         while(NULL != (prog = (struct ts_prog *)zlst_pop(&(obj->prog0)))) {
-                free_prog(obj->mp, prog);
+                free_prog(obj, prog);
         }
         obj->prog0 = NULL;
 
         /* clear the table list */
         struct ts_tabl *tabl;
         while(NULL != (tabl = (struct ts_tabl *)zlst_pop(&(obj->tabl0)))) {
-                free_tabl(obj->mp, tabl);
+                free_tabl(obj, tabl);
         }
         obj->tabl0 = NULL;
 
         obj->state = STATE_NEXT_PAT;
+        obj->TS = obj->ipt.TS;
         obj->ADDR = -TS_PKT_SIZE; /* count from 0 */
         obj->cnt = -1; /* count ts packet from 0 */
         obj->has_got_transport_stream_id = 0;
@@ -295,15 +438,24 @@ static int init(struct ts_obj *obj)
         obj->CC_lost = 0;
         obj->is_pat_pmt_parsed = 0;
         obj->is_psi_si_parsed = 0;
+        obj->is_cat_seen = 0;
         obj->concerned_pid = 0x0000; /* PAT_PID */
         obj->interval = 0;
+        rate_init(obj);
         obj->CTS = 0L;
         obj->CTS0 = 0L;
         obj->lCTS = 0L; /* for MTS file only, must init as 0L */
         obj->STC = STC_OVF;
+        obj->CLK = 0L;
+        obj->CLK_CTS = obj->CTS;
+
+        /* PAT should be met in 0.5s; rate window is due at once, as CTS0 is 0 */
+        wheel_add(obj->wheel, &(obj->tmr_pat), obj->CLK + 500 * STC_MS);
+        wheel_add(obj->wheel, &(obj->tmr_rate), obj->CLK);
+        obj->is_rate_due = 0;
 
         memset(&(obj->err), 0, sizeof(struct ts_err)); /* no error */
-        memset(&(obj->cfg), 0, sizeof(struct ts_cfg)); /* do nothing */
+        memset(&(obj->cfg), 0, sizeof(struct ts_cfg)); /* do nothing, but check CRC_32 of each section */
 
         return 0;
 }
@@ -316,14 +468,28 @@ static int tidy(struct ts_obj *obj)
         struct ts_tabl *tabl;
         struct ts_pid *pid;
 
+        /* node from xml2list has no timer, init all of them */
+        wheel_reset(obj->wheel, obj->CLK);
+        for(pid = obj->pid0; pid; pid = (struct ts_pid *)(((struct znode *)pid)->next)) {
+                wheel_node_init(&(pid->tmr), TMR_PID, pid);
+        }
+        for(prog = obj->prog0; prog; prog = (struct ts_prog *)(((struct znode *)prog)->next)) {
+                wheel_node_init(&(prog->tabl.tmr), TMR_TABL, &(prog->tabl));
+        }
+        for(tabl = obj->tabl0; tabl; tabl = (struct ts_tabl *)(((struct znode *)tabl)->next)) {
+                wheel_node_init(&(tabl->tmr), TMR_TABL, tabl);
+        }
+        wheel_add(obj->wheel, &(obj->tmr_pat), obj->CLK + 500 * STC_MS);
+        wheel_add(obj->wheel, &(obj->tmr_rate), obj->CLK);
+        obj->is_cat_seen = (NULL != zlst_search(&(obj->tabl0), 0x01));
+
         /* add PAT pid */
         if(obj->prog0) {
                 new_pid.PID = 0x0000;
                 new_pid.type = TS_TYPE_PAT;
                 new_pid.prog = obj->prog0;
                 new_pid.elem = NULL;
-                new_pid.cnt = 0;
-                new_pid.lcnt = 0;
+                new_pid.CC = 0;
                 new_pid.is_CC_sync = 0;
                 update_pid_list(obj, &new_pid);
                 RPT(RPT_INF, "add pat pid: 0x%04X", new_pid.PID);
@@ -334,19 +500,21 @@ static int tidy(struct ts_obj *obj)
                 RPT(RPT_INF, "tidy prog: %d", prog->program_number);
                 prog->is_parsed = 1;
                 prog->tabl.STC = STC_OVF;
+                prog->tabl.CLK = obj->CLK;
+                wheel_add(obj->wheel, &(prog->tabl.tmr), prog->tabl.CLK + 500 * STC_MS);
                 prog->ADDa = 0;
                 prog->PCRa = STC_OVF;
                 prog->ADDb = 0;
                 prog->PCRb = STC_OVF;
                 prog->is_STC_sync = 0;
+                prog_oj_init(prog);
 
                 /* add PMT pid */
                 new_pid.PID = prog->PMT_PID;
                 new_pid.type = TS_TYPE_PMT;
                 new_pid.prog = prog;
                 new_pid.elem = NULL;
-                new_pid.cnt = 0;
-                new_pid.lcnt = 0;
+                new_pid.CC = 0;
                 new_pid.is_CC_sync = 0;
                 update_pid_list(obj, &new_pid);
                 RPT(RPT_INF, "add pmt pid: 0x%04X", new_pid.PID);
@@ -356,8 +524,7 @@ static int tidy(struct ts_obj *obj)
                 new_pid.type = ((0x1FFF != new_pid.PID) ? TS_TYPE_PCR : TS_TYPE_NULP);
                 new_pid.prog = prog;
                 new_pid.elem = NULL;
-                new_pid.cnt = 0;
-                new_pid.lcnt = 0;
+                new_pid.CC = 0;
                 new_pid.is_CC_sync = 0;
                 update_pid_list(obj, &new_pid);
                 RPT(RPT_INF, "add pcr pid: 0x%04X", new_pid.PID);
@@ -367,6 +534,7 @@ static int tidy(struct ts_obj *obj)
                         RPT(RPT_INF, "tidy elem: 0x%04X", elem->PID);
                         elem->PTS = STC_BASE_OVF;
                         elem->DTS = STC_BASE_OVF;
+                        elem->PTS_CLK = -1;
                         elem->is_pes_align = 0;
 
                         /* add elem pid */
@@ -374,8 +542,7 @@ static int tidy(struct ts_obj *obj)
                         new_pid.type = elem->type;
                         new_pid.prog = prog;
                         new_pid.elem = elem;
-                        new_pid.cnt = 0;
-                        new_pid.lcnt = 0;
+                        new_pid.CC = 0;
                         new_pid.is_CC_sync = 0;
                         update_pid_list(obj, &new_pid);
                         RPT(RPT_INF, "add elem pid: 0x%04X", new_pid.PID);
@@ -386,11 +553,17 @@ static int tidy(struct ts_obj *obj)
         for(tabl = obj->tabl0; tabl; tabl = (struct ts_tabl *)(((struct znode *)tabl)->next)) {
                 RPT(RPT_INF, "tidy tabl: 0x%02X", tabl->table_id);
                 tabl->STC = STC_OVF;
+                tabl->CLK = obj->CLK;
+                if(tabl_rep_max(tabl)) {
+                        wheel_add(obj->wheel, &(tabl->tmr), tabl->CLK + tabl_rep_max(tabl));
+                }
         }
 
-        /* pid list */
+        /* pid list, maybe filled by xml2list, so rebuild pid_table[] */
+        memset(obj->pid_table, 0, sizeof(obj->pid_table));
         for(pid = obj->pid0; pid; pid = (struct ts_pid *)(((struct znode *)pid)->next)) {
                 RPT(RPT_INF, "tidy pid: 0x%02X", pid->PID);
+                obj->pid_table[pid->PID & 0x1FFF] = pid;
                 if((obj->prog0) &&
                    (pid->PID < 0x0020 || pid->PID == 0x1FFF)) {
                         pid->prog = obj->prog0;
@@ -399,9 +572,12 @@ static int tidy(struct ts_obj *obj)
                         /* pid->prog is NULL(by xml2list) or set by front code */
                 }
                 /* pid->elem is NULL(by xml2list) or set by front code */
-                pid->cnt = 0;
-                pid->lcnt = 0;
+                rate_pid_clear(obj, pid->PID);
                 pid->is_CC_sync = 0;
+                pid->CLK = obj->CLK;
+                pid->CLK0 = -1;
+                pid_tb_init(pid);
+                wheel_add(obj->wheel, &(pid->tmr), obj->CLK);
         }
 
         /* obj */
@@ -412,43 +588,53 @@ static int tidy(struct ts_obj *obj)
         return 0;
 }
 
-static int free_pid(intptr_t mp, struct ts_pid *pid)
+static int free_pid(struct ts_obj *obj, struct ts_pid *pid)
 {
-        struct ts_pkt *pkt;
-
-        /* clear the pkt list */
-        while(NULL != (pkt = (struct ts_pkt *)zlst_pop(&(pid->pkt0)))) {
-                buddy_free(mp, pkt);
+        /* clear the section being collected */
+        if(pid->section) {
+                buddy_free(obj->mp, pid->section);
         }
 
-        buddy_free(mp, pid);
+        wheel_del(obj->wheel, &(pid->tmr));
+        if(pid->is_slab) {
+                slab_free(obj->slab_pid, pid);
+        }
+        else {
+                buddy_free(obj->mp, pid); /* imported by xml2list() */
+        }
         return 0;
 }
 
-static int free_sect(intptr_t mp, struct ts_sect *sect)
+static int free_sect(struct ts_obj *obj, struct ts_sect *sect)
 {
         if(sect->section) {
-                buddy_free(mp, sect->section);
+                buddy_free(obj->mp, sect->section);
         }
 
-        buddy_free(mp, sect);
+        if(sect->is_slab) {
+                slab_free(obj->slab_sect, sect);
+        }
+        else {
+                buddy_free(obj->mp, sect); /* imported by xml2list() */
+        }
         return 0;
 }
 
-static int free_tabl(intptr_t mp, struct ts_tabl *tabl)
+static int free_tabl(struct ts_obj *obj, struct ts_tabl *tabl)
 {
         struct ts_sect *sect;
 
         /* clear the sect list */
         while(NULL != (sect = (struct ts_sect *)zlst_pop(&(tabl->sect0)))) {
-                free_sect(mp, sect);
+                free_sect(obj, sect);
         }
 
-        buddy_free(mp, tabl);
+        wheel_del(obj->wheel, &(tabl->tmr));
+        buddy_free(obj->mp, tabl);
         return 0;
 }
 
-static int free_prog(intptr_t mp, struct ts_prog *prog)
+static int free_prog(struct ts_obj *obj, struct ts_prog *prog)
 {
         struct ts_elem *elem;
         struct ts_sect *sect;
@@ -456,49 +642,114 @@ static int free_prog(intptr_t mp, struct ts_prog *prog)
         /* clear the elem list */
         while(NULL != (elem = (struct ts_elem *)zlst_pop(&(prog->elem0)))) {
                 if(elem->es_info) {
-                        buddy_free(mp, elem->es_info);
+                        buddy_free(obj->mp, elem->es_info);
                         elem->es_info_len = 0;
                 }
-                buddy_free(mp, elem);
+                buddy_free(obj->mp, elem);
         }
 
         /* clear the sect list */
         while(NULL != (sect = (struct ts_sect *)zlst_pop(&(prog->tabl.sect0)))) {
-                free_sect(mp, sect);
+                free_sect(obj, sect);
         }
+        wheel_del(obj->wheel, &(prog->tabl.tmr));
 
         if(prog->program_info) {
-                buddy_free(mp, prog->program_info);
+                buddy_free(obj->mp, prog->program_info);
                 prog->program_info_len = 0;
         }
         if(prog->service_name) {
-                buddy_free(mp, prog->service_name);
+                buddy_free(obj->mp, prog->service_name);
                 prog->service_name_len = 0;
         }
         if(prog->service_provider) {
-                buddy_free(mp, prog->service_provider);
+                buddy_free(obj->mp, prog->service_provider);
                 prog->service_provider_len = 0;
         }
-        buddy_free(mp, prog);
+        buddy_free(obj->mp, prog);
         return 0;
 }
 
 int ts_parse_tsh(struct ts_obj *obj)
 {
-        struct ts_ipt *ipt;
-
         if(!obj) {
                 RPT(RPT_ERR, "ts_parse_tsh: bad obj");
                 return -1;
         }
-        ipt = &(obj->ipt);
 
         /* TS[] */
-        if(!(ipt->has_ts)) {
+        if(!(obj->ipt.has_ts)) {
                 RPT(RPT_ERR, "ts_parse_tsh: no ts packet");
                 return -1;
         }
-        obj->cur = ipt->TS;
+        obj->TS = obj->ipt.TS;
+
+        return parse_tsh(obj);
+}
+
+int ts_parse_tsb(struct ts_obj *obj)
+{
+        if(!obj) {
+                RPT(RPT_ERR, "bad obj");
+                return -1;
+        }
+
+        return parse_tsb(obj);
+}
+
+int ts_parse_batch(struct ts_obj *obj, uint8_t *buf, int n, int stride,
+                   const int64_t *ADDR, const int64_t *MTS, ts_batch_cb cb, void *arg)
+{
+        int i;
+        int rslt;
+        struct ts_ipt *ipt;
+
+        if(!obj) {
+                RPT(RPT_ERR, "ts_parse_batch: bad obj");
+                return -1;
+        }
+        if(!buf || n < 0 || stride < TS_PKT_SIZE) {
+                RPT(RPT_ERR, "ts_parse_batch: bad buf(%p), n(%d) or stride(%d)", buf, n, stride);
+                return -1;
+        }
+
+        /* the same for all packets in buf[] */
+        ipt = &(obj->ipt);
+        ipt->has_ts = 1;
+        ipt->has_rs = ((TS_PKT_SIZE + 16 == stride) ? 1 : 0); /* TSRS: RS follows TS */
+        ipt->has_addr = (ADDR ? 1 : 0);
+        ipt->has_mts = (MTS ? 1 : 0);
+        ipt->has_cts = 0;
+
+        for(i = 0; i < n; i++, buf += stride) {
+                obj->TS = buf; /* use data in buf[] directly */
+                if(ADDR) {
+                        ipt->ADDR = ADDR[i];
+                }
+                if(MTS) {
+                        ipt->MTS = MTS[i];
+                }
+                if(ipt->has_rs) {
+                        memcpy(ipt->RS, buf + TS_PKT_SIZE, 16);
+                }
+
+                if(0 != parse_tsh(obj)) {
+                        return -1;
+                }
+                parse_tsb(obj);
+
+                if(cb && (0 != (rslt = cb(obj, arg)))) {
+                        return rslt;
+                }
+        }
+        return 0;
+}
+
+static int parse_tsh(struct ts_obj *obj)
+{
+        struct ts_ipt *ipt = &(obj->ipt);
+
+        obj->cur = obj->TS;
         obj->tail = obj->cur + TS_PKT_SIZE;
 
         /* packet count and ADDR */
@@ -506,7 +757,7 @@ int ts_parse_tsh(struct ts_obj *obj)
         obj->ADDR = (ipt->has_addr) ? (ipt->ADDR) : (obj->ADDR + TS_PKT_SIZE);
 #if 0
         RPT(RPT_INF, "packet %lld @ %lld:", obj->cnt, obj->ADDR);
-        dump(ipt->TS, TS_PKT_SIZE); /* debug only */
+        dump(obj->TS, TS_PKT_SIZE); /* debug only */
 #endif
 
         uint8_t dat;
@@ -516,6 +767,7 @@ int ts_parse_tsh(struct ts_obj *obj)
         /* init for a new ts packet */
         obj->AF_len = 0; /* no AF */
         obj->has_pcr = 0; /* no PCR */
+        obj->has_oj = 0;
         obj->PES_len = 0; /* no PES */
         obj->has_pts = 0; /* no PTS */
         obj->has_dts = 0; /* no DTS */
@@ -523,17 +775,27 @@ int ts_parse_tsh(struct ts_obj *obj)
         obj->is_psi_si = 0; /* not PSI/SI */
         obj->sect = NULL; /* not an end of a section */
         obj->has_rate = 0; /* not a new rate calculate peroid */
+        err->mask = 0; /* no error */
 
         /* begin */
         dat = *(obj->cur)++;
         tsh->sync_byte = dat;
         if(0x47 != tsh->sync_byte) {
                 err->Sync_byte_error++;
+                err->mask |= BIT(TS_ERR_1_2);
+                if(1 == err->Sync_byte_error) {
+                        err->cnt[TS_ERR_1_2]++; /* count the first one */
+                }
                 if(err->Sync_byte_error > 1) {
                         err->TS_sync_loss++;
+                        err->mask |= BIT(TS_ERR_1_1);
+                        if(1 == err->TS_sync_loss) {
+                                err->cnt[TS_ERR_1_1]++; /* count the first one */
+                        }
                 }
+                event(obj, TS_EVT_ERR);
                 RPT(RPT_ERR, "sync_byte(0x%02X) error!", tsh->sync_byte);
-                dump(ipt->TS, TS_PKT_SIZE);
+                dump(obj->TS, TS_PKT_SIZE);
         }
         else {
                 err->TS_sync_loss = 0;
@@ -546,6 +808,9 @@ int ts_parse_tsh(struct ts_obj *obj)
         tsh->transport_priority = (dat & BIT(5)) >> 5;
         tsh->PID = dat & 0x1F;
         err->Transport_error = tsh->transport_error_indicator;
+        if(err->Transport_error) {
+                error(obj, TS_ERR_2_1);
+        }
 
         dat = *(obj->cur)++;
         tsh->PID <<= 8;
@@ -572,7 +837,7 @@ int ts_parse_tsh(struct ts_obj *obj)
 #if 0
         RPT(RPT_DBG, "search 0x%04X in pid_list", obj->PID);
 #endif
-        obj->pid = (struct ts_pid *)zlst_search(&(obj->pid0), obj->PID);
+        obj->pid = obj->pid_table[obj->PID];
         if(!(obj->pid)) {
                 struct ts_pid ts_pid, *new_pid = &ts_pid;
 
@@ -587,8 +852,7 @@ int ts_parse_tsh(struct ts_obj *obj)
                         new_pid->prog = NULL;
                 }
                 new_pid->elem = NULL;
-                new_pid->cnt = 1;
-                new_pid->lcnt = 0;
+                new_pid->CC = 0;
                 new_pid->is_CC_sync = 0;
 
                 obj->pid = update_pid_list(obj, new_pid);
@@ -665,15 +929,38 @@ int ts_parse_tsh(struct ts_obj *obj)
                 obj->STC_ext = obj->STC % 300;
                 obj->CTS_base = obj->CTS / 300;
                 obj->CTS_ext = obj->CTS % 300;
+
+                /* CLK: time for timer wheel, follow CTS without overflow */
+                int64_t dCLK = ts_timestamp_diff(obj->CTS, obj->CLK_CTS, STC_OVF);
+
+                if(0 <= dCLK && dCLK < CLK_JUMP) {
+                        obj->CLK += dCLK;
+                        obj->CLK_CTS = obj->CTS;
+                }
+                else if(dCLK <= -CLK_JUMP || CLK_JUMP <= dCLK) {
+                        obj->CLK_CTS = obj->CTS; /* jump, not time passed */
+                }
+                else {
+                        /* CTS steps back a little, e.g. new PCR: hold CLK until CTS passes CLK_CTS */
+                }
+                if(pid) {
+                        pid->CLK = obj->CLK; /* last seen */
+                }
         }
 
         /* statistic */
         if(obj->cfg.need_statistic) {
-                pid->cnt++;
-                obj->sys_cnt++;
-                obj->nul_cnt += ((0x1FFF == tsh->PID) ? 1 : 0);
+                struct ts_rate *rate = obj->rate_cur;
+
+                if(rate->tag[tsh->PID] != rate->epoch) {
+                        rate->tag[tsh->PID] = rate->epoch; /* first packet of PID in this window */
+                        rate->cnt[tsh->PID] = 0;
+                }
+                rate->cnt[tsh->PID]++;
+                rate->sys_cnt++;
+                rate->nul_cnt += ((0x1FFF == tsh->PID) ? 1 : 0);
                 if((tsh->PID < 0x0020) || IS_TYPE(TS_TYPE_PMT, pid->type)) {
-                        obj->psi_cnt++;
+                        rate->psi_cnt++;
                         obj->is_psi_si = 1;
                 }
         }
@@ -685,16 +972,16 @@ int ts_parse_tsh(struct ts_obj *obj)
                 }
         }
 
+        /* TR 101 290 check about timeout, and rate window */
+        if(obj->cfg.need_timestamp) {
+                wheel_run(obj->wheel, obj->CLK, on_timer, obj);
+        }
+
         return 0;
 }
 
-int ts_parse_tsb(struct ts_obj *obj)
+static int parse_tsb(struct ts_obj *obj)
 {
-        if(!obj) {
-                RPT(RPT_ERR, "bad obj");
-                return -1;
-        }
-
         switch(obj->state) {
                 case STATE_NEXT_PAT:
                         state_next_pat(obj);
@@ -762,7 +1049,7 @@ static int state_next_pmt(struct ts_obj *obj)
         struct ts_pid *pid;
 
         RPT(RPT_DBG, "search 0x%04X in pid_list", tsh->PID);
-        pid = (struct ts_pid *)zlst_search(&(obj->pid0), tsh->PID);
+        pid = obj->pid_table[tsh->PID];
         if((!pid) || !IS_TYPE(TS_TYPE_PMT, pid->type)) {
                 return -1; /* not PMT */
         }
@@ -821,6 +1108,47 @@ static int state_next_pkt(struct ts_obj *obj)
                 }
                 pid->CC = tsh->continuity_counter; /* update CC */
                 err->Continuity_count_error = (0x1FFF == tsh->PID) ? 0 : obj->CC_lost;
+                if(err->Continuity_count_error) {
+                        error(obj, TS_ERR_1_4);
+                }
+        }
+
+        /* CAT_error(scrambled packet without CAT), checked by tmr_cat() after CAT_WAIT */
+        if(0x00 != tsh->transport_scrambling_control) {
+                if(!(obj->is_cat_seen) && !(obj->tmr_cat.pprev)) {
+                        wheel_add(obj->wheel, &(obj->tmr_cat), obj->CLK + CAT_WAIT);
+                }
+                if(elem) {
+                        elem->PTS_CLK = -1; /* no PTS to check */
+                }
+        }
+
+        /* TB_n of T-STD, for Buffer_error and Empty_buffer_error */
+        if(pid->TB_Rx && prog && prog->is_STC_sync) {
+                if(STC_OVF != pid->TB_STC) {
+                        int64_t dSTC = ts_timestamp_diff(obj->STC, pid->TB_STC, STC_OVF);
+                        double leak = (double)dSTC * pid->TB_Rx / 8 / STC_1S;
+
+                        if(dSTC < 0 || pid->TB <= leak) {
+                                pid->TB = 0.0;
+                                pid->TB_empty = obj->CLK;
+                        }
+                        else {
+                                pid->TB -= leak;
+                        }
+                }
+                else {
+                        pid->TB_empty = obj->CLK; /* start of TB model */
+                        tmr_pid_arm(obj, pid, obj->CLK + 1 * STC_1S);
+                }
+                pid->TB_STC = obj->STC;
+                pid->TB_CLK = obj->CLK;
+                pid->TB += TS_PKT_SIZE;
+                if(pid->TB > TB_SIZE) {
+                        err->Buffer_error = 1;
+                        error(obj, TS_ERR_3_3);
+                        pid->TB = TB_SIZE; /* overflow, the rest is lost */
+                }
         }
 
         /* PCR flush */
@@ -847,6 +1175,7 @@ static int state_next_pkt(struct ts_obj *obj)
                                    !(0 < obj->PCR_interval && obj->PCR_interval <= 40 * STC_MS)) {
                                         /* !(0 < interval < +40ms) */
                                         err->PCR_repetition_error = 1;
+                                        error(obj, TS_ERR_2_3A);
                                 }
                         }
                         else {
@@ -860,6 +1189,7 @@ static int state_next_pkt(struct ts_obj *obj)
                                    !(0 < obj->PCR_continuity && obj->PCR_continuity <= 100 * STC_MS)) {
                                         /* !(0 < continuity < +100ms) */
                                         err->PCR_discontinuity_indicator_error = 1;
+                                        error(obj, TS_ERR_2_3B);
                                 }
                         }
                         else {
@@ -872,8 +1202,12 @@ static int state_next_pkt(struct ts_obj *obj)
                            !(-13 <= obj->PCR_jitter && obj->PCR_jitter <= +13)) {
                                 /* !(-500ns < jitter < +500ns) */
                                 err->PCR_accuracy_error = 1;
+                                error(obj, TS_ERR_2_4);
                         }
 
+                        /* PCR_OJ and PCR_FO */
+                        calc_pcr_oj(obj, prog);
+
                         /* PCRa: the PCR packet before last PCR packet */
                         prog->PCRa = prog->PCRb;
                         prog->ADDa = prog->ADDb;
@@ -908,64 +1242,41 @@ static int state_next_pkt(struct ts_obj *obj)
                                 /* first count clear */
                                 if(is_first_count_clear &&
                                    prog->PCR_PID == obj->prog0->PCR_PID) {
-                                        struct znode *znode;
-
-                                        for(znode = (struct znode *)(obj->pid0); znode; znode = znode->next) {
-                                                struct ts_pid *pid_item = (struct ts_pid *)znode;
-                                                if(pid_item->prog == prog) {
-                                                        pid_item->lcnt = 0;
-                                                        pid_item->cnt = 0;
-                                                }
-                                        }
-
-                                        obj->last_sys_cnt = 0;
-                                        obj->sys_cnt = 0;
-
-                                        obj->last_psi_cnt = 0;
-                                        obj->psi_cnt = 0;
-
-                                        obj->last_nul_cnt = 0;
-                                        obj->nul_cnt = 0;
-
-                                        obj->last_interval = 0;
+                                        rate_clear(obj);
                                         obj->interval = 0;
-                                        obj->CTS = obj->PCR;
+                                        if(!(obj->ipt.has_cts)) {
+                                                obj->CTS = obj->PCR; /* CTS from ipt is another clock */
+                                        }
                                         obj->CTS0 = obj->CTS;
+                                        obj->CLK_CTS = obj->CTS;
+
+                                        /* restart rate window */
+                                        obj->is_rate_due = 0;
+                                        wheel_add(obj->wheel, &(obj->tmr_rate), obj->CLK + obj->aim_interval);
                                 }
                         }
                 }
                 else {
                         RPT(RPT_ERR, "No program use this PCR packet(0x%04X)!", tsh->PID);
                 }
+                event(obj, TS_EVT_PCR);
         }
 
         /* interval and statistic */
         if(obj->cfg.need_statistic && obj->prog0 && obj->prog0->is_STC_sync) {
                 obj->interval = ts_timestamp_diff(obj->CTS, obj->CTS0, STC_OVF);
-                if(obj->interval >= obj->aim_interval) {
-                        struct znode *znode;
-
+                if(obj->is_rate_due) {
                         /* calc bitrate and clear the packet count */
-                        for(znode = (struct znode *)(obj->pid0); znode; znode = znode->next) {
-                                struct ts_pid *pid_item = (struct ts_pid *)znode;
-                                pid_item->lcnt = pid_item->cnt;
-                                pid_item->cnt = 0;
-                        }
-
-                        obj->last_sys_cnt = obj->sys_cnt;
-                        obj->sys_cnt = 0;
+                        obj->rate_cur->interval = obj->interval;
+                        rate_close(obj);
 
-                        obj->last_psi_cnt = obj->psi_cnt;
-                        obj->psi_cnt = 0;
-
-                        obj->last_nul_cnt = obj->nul_cnt;
-                        obj->nul_cnt = 0;
-
-                        obj->last_interval = obj->interval;
                         obj->interval = 0;
                         obj->CTS0 = obj->CTS;
+                        obj->is_rate_due = 0;
+                        wheel_add(obj->wheel, &(obj->tmr_rate), obj->CLK + obj->aim_interval);
 
                         obj->has_rate = 1;
+                        event(obj, TS_EVT_RATE);
 
                         obj->is_psi_si_parsed = 1;
                 }
@@ -1007,6 +1318,20 @@ static int state_next_pkt(struct ts_obj *obj)
                                 obj->DTS_minus_STC = 0;
                         }
                         elem->DTS = obj->DTS; /* record last DTS in elem */
+
+                        /* PTS_error and Data_delay_error, only for video and audio */
+                        if(pid->TB_Rx) {
+                                if(-1 == elem->PTS_CLK) {
+                                        tmr_pid_arm(obj, pid, obj->CLK + 700 * STC_MS);
+                                }
+                                elem->PTS_CLK = obj->CLK;
+                                if((prog) && (prog->is_STC_sync) &&
+                                   obj->DTS_minus_STC > STC_BASE_1S) {
+                                        err->Data_delay_error = 1;
+                                        error(obj, TS_ERR_3_10);
+                                }
+                        }
+                        event(obj, TS_EVT_PTS);
                 }
         }
 
@@ -1120,254 +1445,197 @@ static int ts_parse_af(struct ts_obj *obj)
 static int ts_ts2sect(struct ts_obj *obj)
 {
         uint8_t dat;
-        uint8_t *p;
+        uint8_t *p = obj->cur;
+        uint8_t *tail = obj->tail;
         struct ts_tsh *tsh = &(obj->tsh);
         struct ts_pid *pid = obj->pid;
-        struct ts_pkt *pkt;
-
-        /* collect packet(make pkt list) */
-        if(!(pid->pkt0)) {
-                /* waiting for section head */
-                if(tsh->payload_unit_start_indicator) {
-                        /* first packet of this section */
-                        dat = *(obj->cur)++; /* pointer_field */
-                        obj->cur += dat; /* point to section head now */
-                        pid->has_new_sech = 0;
-                        pid->payload_total = (obj->tail - obj->cur);
-                        pid->section_length = PRIVATE_SECTION_LENGTH_MAX; /* suppose maximum length */
-
-                        /* sect head 3-byte */
-                        p = obj->cur;
-                        for(pid->sech3_idx = 0; pid->sech3_idx < 3; pid->sech3_idx++) {
-                                if(p >= obj->tail) {
-                                        break;
-                                }
-                                pid->sech3[pid->sech3_idx] = *p++;
-                        }
+        int is_start = tsh->payload_unit_start_indicator;
 
-                        /* get section_length for single packet section */
-                        if(3 == pid->sech3_idx) {
-                                dat = pid->sech3[0];
-                                pid->table_id = dat;
+        if(is_start) {
+                if(p >= tail) {
+                        return -1;
+                }
+                dat = *p++; /* pointer_field */
 
-                                dat = pid->sech3[1];
-                                pid->section_length = dat & 0x0F;
+                if(pid->is_sect_sync) {
+                        uint8_t *q = p;
 
-                                dat = pid->sech3[2];
-                                pid->section_length <<= 8;
-                                pid->section_length  |= dat;
+                        /* data before new section head: the last part of section */
+                        if(dat > (tail - p)) {
+                                dat = (tail - p);
                         }
 
-                        if(pid->section_length > pid->payload_total) {
-                                /* multi-packets section, make pkt list */
-                                struct ts_pkt *new_pkt = (struct ts_pkt *)buddy_malloc(obj->mp, sizeof(struct ts_pkt));
-                                if(!new_pkt) {
-                                        RPT(RPT_ERR, "malloc for pkt node failed");
-                                        return -1;
+                        /* the head of that section may be cut by packet boundary too */
+                        while(!(pid->section) && 0 < pid->sech3_idx && pid->sech3_idx < 3 && q < p + dat) {
+                                pid->sech3[pid->sech3_idx++] = *q++;
+                                if(3 == pid->sech3_idx) {
+                                        sect_create(obj); /* if failed, the rest is dropped below */
                                 }
-                                memcpy(new_pkt->pkt, obj->ipt.TS, TS_PKT_SIZE);
-                                new_pkt->payload_unit_start_indicator = 1;
-                                new_pkt->payload_size = (obj->tail - obj->cur);
-                                zlst_push(&(pid->pkt0), new_pkt);
                         }
-                        else {
-                                /* single packet section, for efficienc: directly make section without pkt list */
-                                struct ts_sect *new_sect = (struct ts_sect *)buddy_malloc(obj->mp, sizeof(struct ts_sect));
-                                if(!new_sect) {
-                                        RPT(RPT_ERR, "malloc section node failed");
-                                        goto ts2sect_free_pkt_list;
-                                }
-
-                                new_sect->section = (uint8_t *)buddy_malloc(obj->mp, 3 + pid->section_length);
-                                if(!new_sect->section) {
-                                        RPT(RPT_ERR, "malloc data buffer of section node failed");
-                                        goto ts2sect_free_pkt_list;
+                        if(0 != sect_append(obj, q, dat - (q - p))) {
+                                return -1;
+                        }
+                        if(pid->section) {
+                                /* use start_indicator instead of section_length to determine section end */
+                                RPT(RPT_DBG, "section is cut by next section head");
+                                memset(pid->section + pid->section_got, 0,
+                                       3 + pid->section_length - pid->section_got);
+                                pid->section_got = 3 + pid->section_length;
+                                if(0 != sect_append(obj, p, 0)) {
+                                        return -1;
                                 }
-
-#if 0
-#define DEBUG_SECTION_FRAGMENT
-#endif
-                                memcpy(new_sect->section, obj->cur, 3 + pid->section_length);
-#ifdef DEBUG_SECTION_FRAGMENT
-                                fprintf(stderr, "(%02X %4d) 3+%d.\n", pid->table_id, pid->payload_total, pid->section_length);
-#endif
-                                //dump(new_sect->section, 3 + pid->section_length);
-                                ts_parse_sect(obj, new_sect); /* note: ts_parse_sect() should free new_sect */
                         }
                 }
-                else { /* !(tsh->payload_unit_start_indicator) */
-                        RPT(RPT_DBG, "section async, ignore this packet");
-                        return -1;
-                }
+                p += dat; /* point to section head now */
+                pid->is_sect_sync = 1;
+                pid->sech3_idx = 0;
+        }
+        else if(!(pid->is_sect_sync)) {
+                RPT(RPT_DBG, "section async, ignore this packet");
+                return -1;
         }
-        else { /* (pid->pkt0) */
-                /* next packet of this section */
-                struct ts_pkt *new_pkt = (struct ts_pkt *)buddy_malloc(obj->mp, sizeof(struct ts_pkt));
-                if(!new_pkt) {
-                        RPT(RPT_ERR, "malloc for packet node failed");
-                        goto ts2sect_free_pkt_list;
-                }
 
-                memcpy(new_pkt->pkt, obj->ipt.TS, TS_PKT_SIZE);
-                if(tsh->payload_unit_start_indicator) {
-                        new_pkt->payload_unit_start_indicator = 1;
-                        pid->has_new_sech = 1; /* a new section in this packet */
-                        dat = *(obj->cur)++; /* pointer_field */
+        /* the rest of payload: section head, section body, or stuffing_byte */
+        while(p < tail) {
+                if(!(pid->is_sect_sync)) {
+                        /* more section in this packet? */
+                        if(!is_start || 0xFF == *p) {
+                                break; /* stuffing_byte */
+                        }
+                        pid->is_sect_sync = 1;
+                        pid->sech3_idx = 0;
                 }
-                else {
-                        new_pkt->payload_unit_start_indicator = 0;
+
+                if(pid->section) {
+                        int len = 3 + pid->section_length - pid->section_got;
+
+                        if(len > (tail - p)) {
+                                len = (tail - p);
+                        }
+                        if(0 != sect_append(obj, p, len)) {
+                                return -1;
+                        }
+                        p += len;
+                        continue;
                 }
-                new_pkt->payload_size = (obj->tail - obj->cur);
-                pid->payload_total += new_pkt->payload_size;
-                zlst_push(&(pid->pkt0), new_pkt);
 
                 /* sect head 3-byte */
-                p = obj->cur;
-                for(; pid->sech3_idx < 3; pid->sech3_idx++) {
-                        if(p >= obj->tail) {
-                                break;
+                pid->sech3[pid->sech3_idx++] = *p++;
+                if(3 == pid->sech3_idx) {
+                        if(0 != sect_create(obj)) {
+                                return -1;
                         }
-                        pid->sech3[pid->sech3_idx] = *p++;
-               }
+                }
         }
+        return 0;
+}
 
-        /* try to make section */
-        while(pid->pkt0) {
-                /* get section_length */
-                if(3 == pid->sech3_idx) {
-                        uint8_t section_syntax_indicator; /* 1-bit */
-
-                        dat = pid->sech3[0];
-                        pid->table_id = dat;
+/* sech3 is OK, make buffer for the whole section */
+static int sect_create(struct ts_obj *obj)
+{
+        uint8_t dat;
+        uint8_t section_syntax_indicator; /* 1-bit */
+        struct ts_pid *pid = obj->pid;
 
-                        dat = pid->sech3[1];
-                        section_syntax_indicator = (dat & BIT(7)) >> 7;
-                        pid->section_length = dat & 0x0F;
+        dat = pid->sech3[0];
+        pid->table_id = dat;
 
-                        dat = pid->sech3[2];
-                        pid->section_length <<= 8;
-                        pid->section_length  |= dat;
+        dat = pid->sech3[1];
+        section_syntax_indicator = (dat & BIT(7)) >> 7;
+        pid->section_length = dat & 0x0F;
 
-                        pid->sech3_idx = 4; /* got section_length */
+        dat = pid->sech3[2];
+        pid->section_length <<= 8;
+        pid->section_length  |= dat;
 
-                        if(section_syntax_indicator) {
-                                if(pid->section_length > NORMAL_SECTION_LENGTH_MAX) {
-                                        RPT(RPT_ERR, "normal section_length(%d) > %d",
-                                            pid->section_length, NORMAL_SECTION_LENGTH_MAX);
-                                        goto ts2sect_free_pkt_list;
-                                }
-                        }
-                        else { /* !(section_syntax_indicator) */
-                                if(pid->section_length > PRIVATE_SECTION_LENGTH_MAX) {
-                                        RPT(RPT_ERR, "private section_length(%d) > %d",
-                                            pid->section_length, PRIVATE_SECTION_LENGTH_MAX);
-                                        goto ts2sect_free_pkt_list;
-                                }
-                        }
-                        RPT(RPT_INF, "table_id: 0x%02X, length: 3 + %d", pid->table_id, pid->section_length);
+        if(section_syntax_indicator) {
+                if(pid->section_length > NORMAL_SECTION_LENGTH_MAX) {
+                        RPT(RPT_ERR, "normal section_length(%d) > %d",
+                            pid->section_length, NORMAL_SECTION_LENGTH_MAX);
+                        pid->is_sect_sync = 0;
+                        return -1;
                 }
+        }
+        else { /* !(section_syntax_indicator) */
+                if(pid->section_length > PRIVATE_SECTION_LENGTH_MAX) {
+                        RPT(RPT_ERR, "private section_length(%d) > %d",
+                            pid->section_length, PRIVATE_SECTION_LENGTH_MAX);
+                        pid->is_sect_sync = 0;
+                        return -1;
+                }
+        }
+        RPT(RPT_INF, "table_id: 0x%02X, length: 3 + %d", pid->table_id, pid->section_length);
 
-                if(pid->payload_total >= (3 + pid->section_length) || pid->has_new_sech) {
-                        /* has one section */
-                        struct ts_sect *new_sect = (struct ts_sect *)buddy_malloc(obj->mp, sizeof(struct ts_sect));
-                        if(!new_sect) {
-                                RPT(RPT_ERR, "malloc section node failed");
-                                goto ts2sect_free_pkt_list;
-                        }
-
-                        new_sect->section = (uint8_t *)buddy_malloc(obj->mp, 3 + pid->section_length);
-                        if(!new_sect->section) {
-                                RPT(RPT_ERR, "malloc data buffer of section node failed");
-                                goto ts2sect_free_pkt_list;
-                        }
+        /* payload will be appended to this buffer directly, then it becomes new_sect->section */
+        pid->section = (uint8_t *)buddy_malloc(obj->mp, 3 + pid->section_length);
+        if(!(pid->section)) {
+                RPT(RPT_ERR, "malloc data buffer of section node failed");
+                pid->is_sect_sync = 0;
+                return -1;
+        }
+        memcpy(pid->section, pid->sech3, 3);
+        pid->section_got = 3;
+        return 0;
+}
 
-                        p = new_sect->section;
-                        int left_length = 3 + pid->section_length;
+/* append len-byte to section of pid, parse it if section is complete */
+static int sect_append(struct ts_obj *obj, uint8_t *p, int len)
+{
+        struct ts_pid *pid = obj->pid;
+        struct ts_sect *new_sect;
 
-#ifdef DEBUG_SECTION_FRAGMENT
-                        fprintf(stderr, "(%02X %4d) 3+%d ", pid->table_id, pid->payload_total, pid->section_length);
-#endif
-                        RPT(RPT_INF, "pkt list -> ts_sect and parse, table: 0x%02X", pid->table_id);
-                        while(NULL != (pkt = (struct ts_pkt *)zlst_shift(&(pid->pkt0)))) {
-                                if(pkt->payload_unit_start_indicator && p != new_sect->section) {
-                                        /* use start_indicator instead of section_length to determine section end */
-                                        left_length = (int)(pkt->pkt[4]); /* pointer_field is just left length */
-                                }
+        if(!(pid->section)) {
+                pid->is_sect_sync = 0; /* section head is not complete, give up */
+                return 0;
+        }
 
-                                if(pkt->payload_size < left_length) {
-                                        /* part of big section */
-                                        memcpy(p, pkt->pkt + TS_PKT_SIZE - pkt->payload_size, pkt->payload_size);
-                                        p += pkt->payload_size;
-                                        left_length -= pkt->payload_size;
-                                        buddy_free(obj->mp, pkt);
-#ifdef DEBUG_SECTION_FRAGMENT
-                                        fprintf(stderr, "- %3d = %4d ", pkt->payload_size, left_length);
-#endif
-                                }
-                                else { /* (pkt->payload_size >= left_length) */
-                                        /* last packet of the section */
-                                        memcpy(p, pkt->pkt + TS_PKT_SIZE - pkt->payload_size, left_length);
-                                        pkt->payload_size -= left_length; /* maybe head of next section */
-#ifdef DEBUG_SECTION_FRAGMENT
-                                        fprintf(stderr, "- %3d ", left_length);
-#endif
-                                        //dump(new_sect->section, 3 + pid->section_length);
-                                        ts_parse_sect(obj, new_sect); /* note: ts_parse_sect() should free new_sect */
-
-                                        if(pkt->payload_unit_start_indicator && p != new_sect->section) {
-                                                /* new section */
-                                                obj->tail = pkt->pkt + TS_PKT_SIZE;
-                                                obj->cur = obj->tail - pkt->payload_size;
-#ifdef DEBUG_SECTION_FRAGMENT
-                                                fprintf(stderr, "(%d-byte new section head)\n", pkt->payload_size);
-                                                dump(obj->cur, pkt->payload_size);
-#endif
-                                                pid->payload_total = pkt->payload_size;
-                                                pid->has_new_sech = 0;
-                                                zlst_push(&(pid->pkt0), pkt);
-                                                pid->section_length = PRIVATE_SECTION_LENGTH_MAX; /* suppose maximum length */
-
-                                                /* sect head 3-byte */
-                                                p = obj->cur;
-                                                for(pid->sech3_idx = 0; pid->sech3_idx < 3; pid->sech3_idx++) {
-                                                        if(p >= obj->tail) {
-                                                                break;
-                                                        }
-                                                        pid->sech3[pid->sech3_idx] = *p++;
-                                                }
-                                        }
-                                        else {
-#ifdef DEBUG_SECTION_FRAGMENT
-                                                fprintf(stderr, "(%d-byte padding data)\n", pkt->payload_size);
-#endif
-                                                buddy_free(obj->mp, pkt);
-                                        }
-                                        break;
-                                }
-                        } /* while(pkt) */
-                }
-                else { /* not enough data to make section */
-                        break;
-                }
-        } /* while(pid->pkt0) */
-        return 0;
+        if(len > 3 + pid->section_length - pid->section_got) {
+                /* e.g. bad pointer_field, more data than section_length */
+                RPT(RPT_ERR, "section of table 0x%02X overflow: %d + %d > 3 + %d, give up",
+                    pid->table_id, pid->section_got, len, pid->section_length);
+                buddy_free(obj->mp, pid->section);
+                pid->section = NULL;
+                pid->is_sect_sync = 0;
+                return 0;
+        }
+        memcpy(pid->section + pid->section_got, p, len);
+        pid->section_got += len;
+        if(pid->section_got < 3 + pid->section_length) {
+                return 0; /* need more packet */
+        }
 
-ts2sect_free_pkt_list:
-        while(NULL != (pkt = (struct ts_pkt *)zlst_pop(&(pid->pkt0)))) {
-                buddy_free(obj->mp, pkt);
+        /* has one section */
+        pid->is_sect_sync = 0; /* section after this one should be in the same packet */
+        new_sect = (struct ts_sect *)slab_malloc(obj->slab_sect);
+        if(!new_sect) {
+                RPT(RPT_ERR, "malloc section node failed");
+                buddy_free(obj->mp, pid->section);
+                pid->section = NULL;
+                return -1;
         }
-        return -1;
+        new_sect->is_slab = 1;
+        new_sect->section = pid->section;
+        new_sect->is_parsed = 0;
+        new_sect->repeat = 0;
+        new_sect->STC = STC_OVF;
+        pid->section = NULL;
+
+        RPT(RPT_INF, "section of table 0x%02X, parse", pid->table_id);
+        ts_parse_sect(obj, new_sect); /* note: ts_parse_sect() should free new_sect */
+        return 0;
 }
 
 static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
 {
         uint8_t *p;
         struct ts_tabl *tabl;
+        struct ts_sect *sect;
         struct ts_pid *pid = obj->pid;
+        struct ts_tsh *tsh = &(obj->tsh);
         struct ts_err *err = &(obj->err);
-#if 0
         int is_new_version = 0;
-#endif
+        int is_same = 0; /* new_sect is repetition of sect */
+        int64_t interval = -1; /* of the same section, -1 means unknown */
 
         /* get section head info */
         p = new_sect->section;
@@ -1411,6 +1679,30 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
             new_sect->section_number,
             new_sect->last_section_number);
 
+        /* repetition of cached section: count it, skip CRC calculation(sampled) and body parse */
+        sect = sect_cached(obj, new_sect);
+        if(sect) {
+                sect->repeat++;
+                if(sect->check_CRC) {
+                        p = sect->section + 3 + sect->section_length - 4;
+                        obj->CRC_32 = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+                        obj->CRC_32_calc = obj->CRC_32;
+                        if(0 <= obj->cfg.crc_sample &&
+                           (obj->cfg.crc_sample <= 1 || 0 == sect->repeat % obj->cfg.crc_sample)) {
+                                obj->CRC_32_calc = ts_crc(new_sect->section, 3 + new_sect->section_length - 4, 32);
+                                if(obj->CRC_32_calc != obj->CRC_32) {
+                                        err->CRC_error = 1;
+                                        error(obj, TS_ERR_2_2);
+                                        goto release_sect;
+                                }
+                        }
+                }
+                free_sect(obj, new_sect);
+                tabl = sect_tabl(obj, sect);
+                is_same = 1;
+                goto has_sect;
+        }
+
         /* CRC check */
         if(new_sect->check_CRC) {
                 p = new_sect->section + 3 + new_sect->section_length - 4;
@@ -1425,10 +1717,11 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
                 obj->CRC_32_calc = ts_crc(new_sect->section, 3 + new_sect->section_length - 4, 32);
                 if(obj->CRC_32_calc != obj->CRC_32) {
                         err->CRC_error = 1;
+                        error(obj, TS_ERR_2_2);
 #if 0
                         RPT(RPT_ERR, "CRC error(0x%08X! 0x%08X?)",
                             obj->CRC_32_calc, obj->CRC_32);
-                        dump(obj->ipt.TS, TS_PKT_SIZE);
+                        dump(obj->TS, TS_PKT_SIZE);
                         dump(new_sect->section, 3 + new_sect->section_length);
 #endif
                         goto release_sect;
@@ -1436,38 +1729,41 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
         }
 
         /* get "tabl" */
-        if(0x02 == new_sect->table_id) {
-                /* is PMT section */
-                if(!(pid->prog)) {
+        tabl = sect_tabl(obj, new_sect);
+        if(!tabl) {
+                if(0x02 == new_sect->table_id) {
                         RPT(RPT_WRN, "PMT without corresponding program, ignore");
                         goto release_sect;
                 }
-                tabl = &(pid->prog->tabl);
-        }
-        else {
+
                 /* not PMT section */
-                RPT(RPT_DBG, "search 0x%02X in table_list", new_sect->table_id);
-                tabl = (struct ts_tabl *)zlst_search(&(obj->tabl0), new_sect->table_id);
+                tabl = (struct ts_tabl *)buddy_malloc(obj->mp, sizeof(struct ts_tabl));
                 if(!tabl) {
-                        tabl = (struct ts_tabl *)buddy_malloc(obj->mp, sizeof(struct ts_tabl));
-                        if(!tabl) {
-                                RPT(RPT_ERR, "malloc ts_tabl node failed");
-                                goto release_sect;
-                        }
+                        RPT(RPT_ERR, "malloc ts_tabl node failed");
+                        goto release_sect;
+                }
 
-                        tabl->sect0 = NULL;
-                        tabl->table_id = new_sect->table_id;
-                        tabl->version_number = new_sect->version_number;
-                        tabl->last_section_number = new_sect->last_section_number;
-                        tabl->STC = STC_OVF;
+                tabl->sect0 = NULL;
+                tabl->table_id = new_sect->table_id;
+                tabl->version_number = new_sect->version_number;
+                tabl->last_section_number = new_sect->last_section_number;
+                tabl->STC = STC_OVF;
+                tabl->CLK = obj->CLK;
+                wheel_node_init(&(tabl->tmr), TMR_TABL, tabl);
+                if(tabl_rep_max(tabl)) {
+                        wheel_add(obj->wheel, &(tabl->tmr), tabl->CLK + tabl_rep_max(tabl));
+                }
 
-                        RPT(RPT_DBG, "insert 0x%02X in table_list", tabl->table_id);
-                        zlst_set_key(tabl, tabl->table_id);
-                        if(0 != zlst_insert(&(obj->tabl0), tabl)) {
-                                free_tabl(obj->mp, tabl);
-                                goto release_sect;
-                        }
+                RPT(RPT_DBG, "insert 0x%02X in table_list", tabl->table_id);
+                zlst_set_key(tabl, tabl->table_id);
+                if(0 != zlst_insert(&(obj->tabl0), tabl)) {
+                        free_tabl(obj, tabl);
+                        goto release_sect;
                 }
+                if(0x01 == tabl->table_id) {
+                        obj->is_cat_seen = 1;
+                }
+                is_new_version = 1; /* new table */
         }
 
         /* get "psect0" */
@@ -1484,15 +1780,11 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
                 tabl->version_number = new_sect->version_number;
                 tabl->last_section_number = new_sect->last_section_number;
                 while(NULL != (sect_node = (struct ts_sect *)zlst_pop(psect0))) {
-                        free_sect(obj->mp, sect_node);
+                        free_sect(obj, sect_node);
                 };
-#if 0
                 is_new_version = 1;
-#endif
         }
 
-        struct ts_sect *sect;
-
         /* get "section" pointer */
         RPT(RPT_DBG, "search %d/%d in sect_list", new_sect->section_number, new_sect->last_section_number);
         sect = (struct ts_sect *)zlst_search(psect0, new_sect->section_number);
@@ -1509,11 +1801,22 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
                     sect->section_number,
                     sect->last_section_number,
                     sect->table_id);
-                free_sect(obj->mp, new_sect);
-                //return -1; FIXME: got SDT before PMT will lost service info, so parse again and again now
+                is_same = (sect->table_id_extension == new_sect->table_id_extension);
+                free_sect(obj, new_sect);
         }
+
+has_sect:
+        /* note: new_sect is in sect_list or freed now, do NOT goto release_sect */
         obj->sect = sect; /* has section */
 
+        /* interval of the same section */
+        if(is_same &&
+           STC_OVF != sect->STC &&
+           STC_OVF != obj->STC) {
+                interval = ts_timestamp_diff(obj->STC, sect->STC, STC_OVF);
+        }
+        sect->STC = obj->STC;
+
         /* sect_interval */
         if(STC_OVF != tabl->STC &&
            STC_OVF != obj->STC) {
@@ -1523,75 +1826,132 @@ static int ts_parse_sect(struct ts_obj *obj, struct ts_sect *new_sect)
                 obj->sect_interval = 0;
         }
         tabl->STC = obj->STC;
+        tabl->CLK = obj->CLK; /* timer of tabl is not moved, check it when expire */
+
+        event(obj, TS_EVT_SECT);
+        if(is_new_version) {
+                event(obj, TS_EVT_TABL);
+        }
 
         /* PAT_error(table_id error) */
         if(0x0000 == pid->PID && 0x00 != sect->table_id) {
                 err->PAT_error = ERR_1_3_1;
-                dump(obj->ipt.TS, TS_PKT_SIZE);
+                error(obj, TS_ERR_1_3);
+                dump(obj->TS, TS_PKT_SIZE);
                 dump(sect->section, 8);
-                goto release_sect;
+                return -1;
         }
 
-        /* parse */
+        /* PAT_error and PMT_error, check repetition too, interval > 0.5s is checked by timer */
+        if(0x00 == sect->table_id && 0x0000 == pid->PID) {
+                if(0x00 != tsh->transport_scrambling_control) {
+                        err->PAT_error = ERR_1_3_2;
+                        error(obj, TS_ERR_1_3);
+                }
+        }
+        if(0x02 == sect->table_id && IS_TYPE(TS_TYPE_PMT, pid->type)) {
+                if(0x00 != tsh->transport_scrambling_control) {
+                        err->PMT_error = ERR_1_5_1;
+                        error(obj, TS_ERR_1_5);
+                }
+        }
+        check_sect(obj, sect, interval);
+
+        /* parse body, again and again until all info is got, e.g. SDT before PAT */
+        if(sect->is_parsed) {
+                return 0;
+        }
         switch(sect->table_id) {
                 case 0x00:
                         if(0x0000 != pid->PID) {
                                 RPT(RPT_ERR, "PAT: PID is not 0x0000 but 0x%04X, ignore!", pid->PID);
-                                goto release_sect;
+                                return -1;
                         }
-                        ts_parse_secb_pat(obj);
+                        sect->is_parsed = (0 == ts_parse_secb_pat(obj));
                         break;
                 case 0x01:
                         if(0x0001 != pid->PID) {
                                 RPT(RPT_ERR, "CAT: PID is not 0x0001 but 0x%04X, ignore!", pid->PID);
-                                goto release_sect;
+                                return -1;
                         }
-                        ts_parse_secb_cat(obj);
+                        sect->is_parsed = (0 == ts_parse_secb_cat(obj));
                         break;
                 case 0x02:
                         if(!IS_TYPE(TS_TYPE_PMT, pid->type)) {
                                 RPT(RPT_ERR, "PMT: PID is NOT PMT_PID but 0x%04X, ignore!", pid->PID);
-                                goto release_sect;
+                                return -1;
                         }
-                        ts_parse_secb_pmt(obj);
+                        sect->is_parsed = (0 == ts_parse_secb_pmt(obj));
                         break;
                 case 0x42:
                         if(0x0011 != pid->PID) {
                                 RPT(RPT_ERR, "SDT: PID is not 0x0011 but 0x%04X, ignore!", pid->PID);
-                                goto release_sect;
+                                return -1;
                         }
-                        ts_parse_secb_sdt(obj);
+                        sect->is_parsed = (0 == ts_parse_secb_sdt(obj));
                         break;
                 default:
                         RPT(RPT_DBG, "meet table(0x%02X), ignore", sect->table_id);
+                        sect->is_parsed = 1;
                         break;
         }
         return 0;
 
 release_sect:
-        free_sect(obj->mp, new_sect);
+        free_sect(obj, new_sect);
         return -1;
 }
 
+/* table of the section, NULL if not in table_list now */
+static struct ts_tabl *sect_tabl(struct ts_obj *obj, struct ts_sect *sect)
+{
+        struct ts_pid *pid = obj->pid;
+
+        if(0x02 == sect->table_id) {
+                /* is PMT section */
+                return (pid->prog) ? &(pid->prog->tabl) : NULL;
+        }
+
+        /* not PMT section */
+        RPT(RPT_DBG, "search 0x%02X in table_list", sect->table_id);
+        return (struct ts_tabl *)zlst_search(&(obj->tabl0), sect->table_id);
+}
+
+/* the node in sect_list with the same head and CRC_32 as new_sect, or NULL */
+static struct ts_sect *sect_cached(struct ts_obj *obj, struct ts_sect *new_sect)
+{
+        struct ts_tabl *tabl;
+        struct ts_sect *sect;
+        int len = 3 + new_sect->section_length;
+
+        tabl = sect_tabl(obj, new_sect);
+        if((!tabl) || tabl->version_number != new_sect->version_number) {
+                return NULL;
+        }
+        sect = (struct ts_sect *)zlst_search(&(tabl->sect0), new_sect->section_number);
+        if((!sect) ||
+           sect->table_id != new_sect->table_id ||
+           sect->table_id_extension != new_sect->table_id_extension ||
+           sect->section_length != new_sect->section_length) {
+                return NULL;
+        }
+
+        /* compare CRC_32 only, or the whole section if it has no CRC_32 */
+        if(sect->check_CRC) {
+                return (0 == memcmp(sect->section + len - 4, new_sect->section + len - 4, 4)) ? sect : NULL;
+        }
+        return (0 == memcmp(sect->section, new_sect->section, len)) ? sect : NULL;
+}
+
 static int ts_parse_secb_pat(struct ts_obj *obj)
 {
         struct ts_sect *sect = obj->sect;
-        struct ts_tsh *tsh = &(obj->tsh);
-        struct ts_err *err = &(obj->err);
         uint8_t dat;
         uint8_t *cur = sect->section + 8;
         uint8_t *crc = sect->section + 3 + sect->section_length - 4;
         struct ts_prog *prog;
         struct ts_pid ts_new_pid, *new_pid = &ts_new_pid;
 
-        /* PAT_error */
-        if(obj->sect_interval > 500 * STC_MS) {
-                err->PAT_error = ERR_1_3_0;
-        }
-        if(0x00 != tsh->transport_scrambling_control) {
-                err->PAT_error = ERR_1_3_2;
-        }
-
         /* to avoid stack overflow, FIXME */
         if(obj->prog0) {
                 return 0;
@@ -1610,6 +1970,7 @@ static int ts_parse_secb_pat(struct ts_obj *obj)
                 }
                 prog->elem0 = NULL;
                 prog->tabl.sect0 = NULL;
+                wheel_node_init(&(prog->tabl.tmr), TMR_TABL, &(prog->tabl));
                 prog->program_info_len = 0;
                 prog->program_info = NULL;
                 prog->service_name_len = 0;
@@ -1641,7 +2002,7 @@ static int ts_parse_secb_pat(struct ts_obj *obj)
                                 RPT(RPT_ERR, "NIT_PID(0x%04X) is NOT 0x0010!", new_pid->PID);
 #endif
                         }
-                        free_prog(obj->mp, prog);
+                        free_prog(obj, prog);
                 }
                 else {
                         struct znode *znode;
@@ -1678,6 +2039,8 @@ static int ts_parse_secb_pat(struct ts_obj *obj)
                         prog->tabl.last_section_number = 0; /* no use */
                         prog->tabl.sect0 = NULL;
                         prog->tabl.STC = STC_OVF;
+                        prog->tabl.CLK = obj->CLK;
+                        wheel_add(obj->wheel, &(prog->tabl.tmr), prog->tabl.CLK + 500 * STC_MS);
 
                         /* for STC calc */
                         prog->ADDa = 0;
@@ -1685,17 +2048,16 @@ static int ts_parse_secb_pat(struct ts_obj *obj)
                         prog->ADDb = 0;
                         prog->PCRb = STC_OVF;
                         prog->is_STC_sync = 0;
+                        prog_oj_init(prog);
 
                         RPT(RPT_DBG, "insert 0x%04X in prog_list", prog->program_number);
                         zlst_set_key(prog, prog->program_number);
                         if(0 != zlst_insert(&(obj->prog0), prog)) {
-                                free_prog(obj->mp, prog);
+                                free_prog(obj, prog);
                                 return -1;
                         }
                 }
 
-                new_pid->cnt = 0;
-                new_pid->lcnt = 0;
                 new_pid->prog = prog;
                 new_pid->elem = NULL;
                 new_pid->CC = 0;
@@ -1745,8 +2107,6 @@ static int ts_parse_secb_cat(struct ts_obj *obj)
                         CA_PID |= dat;
 
                         new_pid->PID = CA_PID;
-                        new_pid->cnt = 0;
-                        new_pid->lcnt = 0;
                         new_pid->prog = NULL;
                         new_pid->elem = NULL;
                         new_pid->type = TS_TYPE_EMM;
@@ -1765,21 +2125,12 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
 {
         struct ts_sect *sect = obj->sect;
         struct ts_tsh *tsh = &(obj->tsh);
-        struct ts_err *err = &(obj->err);
         uint8_t dat;
         uint8_t *cur = sect->section + 8;
         uint8_t *crc = sect->section + 3 + sect->section_length - 4;
         struct ts_prog *prog;
         struct ts_pid ts_new_pid, *new_pid = &ts_new_pid;
 
-        /* PMT_error */
-        if(obj->sect_interval > 500 * STC_MS) {
-                err->PMT_error = ERR_1_5_0;
-        }
-        if(0x00 != tsh->transport_scrambling_control) {
-                err->PMT_error = ERR_1_5_1;
-        }
-
         /* in PMT, table_id_extension is program_number */
         RPT(RPT_DBG, "search 0x%04X in prog_list", sect->table_id_extension);
         prog = (struct ts_prog *)zlst_search(&(obj->prog0), sect->table_id_extension);
@@ -1799,8 +2150,6 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
 
         /* add PCR PID */
         new_pid->PID = prog->PCR_PID;
-        new_pid->cnt = 0;
-        new_pid->lcnt = 0;
         new_pid->prog = prog;
         new_pid->elem = NULL;
         new_pid->type = ((0x1FFF != new_pid->PID) ? TS_TYPE_PCR : TS_TYPE_NULP);
@@ -1913,8 +2262,6 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
                                 CA_PID |= dat;
 
                                 new_pid->PID = CA_PID;
-                                new_pid->cnt = 0;
-                                new_pid->lcnt = 0;
                                 new_pid->prog = prog;
                                 new_pid->elem = elem;
                                 new_pid->type = TS_TYPE_ECM;
@@ -1932,6 +2279,7 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
                 }
                 elem->PTS = STC_BASE_OVF;
                 elem->DTS = STC_BASE_OVF;
+                elem->PTS_CLK = -1;
 
                 elem->is_pes_align = 0;
 
@@ -1940,8 +2288,6 @@ static int ts_parse_secb_pmt(struct ts_obj *obj)
 
                 /* add elementary PID */
                 new_pid->PID = elem->PID;
-                new_pid->cnt = 0;
-                new_pid->lcnt = 0;
                 new_pid->prog = prog;
                 new_pid->elem = elem;
                 new_pid->type = elem->type;
@@ -1959,6 +2305,7 @@ static int ts_parse_secb_sdt(struct ts_obj *obj)
         uint8_t dat;
         uint8_t *cur = sect->section + 8;
         uint8_t *crc = sect->section + 3 + sect->section_length - 4;
+        int rslt = 0;
         uint16_t original_network_id;
 
         /* in SDT, table_id_extension is transport_stream_id */
@@ -2011,6 +2358,9 @@ static int ts_parse_secb_sdt(struct ts_obj *obj)
                 service_id |= dat;
                 RPT(RPT_DBG, "search service_id(0x%04X) in prog_list", service_id);
                 prog = (struct ts_prog *)zlst_search(&(obj->prog0), service_id);
+                if(!prog) {
+                        rslt = 1; /* SDT before PAT, parse it again later */
+                }
 
                 dat = *cur++;
 #if 0
@@ -2080,7 +2430,7 @@ static int ts_parse_secb_sdt(struct ts_obj *obj)
                 }
         }
 
-        return 0;
+        return rslt;
 }
 
 static int ts_parse_pesh(struct ts_obj *obj)
@@ -2139,7 +2489,7 @@ static int ts_parse_pesh(struct ts_obj *obj)
                 if(0x000001 != pesh->packet_start_code_prefix) {
                         RPT(RPT_ERR, "PES packet start code prefix(0x%06X) NOT 0x000001!",
                             pesh->packet_start_code_prefix);
-                        dump(obj->ipt.TS, TS_PKT_SIZE);
+                        dump(obj->TS, TS_PKT_SIZE);
 #if 0
                         return -1;
 #endif
@@ -2327,7 +2677,7 @@ static int ts_parse_pesh_detail(struct ts_obj *obj)
         }
         else if(0x01 == pesh->PTS_DTS_flags) { /* '01' */
                 RPT(RPT_ERR, "PTS_DTS_flags error!");
-                dump(obj->ipt.TS, TS_PKT_SIZE);
+                dump(obj->TS, TS_PKT_SIZE);
                 return -1;
         }
         else {
@@ -2482,25 +2832,29 @@ static struct ts_pid *update_pid_list(struct ts_obj *obj, struct ts_pid *new_pid
 {
         struct ts_pid *pid;
 
-        pid = (struct ts_pid *)zlst_search(&(obj->pid0), new_pid->PID);
+        pid = obj->pid_table[new_pid->PID & 0x1FFF];
         if(pid) {
                 /* is in pid_list already, just update information */
                 pid->PID = new_pid->PID;
                 pid->prog = new_pid->prog;
                 pid->elem = new_pid->elem;
                 pid->type = new_pid->type;
-                pid->cnt = new_pid->cnt;
-                pid->lcnt = new_pid->lcnt;
                 pid->CC = new_pid->CC;
                 pid->is_CC_sync = new_pid->is_CC_sync;
+                pid_tb_init(pid); /* elem or type may change */
+                wheel_add(obj->wheel, &(pid->tmr), obj->CLK); /* check it again */
+                rate_pid_clear(obj, pid->PID);
         }
         else {
-                pid = (struct ts_pid *)buddy_malloc(obj->mp, sizeof(struct ts_pid));
+                pid = (struct ts_pid *)slab_malloc(obj->slab_pid);
                 if(!pid) {
                         RPT(RPT_ERR, "malloc pid node failed");
                         return NULL;
                 }
-                pid->pkt0 = NULL; /* wait to sync with section head */
+                pid->is_slab = 1;
+                pid->section = NULL; /* wait to sync with section head */
+                pid->is_sect_sync = 0;
+                pid->sech3_idx = 0;
 
                 pid->PID = new_pid->PID;
                 pid->type = new_pid->type;
@@ -2508,15 +2862,20 @@ static struct ts_pid *update_pid_list(struct ts_obj *obj, struct ts_pid *new_pid
                 pid->elem = new_pid->elem;
                 pid->is_CC_sync = new_pid->is_CC_sync;
                 pid->CC = new_pid->CC;
-                pid->cnt = new_pid->cnt;
-                pid->lcnt = new_pid->lcnt;
+                pid->CLK = obj->CLK; /* for PID_error, as if it is seen now */
+                pid->CLK0 = -1;
+                pid_tb_init(pid);
+                wheel_node_init(&(pid->tmr), TMR_PID, pid);
+                wheel_add(obj->wheel, &(pid->tmr), obj->CLK);
+                rate_pid_clear(obj, pid->PID);
 
                 RPT(RPT_DBG, "insert 0x%04X in pid_list", pid->PID);
                 zlst_set_key(pid, pid->PID);
                 if(0 != zlst_insert(&(obj->pid0), pid)) {
-                        free_pid(obj->mp, pid);
+                        free_pid(obj, pid);
                         return NULL;
                 }
+                obj->pid_table[pid->PID & 0x1FFF] = pid;
         }
         return pid;
 }
@@ -2589,6 +2948,497 @@ static const struct stream_type_table *elem_type(uint8_t stream_type)
         return p;
 }
 
+static void prog_oj_init(struct ts_prog *prog)
+{
+        prog->OJ_CTS0 = STC_OVF;
+        prog->OJ_ofs0 = 0;
+        prog->OJ_n = 0.0;
+        prog->OJ_x = 0.0;
+        prog->OJ_y = 0.0;
+        prog->OJ_xx = 0.0;
+        prog->OJ_xy = 0.0;
+        return;
+}
+
+/* offset(y) = PCR - CTS, time(x) = CTS, both measured from this PCR packet,
+ * fit "y = a + b * x" with PCR packets of this program, older ones weigh less:
+ *      PCR_OJ = 0 - a
+ *      PCR_FO = b
+ * so clock drift between sender and receiver does not look like jitter;
+ * sums are moved to the new origin each time, so x never wraps or grows */
+static void calc_pcr_oj(struct ts_obj *obj, struct ts_prog *prog)
+{
+        double dx, dy, f, d, a, b;
+        int64_t ofs;
+
+        obj->has_oj = 0;
+        if(!(obj->ipt.has_cts)) {
+                return;
+        }
+
+        ofs = ts_timestamp_diff(obj->PCR, obj->CTS, STC_OVF);
+        dx = 0.0;
+        if(STC_OVF != prog->OJ_CTS0) {
+                dx = (double)ts_timestamp_diff(obj->CTS, prog->OJ_CTS0, STC_OVF);
+        }
+        if(STC_OVF == prog->OJ_CTS0 || obj->af.discontinuity_indicator || dx < 0.0) {
+                /* restart after PCR discontinuity, or arrive time going back */
+                prog_oj_init(prog);
+                dx = 0.0;
+                prog->OJ_ofs0 = ofs;
+        }
+        dy = (double)(ofs - prog->OJ_ofs0);
+        prog->OJ_CTS0 = obj->CTS;
+        prog->OJ_ofs0 = ofs;
+
+        /* move origin to this packet: x -= dx, y -= dy; then forget by time */
+        prog->OJ_xx += dx * dx * prog->OJ_n - 2.0 * dx * prog->OJ_x;
+        prog->OJ_xy += dx * dy * prog->OJ_n - dx * prog->OJ_y - dy * prog->OJ_x;
+        prog->OJ_x -= dx * prog->OJ_n;
+        prog->OJ_y -= dy * prog->OJ_n;
+        f = exp(-dx / OJ_TAU);
+        prog->OJ_n = prog->OJ_n * f + 1.0; /* this packet: x = 0, y = 0 */
+        prog->OJ_x *= f;
+        prog->OJ_y *= f;
+        prog->OJ_xx *= f;
+        prog->OJ_xy *= f;
+
+        d = prog->OJ_n * prog->OJ_xx - prog->OJ_x * prog->OJ_x;
+        if(d > 0.0) {
+                b = (prog->OJ_n * prog->OJ_xy - prog->OJ_x * prog->OJ_y) / d;
+        }
+        else {
+                b = 0.0; /* only one PCR packet */
+        }
+        a = (prog->OJ_y - b * prog->OJ_x) / prog->OJ_n;
+
+        obj->PCR_OJ = (int64_t)(0.0 - a);
+        obj->PCR_FO = b * 1e6;
+        obj->has_oj = 1;
+        return;
+}
+
+/* call the callback of evt, if registered */
+static void event(struct ts_obj *obj, int evt)
+{
+        if(obj->evt_cb[evt]) {
+                obj->evt_cb[evt](obj, evt, obj->evt_arg[evt]);
+        }
+        return;
+}
+
+/* error(TS_ERR_xxx) raised, count it once in each packet, but not in TS_sync_loss */
+static void error(struct ts_obj *obj, int idx)
+{
+        struct ts_err *err = &(obj->err);
+
+        if(!(err->mask & BIT(idx))) {
+                err->mask |= BIT(idx);
+                if(!(err->TS_sync_loss)) {
+                        err->cnt[idx]++;
+                }
+        }
+        event(obj, TS_EVT_ERR);
+        return;
+}
+
+/* set field of SI error, and SI_repetition_error if is_rep */
+static void error_si(struct ts_obj *obj, int idx, int is_rep)
+{
+        struct ts_err *err = &(obj->err);
+
+        switch(idx) {
+                case TS_ERR_3_1A:
+                        err->NIT_error = 1;
+                        err->NIT_actual_error = 1;
+                        break;
+                case TS_ERR_3_1B:
+                        err->NIT_error = 1;
+                        err->NIT_other_error = 1;
+                        break;
+                case TS_ERR_3_5A:
+                        err->SDT_error = 1;
+                        err->SDT_actual_error = 1;
+                        break;
+                case TS_ERR_3_5B:
+                        err->SDT_error = 1;
+                        err->SDT_other_error = 1;
+                        break;
+                case TS_ERR_3_6A:
+                        err->EIT_error = 1;
+                        err->EIT_actual_error = 1;
+                        break;
+                case TS_ERR_3_6B:
+                        err->EIT_error = 1;
+                        err->EIT_other_error = 1;
+                        break;
+                case TS_ERR_3_7:
+                        err->RST_error = 1;
+                        break;
+                case TS_ERR_3_8:
+                        err->TDT_error = 1;
+                        break;
+                default:
+                        break; /* TS_ERR_3_2 only */
+        }
+        if(TS_ERR_3_2 != idx) {
+                error(obj, idx);
+        }
+        if(is_rep) {
+                err->SI_repetition_error = 1;
+                error(obj, TS_ERR_3_2);
+        }
+        return;
+}
+
+static const struct si_rep_table *si_rep(uint8_t table_id)
+{
+        const struct si_rep_table *p;
+
+        for(p = SI_REP_TABLE; p->min != 0xFF; p++) {
+                if(p->min <= table_id && table_id <= p->max) {
+                        break;
+                }
+        }
+        return p;
+}
+
+/* check table_id on SI PID, min interval of the same section, and section of EIT P/F */
+static void check_sect(struct ts_obj *obj, struct ts_sect *sect, int64_t interval)
+{
+        struct ts_err *err = &(obj->err);
+        const struct si_rep_table *rep;
+        uint8_t id = sect->table_id;
+
+        switch(obj->pid->PID) {
+                case 0x0001:
+                        if(0x01 != id) {
+                                err->CAT_error = ERR_2_6_1;
+                                error(obj, TS_ERR_2_6);
+                        }
+                        break;
+                case 0x0010:
+                        if(0x40 != id && 0x41 != id && 0x72 != id) {
+                                error_si(obj, TS_ERR_3_1A, 0);
+                        }
+                        break;
+                case 0x0011:
+                        if(0x42 != id && 0x46 != id && 0x4A != id && 0x72 != id) {
+                                error_si(obj, TS_ERR_3_5A, 0);
+                        }
+                        break;
+                case 0x0012:
+                        if(!(0x4E <= id && id <= 0x6F) && 0x72 != id) {
+                                error_si(obj, TS_ERR_3_6A, 0);
+                        }
+                        break;
+                case 0x0013:
+                        if(0x71 != id && 0x72 != id) {
+                                error_si(obj, TS_ERR_3_7, 0);
+                        }
+                        break;
+                case 0x0014:
+                        if(0x70 != id && 0x72 != id && 0x73 != id) {
+                                error_si(obj, TS_ERR_3_8, 0);
+                        }
+                        break;
+                default:
+                        break;
+        }
+
+        rep = si_rep(id);
+        if(rep->rep_min && 0 <= interval && interval < rep->rep_min) {
+                error_si(obj, rep->idx, 1);
+        }
+
+        /* EIT P/F actual should have section 0 and 1 */
+        if(0x4E == id && (sect->section_number > 1 || 1 != sect->last_section_number)) {
+                err->EIT_error = 1;
+                err->EIT_PF_error = 1;
+                error(obj, TS_ERR_3_6C);
+        }
+        return;
+}
+
+/* check once in CHK_INTERVAL of STC instead of each packet:
+ *      PAT, PMT and SI table missing, CAT_error, PID_error, PTS_error,
+ *      Unreferenced_PID and Empty_buffer_error */
+static void on_timer(struct wnode *node, void *arg)
+{
+        struct ts_obj *obj = (struct ts_obj *)arg;
+
+        switch(node->type) {
+                case TMR_PAT:
+                        tmr_pat(obj);
+                        break;
+                case TMR_CAT:
+                        tmr_cat(obj);
+                        break;
+                case TMR_RATE:
+                        obj->is_rate_due = 1; /* close the window with the next packet */
+                        break;
+                case TMR_TABL:
+                        tmr_tabl(obj, (struct ts_tabl *)(node->data));
+                        break;
+                case TMR_PID:
+                        tmr_pid(obj, (struct ts_pid *)(node->data));
+                        break;
+                default:
+                        RPT(RPT_ERR, "bad timer type: %d", node->type);
+                        break;
+        }
+        return;
+}
+
+/* PAT is never met, after PAT is met, the timer of PAT tabl works */
+static void tmr_pat(struct ts_obj *obj)
+{
+        struct ts_err *err = &(obj->err);
+
+        if(zlst_search(&(obj->tabl0), 0x00)) {
+                return;
+        }
+        err->PAT_error = ERR_1_3_0;
+        error(obj, TS_ERR_1_3);
+        wheel_add(obj->wheel, &(obj->tmr_pat), obj->CLK + 500 * STC_MS);
+        return;
+}
+
+/* CAT is not met in CAT_WAIT after a scrambled packet, the next scrambled packet re-arms it */
+static void tmr_cat(struct ts_obj *obj)
+{
+        struct ts_err *err = &(obj->err);
+
+        if(obj->is_cat_seen) {
+                return;
+        }
+        err->CAT_error = ERR_2_6_0;
+        error(obj, TS_ERR_2_6);
+        return;
+}
+
+/* tabl->CLK is updated by each section, the timer is not moved, so re-arm it here */
+static void tmr_tabl(struct ts_obj *obj, struct ts_tabl *tabl)
+{
+        struct ts_err *err = &(obj->err);
+        int64_t max = tabl_rep_max(tabl);
+
+        if(0 == max) {
+                return;
+        }
+        if(obj->CLK - tabl->CLK >= max) {
+                if(0x00 == tabl->table_id) {
+                        err->PAT_error = ERR_1_3_0;
+                        error(obj, TS_ERR_1_3);
+                }
+                else if(0x02 == tabl->table_id) {
+                        err->PMT_error = ERR_1_5_0;
+                        error(obj, TS_ERR_1_5);
+                }
+                else {
+                        error_si(obj, si_rep(tabl->table_id)->idx, 1);
+                }
+                tabl->CLK = obj->CLK; /* report once in each max */
+        }
+        wheel_add(obj->wheel, &(tabl->tmr), tabl->CLK + max);
+        return;
+}
+
+/* check all deadline of this PID, and re-arm the timer with the nearest one */
+static void tmr_pid(struct ts_obj *obj, struct ts_pid *pid)
+{
+        struct ts_err *err = &(obj->err);
+        struct ts_elem *elem = pid->elem;
+        const struct si_rep_table *rep;
+        int64_t next = -1; /* -1 means nothing to check */
+
+        /* PID_error and PTS_error */
+        if(elem && elem->PID == pid->PID) {
+                if(obj->CLK - pid->CLK >= 5 * STC_1S) {
+                        err->PID_error = 1;
+                        error(obj, TS_ERR_1_6);
+                        pid->CLK = obj->CLK; /* report once in each 5s */
+                }
+                next = clk_min(next, pid->CLK + 5 * STC_1S);
+
+                if(-1 != elem->PTS_CLK) {
+                        if(obj->CLK - elem->PTS_CLK >= 700 * STC_MS) {
+                                err->PTS_error = 1;
+                                error(obj, TS_ERR_2_5);
+                                elem->PTS_CLK = obj->CLK;
+                        }
+                        next = clk_min(next, elem->PTS_CLK + 700 * STC_MS);
+                }
+        }
+
+        /* Empty_buffer_error */
+        if(pid->TB_Rx && -1 != pid->TB_empty) {
+                /* TB_n leaks without packet too, a PID gone quiet is empty now */
+                if(pid->TB_CLK + (int64_t)(pid->TB * 8 * STC_1S / pid->TB_Rx) <= obj->CLK) {
+                        pid->TB_empty = obj->CLK;
+                }
+                if(obj->CLK - pid->TB_empty >= 1 * STC_1S) {
+                        err->Empty_buffer_error = 1;
+                        error(obj, TS_ERR_3_9);
+                        pid->TB_empty = obj->CLK;
+                }
+                next = clk_min(next, pid->TB_empty + 1 * STC_1S);
+        }
+
+        /* PID not in PMT: 3.4a; and not EMM_PID in CAT either: 3.4 */
+        if((TS_TYPE_USR == pid->type && !(pid->elem)) || TS_TYPE_EMM == pid->type) {
+                if(!(obj->is_pat_pmt_parsed)) {
+                        next = clk_min(next, obj->CLK + 500 * STC_MS); /* wait */
+                }
+                else {
+                        if(-1 == pid->CLK0) {
+                                pid->CLK0 = obj->CLK;
+                        }
+                        else if(obj->CLK - pid->CLK0 >= 500 * STC_MS) {
+                                if(obj->CLK - pid->CLK < 500 * STC_MS) {
+                                        /* EMM_PID is known after CAT is met, or there is no CAT PID */
+                                        if(TS_TYPE_USR == pid->type &&
+                                           (obj->is_cat_seen || !(obj->pid_table[0x0001]))) {
+                                                err->Unreferenced_PID = 1;
+                                                error(obj, TS_ERR_3_4);
+                                        }
+                                        err->Unreferenced_PID_2 = 1;
+                                        error(obj, TS_ERR_3_4A);
+                                }
+                                pid->CLK0 = obj->CLK;
+                        }
+                        next = clk_min(next, pid->CLK0 + 500 * STC_MS);
+                }
+        }
+
+        /* PID is present, but the required table is never met */
+        if(pid->PID < 0x0020) {
+                for(rep = SI_REP_TABLE; rep->min != 0xFF; rep++) {
+                        if(!(rep->is_required) ||
+                           rep->PID != pid->PID ||
+                           zlst_search(&(obj->tabl0), rep->min)) {
+                                continue;
+                        }
+                        if(-1 == pid->CLK0) {
+                                pid->CLK0 = obj->CLK;
+                        }
+                        else if(obj->CLK - pid->CLK0 >= rep->rep_max) {
+                                error_si(obj, rep->idx, 1);
+                                pid->CLK0 = obj->CLK;
+                        }
+                        next = clk_min(next, pid->CLK0 + rep->rep_max);
+                }
+        }
+
+        if(-1 != next) {
+                wheel_add(obj->wheel, &(pid->tmr), next);
+        }
+        return;
+}
+
+/* move the timer of PID earlier only, later deadline is found by tmr_pid() */
+static void tmr_pid_arm(struct ts_obj *obj, struct ts_pid *pid, int64_t expire)
+{
+        if(!(pid->tmr.pprev) || expire < pid->tmr.expire) {
+                wheel_add(obj->wheel, &(pid->tmr), expire);
+        }
+        return;
+}
+
+/* max repetition interval of table, 0 means no check */
+static int64_t tabl_rep_max(struct ts_tabl *tabl)
+{
+        if(0x00 == tabl->table_id || 0x02 == tabl->table_id) {
+                return 500 * STC_MS;
+        }
+        return si_rep(tabl->table_id)->rep_max;
+}
+
+static int64_t clk_min(int64_t a, int64_t b)
+{
+        return (-1 == a || b < a) ? b : a;
+}
+
+/* TB_n model of video and audio PID, private PES(0x06) may be teletext with other Rx, skip it */
+static void pid_tb_init(struct ts_pid *pid)
+{
+        pid->TB_Rx = 0;
+        if(pid->elem && 0x06 != pid->elem->stream_type) {
+                if(IS_TYPE(TS_TYPE_VID, pid->type)) {
+                        pid->TB_Rx = TB_RX_VID;
+                }
+                else if(IS_TYPE(TS_TYPE_AUD, pid->type)) {
+                        pid->TB_Rx = TB_RX_AUD;
+                }
+        }
+        pid->TB = 0.0;
+        pid->TB_STC = STC_OVF;
+        pid->TB_CLK = 0;
+        pid->TB_empty = -1;
+        return;
+}
+
+uint32_t ts_rate_cnt(const struct ts_rate *rate, uint16_t PID)
+{
+        PID &= 0x1FFF;
+        return (rate->tag[PID] == rate->epoch) ? rate->cnt[PID] : 0;
+}
+
+/* tag[] of both window is 0, less than any epoch */
+static void rate_init(struct ts_obj *obj)
+{
+        memset(obj->rate, 0, sizeof(obj->rate));
+        obj->rate_last = &(obj->rate[0]);
+        obj->rate_cur = &(obj->rate[1]);
+        obj->rate_last->epoch = 1;
+        obj->rate_cur->epoch = 2;
+        return;
+}
+
+/* clear both window: new epoch for them, older than any tag[] */
+static void rate_clear(struct ts_obj *obj)
+{
+        struct ts_rate *last = obj->rate_last;
+        struct ts_rate *cur = obj->rate_cur;
+
+        last->epoch = cur->epoch + 1;
+        last->interval = 0;
+        last->sys_cnt = 0;
+        last->psi_cnt = 0;
+        last->nul_cnt = 0;
+
+        cur->epoch = cur->epoch + 2;
+        cur->interval = 0;
+        cur->sys_cnt = 0;
+        cur->psi_cnt = 0;
+        cur->nul_cnt = 0;
+        return;
+}
+
+/* cur window becomes rate_last, reuse the old rate_last with a new epoch */
+static void rate_close(struct ts_obj *obj)
+{
+        struct ts_rate *rate = obj->rate_last;
+
+        obj->rate_last = obj->rate_cur;
+        rate->epoch = obj->rate_last->epoch + 1;
+        rate->interval = 0;
+        rate->sys_cnt = 0;
+        rate->psi_cnt = 0;
+        rate->nul_cnt = 0;
+        obj->rate_cur = rate;
+        return;
+}
+
+/* PID count from now, in rate_cur only: rate_last is a closed window, keep it */
+static void rate_pid_clear(struct ts_obj *obj, uint16_t PID)
+{
+        PID &= 0x1FFF;
+        obj->rate_cur->tag[PID] = obj->rate_cur->epoch;
+        obj->rate_cur->cnt[PID] = 0;
+        return;
+}
+
 static int dump(uint8_t *buf, int len)
 {
         uint8_t *p = buf;
@@ -2602,72 +3452,193 @@ static int dump(uint8_t *buf, int len)
         return 0;
 }
 
-uint32_t ts_crc(void *buf, size_t size, int mode)
+/* CRC for PSI/SI section: MSB first, init with all '1', no final xor
+ *      CRC-8:  x^8 + x^2 + x + 1
+ *      CRC-16: x^16 + x^15 + x^12 + 1(the same as old shift register code)
+ *      CRC-32: x^32 + x^26 + x^23 + x^22 + x^16 + x^12 + x^11 + x^10 + x^8 + x^7 + x^5 + x^4 + x^2 + x + 1
+ */
+#define CRC8_POLY                       (0x07)
+#define CRC16_POLY                      (0x9001)
+#define CRC32_POLY                      (0x04C11DB7)
+
+static uint8_t crc8_table[256];
+static uint16_t crc16_table[256];
+static uint32_t crc32_table[8][256]; /* for slicing-by-8 */
+
+#ifdef CRC_CLMUL
+static int has_clmul = 0; /* CPU support PCLMULQDQ and SSSE3 */
+static uint64_t K[4]; /* x^(64+128), x^128, x^(64+512), x^512 mod CRC32_POLY */
+#endif
+
+static void crc_table_init(void)
 {
-        int bitcount = 0;
-        int bitinbyte = 0;
-        unsigned short databit;
-        unsigned short shiftreg[32];
-        /*                      0 1 2 3 4 5 6 7 8 */
-        unsigned short g08[] = {1,1,1,0,0,0,0,0,1};
-        /*                      0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 */
-        unsigned short g16[] = {1,0,0,0,0,0,0,0,0,0,0,0,1,0,0,1,1};
-        /*                      0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 */
-        unsigned short g32[] = {1,1,1,0,1,1,0,1,1,0,1,1,1,0,0,0,1,0,0,0,0,0,1,1,0,0,1,0,0,0,0,0,1};
-
-        unsigned short *g;
-        int i,nrbits;
-        char *data;
-        int cnt;
+        int i;
+        int k;
         uint32_t crc;
 
-        switch(mode) {
-                case  8: g = g08; cnt =  8; break;
-                case 16: g = g16; cnt = 16; break;
-                default: g = g32; cnt = 32; break;
+        for(i = 0; i < 256; i++) {
+                crc = i;
+                for(k = 0; k < 8; k++) {
+                        crc = (crc & 0x80) ? ((crc << 1) ^ CRC8_POLY) : (crc << 1);
+                }
+                crc8_table[i] = (uint8_t)crc;
+
+                crc = i << 8;
+                for(k = 0; k < 8; k++) {
+                        crc = (crc & 0x8000) ? ((crc << 1) ^ CRC16_POLY) : (crc << 1);
+                }
+                crc16_table[i] = (uint16_t)crc;
+
+                crc = i << 24;
+                for(k = 0; k < 8; k++) {
+                        crc = (crc & 0x80000000) ? ((crc << 1) ^ CRC32_POLY) : (crc << 1);
+                }
+                crc32_table[0][i] = crc;
         }
 
-        /* Initialize shift register's to '1' */
-        for(i = 0; i < cnt; i++) {
-                shiftreg[i] = 1;
+        /* crc32_table[k][i]: CRC of byte i followed by k zero bytes */
+        for(i = 0; i < 256; i++) {
+                crc = crc32_table[0][i];
+                for(k = 1; k < 8; k++) {
+                        crc = (crc << 8) ^ crc32_table[0][crc >> 24];
+                        crc32_table[k][i] = crc;
+                }
         }
 
-        /* Calculate nr of data bits */
-        nrbits = ((int) size) * 8;
-        data = buf;
+#ifdef CRC_CLMUL
+        K[0] = crc32_xn(64 + 128);
+        K[1] = crc32_xn(128);
+        K[2] = crc32_xn(64 + 512);
+        K[3] = crc32_xn(512);
+        __builtin_cpu_init();
+        has_clmul = (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3"));
+#endif
+        return;
+}
 
-        while(bitcount < nrbits) {
-                /* Fetch bit from bitstream */
-                databit = (short int) (*data  & (0x80 >> bitinbyte));
-                databit = databit >> (7 - bitinbyte);
-                bitinbyte++;
-                bitcount++;
-                if(bitinbyte == 8) {
-                        bitinbyte = 0;
-                        data++;
-                }
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t *p, size_t size)
+{
+        /* byte by byte until p is 4-byte aligned */
+        for(; size && ((uintptr_t)p & 3); size--) {
+                crc = (crc << 8) ^ crc32_table[0][(crc >> 24) ^ *p++];
+        }
 
-                /* Perform the shift and modula 2 addition */
-                databit ^= shiftreg[cnt - 1];
-                i = cnt - 1;
-                while (i != 0) {
-                        if (g[i]) {
-                                shiftreg[i] = shiftreg[i-1] ^ databit;
-                        }
-                        else {
-                                shiftreg[i] = shiftreg[i-1];
-                        }
-                        i--;
-                }
-                shiftreg[0] = databit;
+        /* 8 bytes each time */
+        for(; size >= 8; size -= 8, p += 8) {
+                crc ^= ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+                crc = crc32_table[7][crc >> 24] ^
+                      crc32_table[6][(crc >> 16) & 0xFF] ^
+                      crc32_table[5][(crc >> 8) & 0xFF] ^
+                      crc32_table[4][crc & 0xFF] ^
+                      crc32_table[3][p[4]] ^
+                      crc32_table[2][p[5]] ^
+                      crc32_table[1][p[6]] ^
+                      crc32_table[0][p[7]];
         }
 
-        /* make CRC an UIMSBF */
-        crc = 0;
-        for(i = 0; i < cnt; i++) {
-                crc = (crc << 1) | ((unsigned int) shiftreg[cnt - 1 - i]);
+        /* left bytes */
+        for(; size; size--) {
+                crc = (crc << 8) ^ crc32_table[0][(crc >> 24) ^ *p++];
         }
+        return crc;
+}
+
+#ifdef CRC_CLMUL
+/* x^n mod CRC32_POLY */
+static uint32_t crc32_xn(int n)
+{
+        uint32_t r = 1;
+
+        while(n--) {
+                r = (r & 0x80000000) ? ((r << 1) ^ CRC32_POLY) : (r << 1);
+        }
+        return r;
+}
+
+/* 16 bytes of data as a 128-bit polynomial, the first byte is the highest */
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i clmul_load(const uint8_t *p)
+{
+        const __m128i swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
 
+        return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), swap);
+}
+
+/* x * x^128 with k = {x^(64+128), x^128}, or x * x^512 with {x^(64+512), x^512}, mod CRC32_POLY */
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i clmul_fold(__m128i x, __m128i k)
+{
+        return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11), _mm_clmulepi64_si128(x, k, 0x00));
+}
+
+/* fold 64 bytes each time, size should be 64 at least */
+__attribute__((target("pclmul,ssse3")))
+static uint32_t crc32_clmul(uint32_t crc, const uint8_t *p, size_t size)
+{
+        const __m128i swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        __m128i k16 = _mm_set_epi64x(K[0], K[1]);
+        __m128i k64 = _mm_set_epi64x(K[2], K[3]);
+        __m128i x0, x1, x2, x3;
+        uint8_t tmp[16];
+
+        /* CRC with init value is the same as CRC of data with the init value xored in its head */
+        x0 = _mm_xor_si128(clmul_load(p), _mm_set_epi32(crc, 0, 0, 0));
+        x1 = clmul_load(p + 16);
+        x2 = clmul_load(p + 32);
+        x3 = clmul_load(p + 48);
+        p += 64;
+        size -= 64;
+
+        for(; size >= 64; size -= 64, p += 64) {
+                x0 = _mm_xor_si128(clmul_fold(x0, k64), clmul_load(p));
+                x1 = _mm_xor_si128(clmul_fold(x1, k64), clmul_load(p + 16));
+                x2 = _mm_xor_si128(clmul_fold(x2, k64), clmul_load(p + 32));
+                x3 = _mm_xor_si128(clmul_fold(x3, k64), clmul_load(p + 48));
+        }
+
+        x0 = _mm_xor_si128(clmul_fold(x0, k16), x1);
+        x0 = _mm_xor_si128(clmul_fold(x0, k16), x2);
+        x0 = _mm_xor_si128(clmul_fold(x0, k16), x3);
+        for(; size >= 16; size -= 16, p += 16) {
+                x0 = _mm_xor_si128(clmul_fold(x0, k16), clmul_load(p));
+        }
+
+        /* the last 128-bit and left bytes by table */
+        _mm_storeu_si128((__m128i *)tmp, _mm_shuffle_epi8(x0, swap));
+        crc = crc32_slice8(0, tmp, 16);
+        return crc32_slice8(crc, p, size);
+}
+#endif
+
+uint32_t ts_crc(void *buf, size_t size, int mode)
+{
+        const uint8_t *p = (const uint8_t *)buf;
+        uint32_t crc;
+
+        switch(mode) {
+                case 8:
+                        crc = 0xFF;
+                        for(; size; size--) {
+                                crc = crc8_table[crc ^ *p++];
+                        }
+                        break;
+                case 16:
+                        crc = 0xFFFF;
+                        for(; size; size--) {
+                                crc = ((crc << 8) ^ crc16_table[(crc >> 8) ^ *p++]) & 0xFFFF;
+                        }
+                        break;
+                default:
+                        crc = 0xFFFFFFFF;
+#ifdef CRC_CLMUL
+                        if(has_clmul && size >= 256) {
+                                crc = crc32_clmul(crc, p, size);
+                                break;
+                        }
+#endif
+                        crc = crc32_slice8(crc, p, size);
+                        break;
+        }
         return crc;
 }
 
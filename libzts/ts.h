@@ -41,6 +41,7 @@ extern "C" {
 #endif
 
 #include "zlst.h" /* for "struct znode" */
+#include "wheel.h" /* for "struct wnode" */
 
 #define STC_BASE_MS  (90)        /* 90 clk == 1(ms) */
 #define STC_BASE_1S  (90 * 1000) /* do NOT use 1e3 */
@@ -102,6 +103,38 @@ extern "C" {
 #define IS_TYPE(t, x)   (t == (x & TS_TMSK_BASE))
 
 /* TR 101 290 V1.2.1 2001-05 */
+
+/* bit of ts_err.mask, and index of ts_err.cnt[] */
+#define TS_ERR_1_1      (0) /* TS_sync_loss */
+#define TS_ERR_1_2      (1) /* Sync_byte_error */
+#define TS_ERR_1_3      (2) /* PAT_error */
+#define TS_ERR_1_4      (3) /* Continuity_count_error */
+#define TS_ERR_1_5      (4) /* PMT_error */
+#define TS_ERR_1_6      (5) /* PID_error */
+#define TS_ERR_2_1      (6) /* Transport_error */
+#define TS_ERR_2_2      (7) /* CRC_error */
+#define TS_ERR_2_3A     (8) /* PCR_repetition_error */
+#define TS_ERR_2_3B     (9) /* PCR_discontinuity_indicator_error */
+#define TS_ERR_2_4      (10) /* PCR_accuracy_error */
+#define TS_ERR_2_5      (11) /* PTS_error */
+#define TS_ERR_2_6      (12) /* CAT_error */
+#define TS_ERR_3_1A     (13) /* NIT_actual_error */
+#define TS_ERR_3_1B     (14) /* NIT_other_error */
+#define TS_ERR_3_2      (15) /* SI_repetition_error */
+#define TS_ERR_3_3      (16) /* Buffer_error */
+#define TS_ERR_3_4      (17) /* Unreferenced_PID */
+#define TS_ERR_3_4A     (18) /* Unreferenced_PID_2 */
+#define TS_ERR_3_5A     (19) /* SDT_actual_error */
+#define TS_ERR_3_5B     (20) /* SDT_other_error */
+#define TS_ERR_3_6A     (21) /* EIT_actual_error */
+#define TS_ERR_3_6B     (22) /* EIT_other_error */
+#define TS_ERR_3_6C     (23) /* EIT_PF_error */
+#define TS_ERR_3_7      (24) /* RST_error */
+#define TS_ERR_3_8      (25) /* TDT_error */
+#define TS_ERR_3_9      (26) /* Empty_buffer_error */
+#define TS_ERR_3_10     (27) /* Data_delay_error */
+#define TS_ERR_MAX      (28)
+
 struct ts_err {
         /* First priority: necessary for de-codability (basic monitoring) */
         int TS_sync_loss; /* 1.1 */
@@ -124,6 +157,8 @@ struct ts_err {
         int PCR_discontinuity_indicator_error; /* 2.3b */
         int PCR_accuracy_error; /* 2.4 */
         int PTS_error; /* 2.5 */
+#define ERR_2_6_0 (1<<0)
+#define ERR_2_6_1 (1<<1)
         int CAT_error; /* 2.6 */
 
         /* Third priority: application dependant monitoring */
@@ -132,8 +167,8 @@ struct ts_err {
         int NIT_other_error; /* 3.1b */
         int SI_repetition_error; /* 3.2 */
         int Buffer_error; /* 3.3 */
-        int Unreferenced_PID; /* 3.4 */
-        int Unreferenced_PID_2; /* 3.4a */
+        int Unreferenced_PID; /* 3.4 ---- not in PMT, not EMM_PID in CAT either */
+        int Unreferenced_PID_2; /* 3.4a ---- not in PMT */
         int SDT_error; /* 3.5 */
         int SDT_actual_error; /* 3.5a */
         int SDT_other_error; /* 3.5b */
@@ -145,6 +180,10 @@ struct ts_err {
         int TDT_error; /* 3.8 */
         int Empty_buffer_error; /* 3.9 */
         int Data_delay_error; /* 3.10 */
+
+        /* the field above is kept until consumer clears it, the two below are kept by libzts */
+        uint32_t mask; /* BIT(TS_ERR_xxx) raised in this packet, 0 means no error */
+        int64_t cnt[TS_ERR_MAX]; /* count since TS_INIT: 1.1, 1.2 once for each run, others once for each packet, not in 1.1 */
 };
 
 /* TS head */
@@ -229,6 +268,7 @@ struct ts_pesh {
 /* node of section list */
 struct ts_sect {
         struct znode cvfl; /* common variable for list */
+        int is_slab; /* bool, got by slab_malloc(), 0 if imported by xml2list() */
 
         /* section data */
         uint8_t *section; /* point to the section buffer: 3 + section_length */
@@ -248,6 +288,10 @@ struct ts_sect {
 
         int check_CRC; /* bool, some table do not need to check CRC_32 */
         int type; /* TS_TYPE_xxx */
+
+        int is_parsed; /* bool, all info of body is got, do not parse repetition again */
+        uint32_t repeat; /* count of repetition with the same head and CRC_32 */
+        int64_t STC; /* for minimum repetition interval of SI section */
 };
 
 /* node of PSI/SI table list */
@@ -259,6 +303,10 @@ struct ts_tabl {
         uint8_t version_number;
         uint8_t last_section_number;
         int64_t STC; /* for pid->sect_interval */
+
+        /* for repetition timeout */
+        struct wnode tmr;
+        int64_t CLK; /* CLK of last section or last timeout error */
 };
 
 /* node of elementary list */
@@ -274,6 +322,7 @@ struct ts_elem {
         /* for PTS/DTS mark */
         int64_t PTS; /* last PTS, for obj->PTS_interval */
         int64_t DTS; /* last DTS, for obj->DTS_interval */
+        int64_t PTS_CLK; /* CLK of last PTS or last PTS_error, -1 if no PTS to check */
 
         int is_pes_align; /* met first PES head */
 };
@@ -305,20 +354,17 @@ struct ts_prog {
         int64_t ADDb; /* PCR packet b: packet address */
         int64_t PCRb; /* PCR packet b: PCR value */
         int is_STC_sync; /* true: PCRa and PCRb OK, STC can be calc */
-};
-
-/* node of packet list, for ts2sect() or sect2ts() */
-struct ts_pkt {
-        struct znode cvfl; /* common variable for list */
 
-        uint8_t pkt[TS_PKT_SIZE];
-        uint8_t payload_unit_start_indicator; /* 1-bit */
-        int payload_size;
+        /* for PCR_OJ calc, according to CTS from ipt */
+        int64_t OJ_CTS0; /* CTS of the last PCR packet, origin of time(x) */
+        int64_t OJ_ofs0; /* PCR - CTS of the last PCR packet, origin of offset(y) */
+        double OJ_n, OJ_x, OJ_y, OJ_xx, OJ_xy; /* weighted sum for linear fit of offset(y) with time(x) */
 };
 
 /* node of pid list */
 struct ts_pid {
         struct znode cvfl; /* common variable for list */
+        int is_slab; /* bool, got by slab_malloc(), 0 if imported by xml2list() */
 
         uint16_t PID; /* 13-bit */
         int type; /* TS_TYPE_xxx */
@@ -330,18 +376,26 @@ struct ts_pid {
         int is_CC_sync;
         uint8_t CC; /* 4-bit */
 
-        /* for statistic */
-        uint32_t cnt; /* packet received from last PCR */
-        uint32_t lcnt; /* packet received from PCRa to PCRb */
-
         /* only for PID with PSI/SI */
-        struct ts_pkt *pkt0;
-        int payload_total; /* accumulate size_of_payload packet by packet */
-        int has_new_sech; /* true, if second section head in pkt list */
+        int is_sect_sync; /* 0: wait for payload_unit_start_indicator */
+        uint8_t *section; /* section being collected, (3 + section_length)-byte, NULL before sech3 is OK */
+        int section_got; /* byte collected in section */
         int sech3_idx; /* 0~3, 3 means sech3 is OK */
         uint8_t sech3[3]; /* collect first 3-byte to get section_length */
         uint8_t table_id; /* TABLE_ID_TABLE */
         uint16_t section_length; /* 12-bit */
+
+        /* for TR 101 290 timeout check */
+        struct wnode tmr;
+        int64_t CLK; /* CLK of last packet or last PID_error */
+        int64_t CLK0; /* CLK to check Unreferenced_PID or SI table missing from, -1 if not start */
+
+        /* TB_n of T-STD, only for video and audio, for Buffer_error and Empty_buffer_error */
+        int64_t TB_Rx; /* leak rate(bit/s), 0 means no TB_n model */
+        double TB; /* byte in TB_n */
+        int64_t TB_STC; /* STC of last packet in TB_n */
+        int64_t TB_CLK; /* CLK of last packet in TB_n, to drain it in timer */
+        int64_t TB_empty; /* CLK of last time TB_n is empty or last Empty_buffer_error, -1 if not start */
 };
 
 /* input: information about one packet, tell me as more as you can :-) */
@@ -370,8 +424,35 @@ struct ts_cfg {
         int need_pes;  /* not 0: parse PES head(PTS, DTS) */
         int need_pes_align; /* not 0: ignore data before first PES head */
         int need_statistic; /* not 0: need statistic information */
+        int crc_sample; /* check CRC_32 of 1 in crc_sample repeated section, 0 or 1: each one, < 0: never */
+};
+
+/* packet count of one rate window, PID is the index of cnt[]
+ * cnt[PID] is valid only if tag[PID] == epoch, so a new window need not clear cnt[] */
+struct ts_rate {
+        uint32_t epoch; /* number of this window */
+        int64_t interval; /* time of this window, set when it is closed */
+        int64_t sys_cnt; /* system packet count */
+        int64_t psi_cnt; /* psi-si packet count */
+        int64_t nul_cnt; /* empty packet count */
+        uint32_t tag[0x2000];
+        uint32_t cnt[0x2000];
 };
 
+/* event in ts_parse_tsh() and ts_parse_tsb() of one packet */
+#define TS_EVT_PCR      (0) /* new PCR, see has_pcr, PCR_xxx */
+#define TS_EVT_PTS      (1) /* new PTS or DTS, see has_pts, has_dts, PTS_xxx, DTS_xxx */
+#define TS_EVT_SECT     (2) /* section complete, see sect, sect_interval */
+#define TS_EVT_TABL     (3) /* new table or new version of table, after TS_EVT_SECT */
+#define TS_EVT_ERR      (4) /* error raised, see err */
+#define TS_EVT_RATE     (5) /* rate window closed, see has_rate, rate_last */
+#define TS_EVT_MAX      (6)
+
+struct ts_obj;
+
+/* called when evt happens, maybe more than once in one packet, e.g. TS_EVT_SECT */
+typedef void (*ts_event_cb)(struct ts_obj *obj, int evt, void *arg);
+
 /* object about one transfer stream */
 struct ts_obj {
         struct ts_ipt ipt; /* input */
@@ -405,7 +486,10 @@ struct ts_obj {
         int16_t PCR_ext;
         int64_t PCR_interval; /* PCR packet arrive time interval */
         int64_t PCR_continuity; /* PCR value interval */
-        int64_t PCR_jitter; /* PCR - STC */
+        int64_t PCR_jitter; /* PCR - STC, PCR_AC in TR 101 290 */
+        int has_oj; /* PCR_OJ and PCR_FO are OK, need CTS from ipt, e.g. "catip -t" */
+        int64_t PCR_OJ; /* PCR overall jitter: PCR - arrive time, frequency offset removed */
+        double PCR_FO; /* PCR frequency offset against arrive clock(unit: ppm) */
 
         /* PES */
         uint8_t *PES; /* point to PES fragment */
@@ -433,13 +517,15 @@ struct ts_obj {
         struct ts_pid *pid; /* point to the node in pid_list */
 
         /* TS information */
+        uint8_t *TS; /* point to TS data of this packet, ipt.TS[] or buffer of ts_parse_batch() */
         int64_t ADDR; /* address of sync-byte(unit: byte) */
         int64_t cnt; /* count of this packet in this stream, start from 0 */
 
         struct ts_tsh tsh; /* info about ts head of this packet */
         struct ts_af af; /* info about af of this packet */
         struct ts_pesh pesh; /* info about pesh of this packet */
-        struct ts_pid *pid0; /* pid list of this stream */
+        struct ts_pid *pid0; /* pid list of this stream, sorted by PID */
+        struct ts_pid *pid_table[0x2000]; /* index of pid list, NULL means not in list */
 
         /* PSI/SI table */
         uint16_t transport_stream_id;
@@ -457,22 +543,33 @@ struct ts_obj {
         /* for bit-rate statistic */
         int64_t aim_interval; /* appointed interval */
         int64_t interval; /* time passed from last rate calc */
-        int64_t sys_cnt; /* system packet count */
-        int64_t psi_cnt; /* psi-si packet count */
-        int64_t nul_cnt; /* empty packet count */
-
+        struct ts_rate rate[2]; /* double buffer of rate_cur and rate_last */
+        struct ts_rate *rate_cur; /* window being counted */
+        struct ts_rate *rate_last; /* last closed window, stable until the next window is closed */
         int has_rate; /* new bit-rate ready */
-        int64_t last_interval; /* interval from PCRa to PCRb */
-        int64_t last_sys_cnt; /* system packet count from PCRa to PCRb */
-        int64_t last_psi_cnt; /* psi-si packet count from PCRa to PCRb */
-        int64_t last_nul_cnt; /* empty packet count from PCRa to PCRb */
 
         /* error */
         struct ts_err err;
 
+        /* timer wheel for timeout check and rate window */
+        intptr_t wheel;
+        int64_t CLK; /* follow CTS but never wrap or jump, unit is the same as CTS */
+        int64_t CLK_CTS; /* CTS of last CLK update */
+        struct wnode tmr_pat; /* PAT is never met */
+        struct wnode tmr_cat; /* scrambled packet, but CAT is not met */
+        int is_cat_seen; /* CAT is met, instead of search tabl0 for each scrambled packet */
+        struct wnode tmr_rate; /* end of rate window */
+        int is_rate_due; /* rate window should be closed */
+
+        /* event callback, NULL means not registered */
+        ts_event_cb evt_cb[TS_EVT_MAX];
+        void *evt_arg[TS_EVT_MAX];
+
         /* special variables for ts object */
         int state;
         intptr_t mp; /* id of buddy memory pool, for list malloc and free */
+        intptr_t slab_pid; /* slab cache in mp, for struct ts_pid */
+        intptr_t slab_sect; /* slab cache in mp, for struct ts_sect */
 
         /* special variables for packet analyse */
         uint8_t *cur; /* point to the current data in TS[] */
@@ -486,13 +583,35 @@ int ts_destroy(struct ts_obj *obj);
 #define TS_INIT         (0) /* init object for new application */
 #define TS_SCFG         (1) /* set ts_cfg to object */
 #define TS_TIDY         (2) /* tidy wild pointer in object */
+#define TS_MEM          (3) /* show slab status to stderr, arg: not 0 to enable */
 int ts_ioctl(struct ts_obj *obj, int cmd, intptr_t arg);
 
+/* register cb for evt(TS_EVT_xxx), cb NULL to cancel
+ * consumer pays only for the event it registered, instead of checking all fields after each packet */
+int ts_event(struct ts_obj *obj, int evt, ts_event_cb cb, void *arg);
+
 int ts_parse_tsh(struct ts_obj *obj);
 int ts_parse_tsb(struct ts_obj *obj);
 
+/* call after ts_parse_tsh() and ts_parse_tsb() of each packet,
+ * return not 0 to stop ts_parse_batch() */
+typedef int (*ts_batch_cb)(struct ts_obj *obj, void *arg);
+
+/* parse n packets in buf[] without copy them into ipt.TS[]:
+ *      buf: TS data of the first packet
+ *      stride: distance between packets, 188, 192(MTS) or 204(TSRS, RS is copied into ipt.RS[])
+ *      ADDR[n], MTS[n]: per-packet ADDR and MTS, NULL if not available
+ *      cb: called for each packet, NULL if not needed
+ * return: 0 if all packets parsed, -1 if failed, or the not 0 value of cb()
+ */
+int ts_parse_batch(struct ts_obj *obj, uint8_t *buf, int n, int stride,
+                   const int64_t *ADDR, const int64_t *MTS, ts_batch_cb cb, void *arg);
+
 uint32_t ts_crc(void *buf, size_t size, int mode);
 
+/* packet count of PID in rate window, e.g. obj->rate_last */
+uint32_t ts_rate_cnt(const struct ts_rate *rate, uint16_t PID);
+
 /* calculate timestamp:
  *      t0: [0, ovf);
  *      t1: [0, ovf);
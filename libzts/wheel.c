@@ -0,0 +1,272 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: wheel.c
+ * funx: hierarchical timer wheel, add, delete and expire timer in O(1)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h> /* for uintN_t, etc */
+
+#include "wheel.h"
+
+/* report level */
+#define RPT_ERR (1) /* error, system error */
+#define RPT_WRN (2) /* warning, maybe wrong, maybe OK */
+#define RPT_INF (3) /* important information */
+#define RPT_DBG (4) /* debug information */
+
+/* report micro */
+#define RPT(lvl, ...) do \
+{ \
+        if(lvl <= rpt_lvl) \
+        { \
+                switch(lvl) \
+                { \
+                        case RPT_ERR: fprintf(stderr, "%s: %d: err: ", __FILE__, __LINE__); break; \
+                        case RPT_WRN: fprintf(stderr, "%s: %d: wrn: ", __FILE__, __LINE__); break; \
+                        case RPT_INF: fprintf(stderr, "%s: %d: inf: ", __FILE__, __LINE__); break; \
+                        case RPT_DBG: fprintf(stderr, "%s: %d: dbg: ", __FILE__, __LINE__); break; \
+                        default:      fprintf(stderr, "%s: %d: ???: ", __FILE__, __LINE__); break; \
+                } \
+                fprintf(stderr, __VA_ARGS__); \
+                fprintf(stderr, "\n"); \
+        } \
+} while (0)
+
+static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
+
+#define LVL_BITS (6)
+#define LVL_SIZE (1 << LVL_BITS) /* slot in each level */
+#define LVL_MASK (LVL_SIZE - 1)
+#define LVL_NUM (4)
+#define SPAN_MAX ((int64_t)1 << (LVL_BITS * LVL_NUM)) /* tick */
+
+/* slot[0][i] has node expire in tick i (mod 64) of the next 64 tick,
+ * slot[n][i] has node expire in (64^n)-tick block i (mod 64),
+ * they are moved to lower level when cur reach the start of the block */
+struct wheel {
+        int64_t tick;
+        int64_t cur; /* current tick */
+        size_t cnt; /* node in wheel */
+        struct wnode *slot[LVL_NUM][LVL_SIZE];
+};
+
+static void link_node(struct wheel *w, struct wnode *node);
+static void unlink_node(struct wnode *node);
+static void cascade(struct wheel *w, int lvl);
+
+intptr_t wheel_create(int64_t tick)
+{
+        struct wheel *w;
+
+        if(tick <= 0) {
+                RPT(RPT_ERR, "create: bad tick: %lld", (long long int)tick);
+                return 0; /* failed */
+        }
+
+        w = (struct wheel *)calloc(1, sizeof(struct wheel));
+        if(NULL == w) {
+                RPT(RPT_ERR, "create: malloc wheel object failed");
+                return 0; /* failed */
+        }
+
+        w->tick = tick;
+        w->cur = 0;
+        w->cnt = 0;
+        return (intptr_t)w;
+}
+
+int wheel_destroy(intptr_t id)
+{
+        struct wheel *w = (struct wheel *)id;
+
+        if(NULL == w) {
+                RPT(RPT_ERR, "destroy: bad id");
+                return -1;
+        }
+
+        free(w);
+        return 0;
+}
+
+int wheel_reset(intptr_t id, int64_t now)
+{
+        struct wheel *w = (struct wheel *)id;
+        int lvl;
+        int i;
+
+        if(NULL == w) {
+                RPT(RPT_ERR, "reset: bad id");
+                return -1;
+        }
+
+        for(lvl = 0; lvl < LVL_NUM; lvl++) {
+                for(i = 0; i < LVL_SIZE; i++) {
+                        struct wnode *node;
+
+                        while(NULL != (node = w->slot[lvl][i])) {
+                                unlink_node(node);
+                        }
+                }
+        }
+        w->cur = now / w->tick;
+        w->cnt = 0;
+        return 0;
+}
+
+void wheel_node_init(struct wnode *node, int type, void *data)
+{
+        node->next = NULL;
+        node->pprev = NULL;
+        node->expire = 0;
+        node->type = type;
+        node->data = data;
+        return;
+}
+
+int wheel_add(intptr_t id, struct wnode *node, int64_t expire)
+{
+        struct wheel *w = (struct wheel *)id;
+
+        if(NULL == w) {
+                RPT(RPT_ERR, "add: bad id");
+                return -1;
+        }
+
+        if(node->pprev) {
+                unlink_node(node);
+                w->cnt--;
+        }
+        node->expire = expire;
+        link_node(w, node);
+        w->cnt++;
+        return 0;
+}
+
+int wheel_del(intptr_t id, struct wnode *node)
+{
+        struct wheel *w = (struct wheel *)id;
+
+        if(NULL == w) {
+                RPT(RPT_ERR, "del: bad id");
+                return -1;
+        }
+
+        if(node->pprev) {
+                unlink_node(node);
+                w->cnt--;
+        }
+        return 0;
+}
+
+int wheel_run(intptr_t id, int64_t now, wheel_cb cb, void *arg)
+{
+        struct wheel *w = (struct wheel *)id;
+        int64_t t;
+
+        if(NULL == w) {
+                RPT(RPT_ERR, "run: bad id");
+                return -1;
+        }
+
+        t = now / w->tick;
+        while(w->cnt) {
+                struct wnode *list = w->slot[0][w->cur & LVL_MASK];
+                struct wnode *node;
+
+                /* take the slot out, cb may add node into it again */
+                w->slot[0][w->cur & LVL_MASK] = NULL;
+                if(list) {
+                        list->pprev = &list;
+                }
+                while(NULL != (node = list)) {
+                        unlink_node(node);
+                        if(node->expire <= now) {
+                                w->cnt--;
+                                cb(node, arg);
+                        }
+                        else {
+                                link_node(w, node); /* later in this tick */
+                        }
+                }
+
+                if(w->cur >= t) {
+                        return 0;
+                }
+                w->cur++;
+                if(0 == (w->cur & LVL_MASK)) {
+                        cascade(w, 1);
+                }
+        }
+
+        /* no node, jump to now directly */
+        if(w->cur < t) {
+                w->cur = t;
+        }
+        return 0;
+}
+
+static void link_node(struct wheel *w, struct wnode *node)
+{
+        int64_t t = node->expire / w->tick;
+        int64_t d;
+        int lvl;
+        struct wnode **head;
+
+        if(t < w->cur) {
+                t = w->cur; /* expired already, in current slot */
+        }
+        d = t - w->cur;
+        if(d >= SPAN_MAX) {
+                t = w->cur + SPAN_MAX - 1;
+                d = SPAN_MAX - 1;
+        }
+        for(lvl = 0; lvl < LVL_NUM - 1; lvl++) {
+                if(d < ((int64_t)1 << (LVL_BITS * (lvl + 1)))) {
+                        break;
+                }
+        }
+
+        head = &(w->slot[lvl][(t >> (LVL_BITS * lvl)) & LVL_MASK]);
+        node->next = *head;
+        if(node->next) {
+                node->next->pprev = &(node->next);
+        }
+        node->pprev = head;
+        *head = node;
+        return;
+}
+
+static void unlink_node(struct wnode *node)
+{
+        *(node->pprev) = node->next;
+        if(node->next) {
+                node->next->pprev = node->pprev;
+        }
+        node->next = NULL;
+        node->pprev = NULL;
+        return;
+}
+
+/* cur is the start of a block of level lvl, move node of the block to lower level */
+static void cascade(struct wheel *w, int lvl)
+{
+        int idx = (int)((w->cur >> (LVL_BITS * lvl)) & LVL_MASK);
+        struct wnode *list;
+        struct wnode *node;
+
+        if(0 == idx && lvl + 1 < LVL_NUM) {
+                cascade(w, lvl + 1); /* higher level first */
+        }
+
+        list = w->slot[lvl][idx];
+        w->slot[lvl][idx] = NULL;
+        if(list) {
+                list->pprev = &list;
+        }
+        while(NULL != (node = list)) {
+                unlink_node(node);
+                link_node(w, node);
+        }
+        return;
+}
@@ -0,0 +1,46 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: wheel.h
+ * funx: hierarchical timer wheel, add, delete and expire timer in O(1)
+ */
+
+#ifndef _WHEEL_H
+#define _WHEEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h> /* for intptr_t, etc */
+
+/* timer node, put it in the struct of user, no malloc in wheel */
+struct wnode {
+        struct wnode *next;
+        struct wnode **pprev; /* NULL means not in wheel */
+        int64_t expire; /* time to call wheel_cb */
+        int type; /* for user */
+        void *data; /* for user */
+};
+
+/* called for expired node, node is out of wheel now, so it can be added again in cb */
+typedef void (*wheel_cb)(struct wnode *node, void *arg);
+
+/* 4 level x 64 slot, the first level is 64 tick, the last level is 2^24 tick,
+ * expire further than 2^24 tick is cut to 2^24 tick
+ *      tick: time of each slot in level 0, the same unit as expire and now */
+intptr_t wheel_create(int64_t tick);
+int wheel_destroy(intptr_t id);
+int wheel_reset(intptr_t id, int64_t now); /* remove all node, and set time to now */
+
+void wheel_node_init(struct wnode *node, int type, void *data); /* call before the first wheel_add() */
+int wheel_add(intptr_t id, struct wnode *node, int64_t expire); /* node in wheel is moved */
+int wheel_del(intptr_t id, struct wnode *node); /* node not in wheel is OK */
+
+/* call cb for each node with (expire <= now), call it for each packet is OK
+ * now should not go back more than one tick */
+int wheel_run(intptr_t id, int64_t now, wheel_cb cb, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WHEEL_H */
@@ -0,0 +1,444 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: bin.c
+ * funx: binary TS packet input with sync detection
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* for memmove(), etc */
+#include <errno.h>
+
+#include "config.h" /* for SYS_* macro, generated by configure */
+
+#ifdef SYS_WINDOWS
+#       define WIN32_LEAN_AND_MEAN
+#       include <windows.h> /* for CreateFileMapping(), etc */
+#       include <io.h> /* for _setmode(), _read(), etc */
+#       include <fcntl.h> /* for _O_BINARY */
+#       define read _read
+#else /* unix-like PLATFORM */
+#       include <unistd.h> /* for read(), close() */
+#       include <fcntl.h> /* for open() */
+#       include <sys/stat.h> /* for fstat() */
+#       include <sys/mman.h> /* for mmap(), madvise(), etc */
+#endif
+
+#include "common.h"
+#include "bin.h"
+
+static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
+
+#define SYNC_TIME       3 /* SYNC_TIME syncs means TS sync */
+#define SYNC_SPAN       (BIN_TYPE_TSRS * SYNC_TIME) /* enough data to judge type */
+#define BIN_BUF_SIZE    (BIN_TYPE_TSRS * 188 * 32) /* about 1.2MB, n * 188 and n * 204 */
+
+struct bin {
+        FILE *fd;
+        int is_stdin;
+        int is_map; /* buf[] is the mapped file */
+        int is_eof;
+        int type; /* BIN_TYPE_xxx */
+
+        uint8_t *buf;
+        size_t size; /* size of buf[] */
+        size_t head; /* first byte not parsed */
+        size_t tail; /* first byte not filled */
+        int64_t addr; /* address of buf[0] in the stream */
+};
+
+static int fill(struct bin *bin);
+static int judge_type(struct bin *bin);
+static int is_sync(const uint8_t *p, int size);
+static int64_t mts_time(const uint8_t *p);
+
+/* search sync position and packet size in buf[], return BIN_TYPE_xxx
+ * off: sync position if got one, or the bytes can be dropped if not */
+int bin_sync(const uint8_t *buf, size_t len, size_t *off)
+{
+        size_t i;
+
+        for(i = 0; i + BIN_TYPE_TSRS * (SYNC_TIME - 1) < len; i++) {
+                if(0x47 != buf[i]) {
+                        continue;
+                }
+                if(is_sync(buf + i, BIN_TYPE_TS)) {
+                        *off = i;
+                        return BIN_TYPE_TS;
+                }
+                if(is_sync(buf + i, BIN_TYPE_MTS) && i >= 4) {
+                        *off = i - 4;
+                        return BIN_TYPE_MTS;
+                }
+                if(is_sync(buf + i, BIN_TYPE_TSRS)) {
+                        *off = i;
+                        return BIN_TYPE_TSRS;
+                }
+        }
+
+        *off = i;
+        return BIN_TYPE_UNKNOWN;
+}
+
+intptr_t bin_open(const char *fname)
+{
+        struct bin *bin;
+
+        bin = (struct bin *)malloc(sizeof(struct bin));
+        if(NULL == bin) {
+                RPT(RPT_ERR, "malloc failed");
+                return (intptr_t)NULL;
+        }
+
+        bin->is_eof = 0;
+        bin->type = BIN_TYPE_UNKNOWN;
+        bin->head = 0;
+        bin->tail = 0;
+        bin->addr = 0;
+
+        /* regular file: map it, packets are used in place */
+        if(NULL != fname && 0 != strcmp(fname, "-")) {
+                bin->buf = bin_map(fname, &(bin->size));
+                if(NULL != bin->buf) {
+                        bin->fd = NULL;
+                        bin->is_stdin = 0;
+                        bin->is_map = 1;
+                        bin->is_eof = 1; /* all data in buf[] already */
+                        bin->tail = bin->size;
+                        return (intptr_t)bin;
+                }
+                RPT(RPT_INF, "map \"%s\" failed, read it instead", fname);
+        }
+
+        bin->is_map = 0;
+        bin->size = BIN_BUF_SIZE;
+        bin->buf = (uint8_t *)malloc(bin->size);
+        if(NULL == bin->buf) {
+                RPT(RPT_ERR, "malloc failed");
+                goto bin_open_failed_with_obj;
+        }
+
+        if(NULL == fname || 0 == strcmp(fname, "-")) {
+#ifdef SYS_WINDOWS
+                _setmode(_fileno(stdin), _O_BINARY);
+#endif
+                bin->fd = stdin;
+                bin->is_stdin = 1;
+        }
+        else {
+                bin->fd = fopen(fname, "rb");
+                if(NULL == bin->fd) {
+                        RPT(RPT_ERR, "open \"%s\" failed", fname);
+                        goto bin_open_failed_with_buf;
+                }
+                bin->is_stdin = 0;
+        }
+        return (intptr_t)bin;
+
+bin_open_failed_with_buf:
+        free(bin->buf);
+bin_open_failed_with_obj:
+        free(bin);
+        return (intptr_t)NULL;
+}
+
+int bin_close(intptr_t id)
+{
+        struct bin *bin = (struct bin *)id;
+
+        if(NULL == bin) {
+                RPT(RPT_ERR, "bad id");
+                return -1;
+        }
+
+        if(bin->is_map) {
+                bin_unmap(bin->buf, bin->size);
+        }
+        else {
+                if(!(bin->is_stdin)) {
+                        fclose(bin->fd);
+                }
+                free(bin->buf);
+        }
+        free(bin);
+        return 0;
+}
+
+/* map whole file for sequential read, return NULL if failed */
+uint8_t *bin_map(const char *fname, size_t *size)
+{
+        uint8_t *map;
+
+#ifdef SYS_WINDOWS
+        HANDLE fh;
+        HANDLE mh;
+        LARGE_INTEGER fsize;
+
+        fh = CreateFile(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if(INVALID_HANDLE_VALUE == fh) {
+                RPT(RPT_INF, "open \"%s\" failed", fname);
+                return NULL;
+        }
+        if(!GetFileSizeEx(fh, &fsize) || 0 == fsize.QuadPart ||
+           (uint64_t)fsize.QuadPart > (uint64_t)SIZE_MAX) {
+                CloseHandle(fh);
+                return NULL;
+        }
+        mh = CreateFileMapping(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(fh);
+        if(NULL == mh) {
+                return NULL;
+        }
+        map = (uint8_t *)MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mh); /* the view keeps the mapping */
+        if(NULL == map) {
+                return NULL;
+        }
+        *size = (size_t)fsize.QuadPart;
+#else
+        int fd;
+        struct stat st;
+
+        fd = open(fname, O_RDONLY);
+        if(fd < 0) {
+                RPT(RPT_INF, "open \"%s\" failed", fname);
+                return NULL;
+        }
+        if(0 != fstat(fd, &st) || !S_ISREG(st.st_mode) || 0 == st.st_size ||
+           (uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+                close(fd); /* pipe, device, empty file, etc */
+                return NULL;
+        }
+        map = (uint8_t *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd); /* the mapping keeps the file */
+        if(MAP_FAILED == map) {
+                RPT(RPT_INF, "mmap failed: %s", strerror(errno));
+                return NULL;
+        }
+        *size = (size_t)st.st_size;
+
+        /* hints only, ignore the result */
+        madvise(map, *size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        madvise(map, *size, MADV_HUGEPAGE);
+#endif
+#endif
+        return map;
+}
+
+int bin_unmap(uint8_t *map, size_t size)
+{
+        if(NULL == map) {
+                RPT(RPT_ERR, "bad map");
+                return -1;
+        }
+
+#ifdef SYS_WINDOWS
+        UnmapViewOfFile(map);
+#else
+        munmap(map, size);
+#endif
+        return 0;
+}
+
+int bin_type(intptr_t id)
+{
+        struct bin *bin = (struct bin *)id;
+
+        if(NULL == bin) {
+                RPT(RPT_ERR, "bad id");
+                return BIN_TYPE_UNKNOWN;
+        }
+
+        return bin->type;
+}
+
+/* return 0 if got one packet, -1 if EOF or error */
+int bin_read(intptr_t id, struct bin_pkt *pkt)
+{
+        struct bin *bin = (struct bin *)id;
+        uint8_t *p;
+
+        if(NULL == bin) {
+                RPT(RPT_ERR, "bad id");
+                return -1;
+        }
+
+        while(1) {
+                if(BIN_TYPE_UNKNOWN == bin->type) {
+                        if(bin->tail - bin->head < SYNC_SPAN && 0 == fill(bin)) {
+                                continue;
+                        }
+                        if(0 != judge_type(bin)) {
+                                if(0 != fill(bin)) {
+                                        return -1; /* no more data */
+                                }
+                        }
+                        continue;
+                }
+
+                if(bin->tail - bin->head < (size_t)(bin->type)) {
+                        if(0 != fill(bin)) {
+                                if(bin->tail != bin->head) {
+                                        RPT(RPT_WRN, "drop %zd-byte at the end",
+                                            bin->tail - bin->head);
+                                }
+                                return -1;
+                        }
+                        continue;
+                }
+
+                p = bin->buf + bin->head;
+                if(0x47 != p[(BIN_TYPE_MTS == bin->type) ? 4 : 0]) {
+                        RPT(RPT_WRN, "lost sync at 0x%llX",
+                            (long long int)(bin->addr + bin->head));
+                        bin->type = BIN_TYPE_UNKNOWN;
+                        continue;
+                }
+                break;
+        }
+
+        pkt->ADDR = bin->addr + bin->head;
+        pkt->RS = NULL;
+        pkt->has_mts = 0;
+        switch(bin->type) {
+                case BIN_TYPE_MTS:
+                        pkt->MTS = mts_time(p);
+                        pkt->has_mts = 1;
+                        pkt->TS = p + 4;
+                        break;
+                case BIN_TYPE_TSRS:
+                        pkt->TS = p;
+                        pkt->RS = p + 188;
+                        break;
+                default: /* BIN_TYPE_TS */
+                        pkt->TS = p;
+                        break;
+        }
+        bin->head += bin->type;
+        return 0;
+}
+
+/* get max packets at most, which are continuous in buffer with stride bin_type()
+ * TS: point to TS data of the first packet
+ * ADDR[], MTS[]: address and MTS of each packet, NULL if not needed
+ * return: count of packets got, 0 means EOF */
+int bin_read_batch(intptr_t id, uint8_t **TS, int max, int64_t *ADDR, int64_t *MTS)
+{
+        struct bin *bin = (struct bin *)id;
+        struct bin_pkt pkt;
+        uint8_t *p;
+        int n;
+
+        if(max <= 0 || 0 != bin_read(id, &pkt)) {
+                return 0;
+        }
+
+        /* first packet, bin_read() has done sync and fill */
+        *TS = pkt.TS;
+        if(ADDR) {
+                ADDR[0] = pkt.ADDR;
+        }
+        if(MTS) {
+                MTS[0] = pkt.MTS;
+        }
+
+        /* following packets already in buffer */
+        for(n = 1; n < max; n++) {
+                if(bin->tail - bin->head < (size_t)(bin->type)) {
+                        break;
+                }
+                p = bin->buf + bin->head;
+                if(0x47 != p[(BIN_TYPE_MTS == bin->type) ? 4 : 0]) {
+                        break; /* bin_read() will resync */
+                }
+                if(ADDR) {
+                        ADDR[n] = bin->addr + bin->head;
+                }
+                if(MTS && BIN_TYPE_MTS == bin->type) {
+                        MTS[n] = mts_time(p);
+                }
+                bin->head += bin->type;
+        }
+        return n;
+}
+
+/* move the data left to buf[0], then read more data, return -1 if no more */
+static int fill(struct bin *bin)
+{
+        ssize_t cnt;
+
+        if(bin->is_map) {
+                return -1; /* never move the mapped data */
+        }
+
+        if(bin->head > 0) {
+                memmove(bin->buf, bin->buf + bin->head, bin->tail - bin->head);
+                bin->addr += bin->head;
+                bin->tail -= bin->head;
+                bin->head = 0;
+        }
+
+        if(bin->is_eof) {
+                return -1;
+        }
+
+        do {
+                cnt = read(fileno(bin->fd), bin->buf + bin->tail, bin->size - bin->tail);
+        } while(cnt < 0 && EINTR == errno);
+
+        if(cnt <= 0) {
+                if(cnt < 0) {
+                        RPT(RPT_ERR, "read failed: %s", strerror(errno));
+                }
+                bin->is_eof = 1;
+                return -1;
+        }
+        bin->tail += cnt;
+        return 0;
+}
+
+/* return 0 if got sync, -1 if need more data */
+static int judge_type(struct bin *bin)
+{
+        size_t off;
+        size_t len = bin->tail - bin->head;
+        uint8_t *p = bin->buf + bin->head;
+
+        RPT(RPT_INF, "judge type from 0x%llX", (long long int)(bin->addr + bin->head));
+        bin->type = bin_sync(p, len, &off);
+        if(BIN_TYPE_UNKNOWN == bin->type && bin->is_eof) {
+                /* too few data left to meet SYNC_TIME syncs, one sync-byte is OK */
+                for(off = 0; off + 188 <= len; off++) {
+                        if(0x47 == p[off]) {
+                                bin->type = BIN_TYPE_TS;
+                                break;
+                        }
+                }
+        }
+
+        if(off != 0) {
+                RPT(RPT_WRN, "pass %zd-byte from 0x%llX", off,
+                    (long long int)(bin->addr + bin->head));
+        }
+        bin->head += off;
+        RPT(RPT_INF, "packet size: %d", bin->type);
+        return (BIN_TYPE_UNKNOWN == bin->type) ? -1 : 0;
+}
+
+static int is_sync(const uint8_t *p, int size)
+{
+        int i;
+
+        for(i = 1; i < SYNC_TIME; i++) {
+                if(0x47 != p[i * size]) {
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+static int64_t mts_time(const uint8_t *p)
+{
+        return ((int64_t)(p[0] & 0x3F) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
@@ -0,0 +1,44 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: bin.h
+ * funx: binary TS packet input with sync detection
+ */
+
+#ifndef _BIN_H
+#define _BIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h> /* for uint?_t, etc */
+#include <stddef.h> /* for size_t, etc */
+
+#define BIN_TYPE_UNKNOWN                (0)
+#define BIN_TYPE_TS                     (188) /* 188-byte TS packet */
+#define BIN_TYPE_MTS                    (192) /* 4-byte timestamp + 188-byte TS packet */
+#define BIN_TYPE_TSRS                   (204) /* 188-byte TS packet + 16-byte RS code */
+
+struct bin_pkt {
+        uint8_t *TS; /* point to 188-byte TS data, valid until next bin_read() */
+        uint8_t *RS; /* point to 16-byte RS data, NULL if no RS */
+        int64_t ADDR; /* address of the first byte of this packet(unit: byte) */
+        int64_t MTS; /* arrival_time_stamp of MTS packet(unit: 27MHz clk) */
+        int has_mts;
+};
+
+int bin_sync(const uint8_t *buf, size_t len, size_t *off);
+
+intptr_t bin_open(const char *fname); /* NULL or "-" means stdin, regular file is mapped */
+int bin_close(intptr_t id);
+int bin_type(intptr_t id);
+int bin_read(intptr_t id, struct bin_pkt *pkt);
+int bin_read_batch(intptr_t id, uint8_t **TS, int max, int64_t *ADDR, int64_t *MTS);
+
+uint8_t *bin_map(const char *fname, size_t *size);
+int bin_unmap(uint8_t *map, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BIN_H */
@@ -8,8 +8,33 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "common.h"
 #include "if.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HEX_SIMD /* SSSE3 or AVX2 for hex convert, check CPU when running */
+#include <immintrin.h>
+#endif
+
+static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
+
+#ifdef HEX_SIMD
+#define HEX_C     (0) /* byte by byte */
+#define HEX_SSSE3 (1) /* 16-byte each time */
+#define HEX_AVX2  (2) /* 32-byte each time */
+#define B2T_SIMD_MIN (17) /* one 16-byte block and the last byte, see bench_hex.c */
+static int hex_isa = HEX_C; /* set by hex_init() */
+
+#define PAGE_SIZE_MIN (4096) /* load in one page of valid data can not fault */
+#define IS_IN_PAGE(p, size) ((((uintptr_t)(p)) & (PAGE_SIZE_MIN - 1)) <= PAGE_SIZE_MIN - (size))
+
+static void hex_init(void) __attribute__((constructor)); /* before main() and any thread */
+static int b2t_ssse3(char *dst, const uint8_t *src, int n);
+static int b2t_avx2(char *dst, const uint8_t *src, int n);
+static int t2b_ssse3(uint8_t *dst, const char *src, int n);
+static int t2b_avx2(uint8_t *dst, const char *src, int n);
+#endif
+
 /* for function to_byte() */
 #define NEOL (+1) /* normal end of line */
 #define UEOL (-1) /* unexpected end of line */
@@ -84,7 +109,22 @@ int b2t(char *DST, const uint8_t *SRC, int len)
         char *dst = DST;
         const uint8_t *src = SRC;
 
-        for(i = 0; i < len - 1; i++) {
+        i = 0;
+#ifdef HEX_SIMD
+        if(len < B2T_SIMD_MIN) {
+                /* no whole block, calling into the vector code only costs, b2t_table is faster */
+        }
+        else if(HEX_AVX2 == hex_isa) {
+                i = b2t_avx2(dst, src, len - 1); /* the last one is followed by ',' */
+        }
+        else if(HEX_SSSE3 == hex_isa) {
+                i = b2t_ssse3(dst, src, len - 1);
+        }
+        src += i;
+        dst += i * 3;
+#endif
+
+        for(; i < len - 1; i++) {
                 ch = b2t_table[*src++];
                 *dst++ = *ch++;
                 *dst++ = *ch;
@@ -145,12 +185,98 @@ int next_tag(char **tag, char **text)
         }
 }
 
+/* search the next tag and tell it by its first bytes, text points to ' ' after ',' then;
+ * tag in other form, e.g. with color, is cut by next_tag() and compared as string
+ * return: IF_TAG_xxx */
+int next_tag_id(char **text)
+{
+        char *p = *text;
+        char *tag;
+
+        while('*' != *p) {
+                if('\0' == *p || 0x0A == *p || 0x0D == *p) {
+                        return IF_TAG_EOL;
+                }
+                p++;
+        }
+
+        switch(p[1]) {
+                case 't':
+                        if('s' == p[2] && ',' == p[3]) {
+                                *text = p + 4;
+                                return IF_TAG_TS;
+                        }
+                        break;
+                case 'r':
+                        if('s' == p[2] && ',' == p[3]) {
+                                *text = p + 4;
+                                return IF_TAG_RS;
+                        }
+                        break;
+                case 'a':
+                        if('d' == p[2] && 'd' == p[3] && 'r' == p[4] && ',' == p[5]) {
+                                *text = p + 6;
+                                return IF_TAG_ADDR;
+                        }
+                        break;
+                case 'm':
+                        if('t' == p[2] && 's' == p[3] && ',' == p[4]) {
+                                *text = p + 5;
+                                return IF_TAG_MTS;
+                        }
+                        break;
+                case 'c':
+                        if('t' == p[2] && 's' == p[3] && ',' == p[4]) {
+                                *text = p + 5;
+                                return IF_TAG_CTS;
+                        }
+                        break;
+                default:
+                        break;
+        }
+
+        /* the slow way */
+        *text = p;
+        if(0 != next_tag(&tag, text)) {
+                return IF_TAG_EOL;
+        }
+        if(0 == strcmp(tag, "*ts")) {
+                return IF_TAG_TS;
+        }
+        if(0 == strcmp(tag, "*rs")) {
+                return IF_TAG_RS;
+        }
+        if(0 == strcmp(tag, "*addr")) {
+                return IF_TAG_ADDR;
+        }
+        if(0 == strcmp(tag, "*mts")) {
+                return IF_TAG_MTS;
+        }
+        if(0 == strcmp(tag, "*cts")) {
+                return IF_TAG_CTS;
+        }
+        RPT(RPT_ERR, "wrong tag: \"%s\"", tag);
+        return IF_TAG_BAD;
+}
+
 /* match " XX XX ... XX XX,?", stop at ? */
 int next_nbyte_hex(uint8_t *byte, char **text, int max)
 {
-        int cnt;
+        int cnt = 0;
 
-        for(cnt = 0; cnt < max; cnt++) {
+#ifdef HEX_SIMD
+        /* block with ',' or EOL is left to the byte by byte loop */
+        if(HEX_AVX2 == hex_isa) {
+                cnt = t2b_avx2(byte, *text, max);
+        }
+        else if(HEX_SSSE3 == hex_isa) {
+                cnt = t2b_ssse3(byte, *text, max);
+        }
+        byte += cnt;
+        (*text) += cnt * 3;
+#endif
+
+        for(; cnt < max; cnt++) {
                 uint8_t s, h, l;
 
                 /* white space */
@@ -185,6 +311,241 @@ int next_nbyte_hex(uint8_t *byte, char **text, int max)
         return cnt;
 }
 
+#ifdef HEX_SIMD
+static void hex_init(void)
+{
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) {
+                hex_isa = HEX_AVX2;
+        }
+        else if(__builtin_cpu_supports("ssse3")) {
+                hex_isa = HEX_SSSE3;
+        }
+        else {
+                hex_isa = HEX_C;
+        }
+        return;
+}
+
+/* "XX " of 16 byte is 48 char, in 3 vector:
+ *      HL_HL_HL_HL_HL_H, L_HL_HL_HL_HL_HL_, _HL_HL_HL_HL_HL_
+ * lo is the pair of byte 0~7, hi is the pair of byte 8~15, -1 means '_' */
+#define B2T_M0  0,  1, -1,  2,  3, -1,  4,  5, -1,  6,  7, -1,  8,  9, -1, 10
+#define B2T_M1L 11, -1, 12, 13, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1
+#define B2T_M1H -1, -1, -1, -1, -1, -1, -1, -1,  0,  1, -1,  2,  3, -1,  4,  5
+#define B2T_M2  -1,  6,  7, -1,  8,  9, -1, 10, 11, -1, 12, 13, -1, 14, 15, -1
+#define B2T_S0  0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0
+#define B2T_S1  0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0
+#define B2T_S2  ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' '
+
+/* 48 char to 16 byte: the reverse of B2T_Mx, hi and lo char of each byte from 3 vector */
+#define T2B_H0  1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+#define T2B_H1 -1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1
+#define T2B_H2 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14
+#define T2B_L0  2,  5,  8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+#define T2B_L1 -1, -1, -1, -1, -1,  1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1
+#define T2B_L2 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15
+#define T2B_S0  0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+#define T2B_S1 -1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14, -1, -1, -1, -1, -1
+#define T2B_S2 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  1,  4,  7, 10, 13
+
+/* n byte to "XX XX ... XX ", return byte converted, a multiple of 16 */
+__attribute__((target("ssse3")))
+static int b2t_ssse3(char *dst, const uint8_t *src, int n)
+{
+        const __m128i digit = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                            '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+        const __m128i mask = _mm_set1_epi8(0x0F);
+        const __m128i m0 = _mm_setr_epi8(B2T_M0);
+        const __m128i m1l = _mm_setr_epi8(B2T_M1L);
+        const __m128i m1h = _mm_setr_epi8(B2T_M1H);
+        const __m128i m2 = _mm_setr_epi8(B2T_M2);
+        const __m128i s0 = _mm_setr_epi8(B2T_S0);
+        const __m128i s1 = _mm_setr_epi8(B2T_S1);
+        const __m128i s2 = _mm_setr_epi8(B2T_S2);
+        int i;
+
+        for(i = 0; i + 16 <= n; i += 16, src += 16, dst += 48) {
+                __m128i x = _mm_loadu_si128((const __m128i *)src);
+                __m128i h = _mm_shuffle_epi8(digit, _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+                __m128i l = _mm_shuffle_epi8(digit, _mm_and_si128(x, mask));
+                __m128i lo = _mm_unpacklo_epi8(h, l);
+                __m128i hi = _mm_unpackhi_epi8(h, l);
+
+                _mm_storeu_si128((__m128i *)(dst +  0), _mm_or_si128(_mm_shuffle_epi8(lo, m0), s0));
+                _mm_storeu_si128((__m128i *)(dst + 16), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(lo, m1l),
+                                                                                  _mm_shuffle_epi8(hi, m1h)), s1));
+                _mm_storeu_si128((__m128i *)(dst + 32), _mm_or_si128(_mm_shuffle_epi8(hi, m2), s2));
+        }
+        return i;
+}
+
+/* the same as b2t_ssse3(), 2 block in 2 lane, return a multiple of 16 */
+__attribute__((target("avx2")))
+static int b2t_avx2(char *dst, const uint8_t *src, int n)
+{
+        const __m256i digit = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                               '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+                                               '0', '1', '2', '3', '4', '5', '6', '7',
+                                               '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+        const __m256i mask = _mm256_set1_epi8(0x0F);
+        const __m256i m0 = _mm256_setr_epi8(B2T_M0, B2T_M0);
+        const __m256i m1l = _mm256_setr_epi8(B2T_M1L, B2T_M1L);
+        const __m256i m1h = _mm256_setr_epi8(B2T_M1H, B2T_M1H);
+        const __m256i m2 = _mm256_setr_epi8(B2T_M2, B2T_M2);
+        const __m256i s0 = _mm256_setr_epi8(B2T_S0, B2T_S0);
+        const __m256i s1 = _mm256_setr_epi8(B2T_S1, B2T_S1);
+        const __m256i s2 = _mm256_setr_epi8(B2T_S2, B2T_S2);
+        int i;
+
+        for(i = 0; i + 32 <= n; i += 32, src += 32, dst += 96) {
+                __m256i x = _mm256_loadu_si256((const __m256i *)src);
+                __m256i h = _mm256_shuffle_epi8(digit, _mm256_and_si256(_mm256_srli_epi16(x, 4), mask));
+                __m256i l = _mm256_shuffle_epi8(digit, _mm256_and_si256(x, mask));
+                __m256i lo = _mm256_unpacklo_epi8(h, l); /* pair of byte 0~7 | 16~23 */
+                __m256i hi = _mm256_unpackhi_epi8(h, l); /* pair of byte 8~15 | 24~31 */
+                __m256i v0 = _mm256_or_si256(_mm256_shuffle_epi8(lo, m0), s0);
+                __m256i v1 = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(lo, m1l),
+                                                             _mm256_shuffle_epi8(hi, m1h)), s1);
+                __m256i v2 = _mm256_or_si256(_mm256_shuffle_epi8(hi, m2), s2);
+
+                _mm256_storeu_si256((__m256i *)(dst +  0), _mm256_permute2x128_si256(v0, v1, 0x20));
+                _mm256_storeu_si256((__m256i *)(dst + 32), _mm256_permute2x128_si256(v2, v0, 0x30));
+                _mm256_storeu_si256((__m256i *)(dst + 64), _mm256_permute2x128_si256(v1, v2, 0x31));
+        }
+
+        /* the left 16-byte block */
+        return i + b2t_ssse3(dst, src, n - i);
+}
+
+/* hex char to 4-bit, the same as t2b_table_h and t2b_table_l: not hex char is 0,
+ * char 0x80~0xFF is negative in signed compare, so it is not hex char */
+__attribute__((target("ssse3")))
+static inline __m128i t2b_nibble(__m128i c)
+{
+        __m128i a = _mm_or_si128(c, _mm_set1_epi8(0x20)); /* 'A' -> 'a' */
+        __m128i is_d = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                     _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), c));
+        __m128i is_a = _mm_and_si128(_mm_cmpgt_epi8(a, _mm_set1_epi8('a' - 1)),
+                                     _mm_cmpgt_epi8(_mm_set1_epi8('f' + 1), a));
+
+        return _mm_or_si128(_mm_and_si128(is_d, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+                            _mm_and_si128(is_a, _mm_sub_epi8(a, _mm_set1_epi8('a' - 10))));
+}
+
+/* not 0 if any char is '\0', LF or CR */
+__attribute__((target("ssse3")))
+static inline int t2b_has_eol(__m128i c)
+{
+        __m128i e = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_setzero_si128()),
+                                 _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(0x0A)),
+                                              _mm_cmpeq_epi8(c, _mm_set1_epi8(0x0D))));
+
+        return _mm_movemask_epi8(e);
+}
+
+/* " XX XX ... XX" to n byte at most, return byte converted, a multiple of 16,
+ * stop before the block with ',' in white space or EOL, so the byte by byte loop can deal with it */
+__attribute__((target("ssse3")))
+static int t2b_ssse3(uint8_t *dst, const char *src, int n)
+{
+        const __m128i h0 = _mm_setr_epi8(T2B_H0), h1 = _mm_setr_epi8(T2B_H1), h2 = _mm_setr_epi8(T2B_H2);
+        const __m128i l0 = _mm_setr_epi8(T2B_L0), l1 = _mm_setr_epi8(T2B_L1), l2 = _mm_setr_epi8(T2B_L2);
+        const __m128i s0 = _mm_setr_epi8(T2B_S0), s1 = _mm_setr_epi8(T2B_S1), s2 = _mm_setr_epi8(T2B_S2);
+        int i;
+
+        for(i = 0; i + 16 <= n && IS_IN_PAGE(src, 48); i += 16, src += 48, dst += 16) {
+                __m128i x0 = _mm_loadu_si128((const __m128i *)(src +  0));
+                __m128i x1 = _mm_loadu_si128((const __m128i *)(src + 16));
+                __m128i x2 = _mm_loadu_si128((const __m128i *)(src + 32));
+                __m128i s, h, l;
+
+                s = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(x0, s0), _mm_shuffle_epi8(x1, s1)),
+                                 _mm_shuffle_epi8(x2, s2));
+                if(t2b_has_eol(x0) | t2b_has_eol(x1) | t2b_has_eol(x2) |
+                   _mm_movemask_epi8(_mm_cmpeq_epi8(s, _mm_set1_epi8(',')))) {
+                        break;
+                }
+                h = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(x0, h0), _mm_shuffle_epi8(x1, h1)),
+                                 _mm_shuffle_epi8(x2, h2));
+                l = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(x0, l0), _mm_shuffle_epi8(x1, l1)),
+                                 _mm_shuffle_epi8(x2, l2));
+                _mm_storeu_si128((__m128i *)dst, _mm_or_si128(_mm_slli_epi16(t2b_nibble(h), 4), t2b_nibble(l)));
+        }
+        return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i t2b_nibble_avx2(__m256i c)
+{
+        __m256i a = _mm256_or_si256(c, _mm256_set1_epi8(0x20)); /* 'A' -> 'a' */
+        __m256i is_d = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)),
+                                        _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+        __m256i is_a = _mm256_and_si256(_mm256_cmpgt_epi8(a, _mm256_set1_epi8('a' - 1)),
+                                        _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), a));
+
+        return _mm256_or_si256(_mm256_and_si256(is_d, _mm256_sub_epi8(c, _mm256_set1_epi8('0'))),
+                               _mm256_and_si256(is_a, _mm256_sub_epi8(a, _mm256_set1_epi8('a' - 10))));
+}
+
+__attribute__((target("avx2")))
+static inline int t2b_has_eol_avx2(__m256i c)
+{
+        __m256i e = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_setzero_si256()),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(0x0A)),
+                                                    _mm256_cmpeq_epi8(c, _mm256_set1_epi8(0x0D))));
+
+        return _mm256_movemask_epi8(e);
+}
+
+/* load 16 char of block 0 in lane 0, and the same 16 char of block 1 in lane 1 */
+__attribute__((target("avx2")))
+static inline __m256i t2b_load2(const char *p)
+{
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+                                       _mm_loadu_si128((const __m128i *)(p + 48)), 1);
+}
+
+/* the same as t2b_ssse3(), 2 block in 2 lane, return a multiple of 16 */
+__attribute__((target("avx2")))
+static int t2b_avx2(uint8_t *dst, const char *src, int n)
+{
+        const __m256i h0 = _mm256_setr_epi8(T2B_H0, T2B_H0);
+        const __m256i h1 = _mm256_setr_epi8(T2B_H1, T2B_H1);
+        const __m256i h2 = _mm256_setr_epi8(T2B_H2, T2B_H2);
+        const __m256i l0 = _mm256_setr_epi8(T2B_L0, T2B_L0);
+        const __m256i l1 = _mm256_setr_epi8(T2B_L1, T2B_L1);
+        const __m256i l2 = _mm256_setr_epi8(T2B_L2, T2B_L2);
+        const __m256i s0 = _mm256_setr_epi8(T2B_S0, T2B_S0);
+        const __m256i s1 = _mm256_setr_epi8(T2B_S1, T2B_S1);
+        const __m256i s2 = _mm256_setr_epi8(T2B_S2, T2B_S2);
+        int i;
+
+        for(i = 0; i + 32 <= n && IS_IN_PAGE(src, 96); i += 32, src += 96, dst += 32) {
+                __m256i x0 = t2b_load2(src +  0);
+                __m256i x1 = t2b_load2(src + 16);
+                __m256i x2 = t2b_load2(src + 32);
+                __m256i s, h, l;
+
+                s = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(x0, s0), _mm256_shuffle_epi8(x1, s1)),
+                                    _mm256_shuffle_epi8(x2, s2));
+                if(t2b_has_eol_avx2(x0) | t2b_has_eol_avx2(x1) | t2b_has_eol_avx2(x2) |
+                   _mm256_movemask_epi8(_mm256_cmpeq_epi8(s, _mm256_set1_epi8(',')))) {
+                        break;
+                }
+                h = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(x0, h0), _mm256_shuffle_epi8(x1, h1)),
+                                    _mm256_shuffle_epi8(x2, h2));
+                l = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(x0, l0), _mm256_shuffle_epi8(x1, l1)),
+                                    _mm256_shuffle_epi8(x2, l2));
+                _mm256_storeu_si256((__m256i *)dst, _mm256_or_si256(_mm256_slli_epi16(t2b_nibble_avx2(h), 4),
+                                                                   t2b_nibble_avx2(l)));
+        }
+
+        /* the left 16-byte block */
+        return i + t2b_ssse3(dst, src, n - i);
+}
+#endif
+
 /* match " XX...XX,?", stop at ? */
 int next_nuint_hex(long long int *sint, char **text, int max)
 {
@@ -231,3 +592,42 @@ int next_nuint_hex(long long int *sint, char **text, int max)
 
         return cnt;
 }
+
+/* clear frame, then set magic and version */
+void frame_init(struct if_frame *frm)
+{
+        memset(frm, 0, sizeof(struct if_frame));
+        frm->magic[0] = 'Z';
+        frm->magic[1] = 'F';
+        frm->version = IF_FRAME_VERSION;
+        return;
+}
+
+/* return 0 if got one frame, -1 if EOF or bad frame */
+int frame_read(struct if_frame *frm, FILE *fd)
+{
+        if(1 != fread(frm, sizeof(struct if_frame), 1, fd)) {
+                return -1;
+        }
+
+        if('Z' != frm->magic[0] || 'F' != frm->magic[1]) {
+                RPT(RPT_ERR, "bad frame magic(%02X %02X), not binary frame?",
+                    frm->magic[0], frm->magic[1]);
+                return -1;
+        }
+        if(IF_FRAME_VERSION != frm->version) {
+                RPT(RPT_ERR, "unsupported frame version(%d), %d wanted",
+                    frm->version, IF_FRAME_VERSION);
+                return -1;
+        }
+        return 0;
+}
+
+int frame_write(const struct if_frame *frm, FILE *fd)
+{
+        if(1 != fwrite(frm, sizeof(struct if_frame), 1, fd)) {
+                RPT(RPT_ERR, "write frame failed");
+                return -1;
+        }
+        return 0;
+}
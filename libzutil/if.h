@@ -10,13 +10,50 @@
 extern "C" {
 #endif
 
+#include <stdio.h> /* for FILE, etc */
 #include <stdint.h> /* for uintN_t, etc */
 
+/* binary frame, carry the same fields as struct ts_ipt */
+#define IF_FRAME_VERSION                (1)
+
+#define IF_HAS_TS                       (1 << 0)
+#define IF_HAS_RS                       (1 << 1)
+#define IF_HAS_ADDR                     (1 << 2)
+#define IF_HAS_MTS                      (1 << 3)
+#define IF_HAS_CTS                      (1 << 4)
+
+/* tag in text line, see next_tag_id() */
+#define IF_TAG_EOL                      (0) /* no more tag */
+#define IF_TAG_TS                       (1)
+#define IF_TAG_RS                       (2)
+#define IF_TAG_ADDR                     (3)
+#define IF_TAG_MTS                      (4)
+#define IF_TAG_CTS                      (5)
+#define IF_TAG_BAD                      (6) /* unknown tag */
+
+/* fixed layout, 232-byte, no padding;
+ * int64_t fields are in host byte order, for pipe between tools in one host */
+struct if_frame {
+        uint8_t magic[2]; /* 'Z', 'F' */
+        uint8_t version; /* IF_FRAME_VERSION */
+        uint8_t flags; /* IF_HAS_xxx */
+        uint8_t TS[188]; /* TS data */
+        uint8_t RS[16]; /* RS data */
+        int64_t ADDR; /* address of sync-byte(unit: byte) */
+        int64_t MTS; /* MTS Time Stamp */
+        int64_t CTS; /* CTS Time Stamp */
+};
+
 int b2t(char *DST, const uint8_t *PTR, int len);
 int next_tag(char **tag, char **text);
+int next_tag_id(char **text);
 int next_nbyte_hex(uint8_t *byte, char **text, int max);
 int next_nuint_hex(long long int *sint, char **text, int max);
 
+void frame_init(struct if_frame *frm);
+int frame_read(struct if_frame *frm, FILE *fd);
+int frame_write(const struct if_frame *frm, FILE *fd);
+
 #ifdef __cplusplus
 }
 #endif
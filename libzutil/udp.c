@@ -3,12 +3,16 @@
  * funx: UDP access
  */
 
+#include "config.h" /* for SYS_* macro, generated by configure */
+
+#ifdef SYS_LINUX
+#       define _GNU_SOURCE /* for recvmmsg(), sendmmsg(), must before any #include <...> */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include "config.h" /* for SYS_* macro, generated by configure */
-
 #ifdef SYS_WINDOWS
 #       define WIN32_LEAN_AND_MEAN
 #       include <winsock2.h>
@@ -23,7 +27,15 @@ typedef int socklen_t;
 #       include <fcntl.h> /* for fcntl(), O_NONBLOCK, etc */
 #       include <sys/select.h> /* for select(), etc */
 #       include <errno.h>
+#       ifndef __USE_GNU
 #       define __USE_GNU /* for 'struct ip_mreq' in CentOS x64 */
+#       endif
+#endif
+
+#ifdef SYS_LINUX
+#       include <sys/uio.h> /* for struct iovec */
+#       include <time.h> /* for struct timespec */
+#       include <linux/net_tstamp.h> /* for SOF_TIMESTAMPING_* */
 #endif
 
 #include "common.h"
@@ -31,7 +43,8 @@ typedef int socklen_t;
 
 static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
 
-#define UDP_LENGTH_MAX (1536)
+#define UDP_BATCH (32) /* datagram for each recvmmsg() */
+#define UDP_CTL_SIZE (128) /* for SCM_TIMESTAMPING or SCM_TIMESTAMPNS */
 
 struct udp {
         int sock;
@@ -40,8 +53,23 @@ struct udp {
 
         char addr[32];
         char src_addr[32]; /* for IGMP v3 */
+        int is_timestamp; /* UDP_TS_xxx, receive time of datagram is enabled */
+
+        /* datagram ring, filled by recvmmsg() in one syscall */
+        uint8_t buf[UDP_BATCH][UDP_LENGTH_MAX];
+        int len[UDP_BATCH];
+        int64_t ns[UDP_BATCH]; /* receive time, -1 if unknown */
+        int cnt; /* datagram in ring */
+        int idx; /* next datagram to get */
+#ifdef SYS_LINUX
+        struct mmsghdr msg[UDP_BATCH];
+        struct iovec iov[UDP_BATCH];
+        char ctl[UDP_BATCH][UDP_CTL_SIZE];
+#endif
 };
 
+static int fill(struct udp *udp);
+static int wait_write(struct udp *udp);
 static int report(const char *str);
 
 intptr_t udp_open(char *src_addr, char *addr, unsigned short port, char *mode)
@@ -55,6 +83,9 @@ intptr_t udp_open(char *src_addr, char *addr, unsigned short port, char *mode)
         }
 
         strcpy(udp->addr, addr);
+        udp->is_timestamp = 0;
+        udp->cnt = 0;
+        udp->idx = 0;
 
         udp->src_addr[0] = '\0';
         if(src_addr) {
@@ -202,6 +233,19 @@ int udp_close(intptr_t id)
 }
 
 size_t udp_read(intptr_t id, void *buf)
+{
+        uint8_t *p;
+        int rslt;
+
+        rslt = udp_get(id, &p, NULL, 1);
+        if(rslt <= 0) {
+                return 0;
+        }
+        memcpy(buf, p, rslt);
+        return rslt;
+}
+
+int udp_fd(intptr_t id)
 {
         struct udp *udp = (struct udp *)id;
 
@@ -210,23 +254,133 @@ size_t udp_read(intptr_t id, void *buf)
                 return -1;
         }
 
-        size_t rslt = 0;
-        fd_set fds;
+        return udp->sock;
+}
 
-        FD_ZERO(&fds);
-        FD_SET(udp->sock, &fds);
-        if(select(udp->sock + 1, &fds, NULL, NULL, NULL) < 0) {
-                report("select failed");
-                return 0;
+int udp_recv(intptr_t id, void *buf)
+{
+        uint8_t *p;
+        int rslt;
+
+        rslt = udp_get(id, &p, NULL, 0);
+        if(rslt <= 0) {
+                return rslt;
+        }
+        memcpy(buf, p, rslt);
+        return rslt;
+}
+
+int udp_get(intptr_t id, uint8_t **buf, int64_t *ns, int is_wait)
+{
+        struct udp *udp = (struct udp *)id;
+        int rslt;
+
+        if(NULL == udp) {
+                RPT(RPT_ERR, "bad id");
+                return -1;
         }
 
-        if(FD_ISSET(udp->sock, &fds)) {
-                rslt = recvfrom(udp->sock, buf, UDP_LENGTH_MAX, 0,
-                                (struct sockaddr *)&(udp->remote),
-                                &(udp->socklen));
+        while(udp->idx >= udp->cnt) {
+                rslt = fill(udp);
+                if(rslt < 0) {
+                        return -1;
+                }
+                if(rslt > 0) {
+                        break;
+                }
+                if(!is_wait) {
+                        return 0;
+                }
+
+                /* wait for data */
+                fd_set fds;
+
+                FD_ZERO(&fds);
+                FD_SET(udp->sock, &fds);
+                if(select(udp->sock + 1, &fds, NULL, NULL, NULL) < 0) {
+                        report("select failed");
+                        return 0;
+                }
         }
 
-        return rslt;
+        *buf = udp->buf[udp->idx];
+        if(ns) {
+                *ns = udp->ns[udp->idx];
+        }
+        return udp->len[udp->idx++];
+}
+
+int udp_ioctl(intptr_t id, int cmd, intptr_t arg)
+{
+        struct udp *udp = (struct udp *)id;
+
+        if(NULL == udp) {
+                RPT(RPT_ERR, "bad id");
+                return -1;
+        }
+
+        switch(cmd)
+        {
+                case UDP_RCVBUF:
+                        {
+                                int size = (int)arg;
+                                socklen_t len = sizeof(int);
+
+                                if(setsockopt(udp->sock, SOL_SOCKET, SO_RCVBUF,
+                                              (char *)&size, sizeof(int)) != 0) {
+                                        report("SO_RCVBUF failed");
+                                        return -1;
+                                }
+                                getsockopt(udp->sock, SOL_SOCKET, SO_RCVBUF, (char *)&size, &len);
+                                RPT(RPT_INF, "SO_RCVBUF: %d", size); /* maybe limited by rmem_max */
+                        }
+                        break;
+                case UDP_TIMESTAMP:
+#ifdef SYS_LINUX
+                        {
+                                int flags = 0;
+                                int enable = 0;
+
+                                if(UDP_TS_HW == arg) {
+                                        /* NIC should be set by SIOCSHWTSTAMP, e.g. "hwstamp_ctl -i eth0 -r 1" */
+                                        flags |= SOF_TIMESTAMPING_RX_HARDWARE;
+                                        flags |= SOF_TIMESTAMPING_RAW_HARDWARE;
+                                }
+                                if(UDP_TS_OFF != arg) {
+                                        /* software time as well, if hardware time is not available */
+                                        flags |= SOF_TIMESTAMPING_RX_SOFTWARE;
+                                        flags |= SOF_TIMESTAMPING_SOFTWARE;
+                                }
+
+                                if(setsockopt(udp->sock, SOL_SOCKET, SO_TIMESTAMPING,
+                                              (char *)&flags, sizeof(int)) == 0) {
+                                        udp->is_timestamp = (int)arg;
+                                        break;
+                                }
+                                if(UDP_TS_HW == arg) {
+                                        report("SO_TIMESTAMPING failed");
+                                        return -1;
+                                }
+
+                                /* old kernel, try SO_TIMESTAMPNS */
+                                enable = (UDP_TS_OFF != arg);
+                                if(setsockopt(udp->sock, SOL_SOCKET, SO_TIMESTAMPNS,
+                                              (char *)&enable, sizeof(int)) != 0) {
+                                        report("SO_TIMESTAMPNS failed");
+                                        return -1;
+                                }
+                                udp->is_timestamp = (int)arg;
+                        }
+#else
+                        RPT(RPT_WRN, "receive time of datagram is not supported in this system");
+                        return -1;
+#endif
+                        break;
+                default:
+                        RPT(RPT_ERR, "bad cmd");
+                        return -1;
+        }
+        return 0;
 }
 
 size_t udp_write(intptr_t id, const void *buf, int len)
@@ -246,6 +400,178 @@ size_t udp_write(intptr_t id, const void *buf, int len)
         return rslt;
 }
 
+int udp_send(intptr_t id, uint8_t *buf[], const int len[], int cnt)
+{
+        struct udp *udp = (struct udp *)id;
+        int done = 0;
+        int n;
+
+        if(NULL == udp) {
+                RPT(RPT_ERR, "bad id");
+                return -1;
+        }
+
+        while(done < cnt) {
+#ifdef SYS_LINUX
+                struct mmsghdr msg[UDP_BATCH];
+                struct iovec iov[UDP_BATCH];
+                int i;
+
+                n = cnt - done;
+                n = (n > UDP_BATCH) ? UDP_BATCH : n;
+                for(i = 0; i < n; i++) {
+                        struct msghdr *hdr = &(msg[i].msg_hdr);
+
+                        iov[i].iov_base = buf[done + i];
+                        iov[i].iov_len = len[done + i];
+                        hdr->msg_name = &(udp->remote);
+                        hdr->msg_namelen = udp->socklen;
+                        hdr->msg_iov = &(iov[i]);
+                        hdr->msg_iovlen = 1;
+                        hdr->msg_control = NULL;
+                        hdr->msg_controllen = 0;
+                        hdr->msg_flags = 0;
+                }
+                n = sendmmsg(udp->sock, msg, n, 0);
+#else
+                /* one datagram each time */
+                n = sendto(udp->sock, (const char *)(buf[done]), len[done], 0,
+                           (struct sockaddr *)&(udp->remote),
+                           udp->socklen);
+                n = (n < 0) ? n : 1;
+#endif
+                if(n < 0) {
+                        if(0 == wait_write(udp)) {
+                                continue; /* socket buffer is full, try again */
+                        }
+                        report("send failed");
+                        return (done) ? done : -1;
+                }
+                done += n;
+        }
+        return done;
+}
+
+/* get datagrams into ring without wait
+ * return: count of datagram, 0 if no data, -1 if failed */
+static int fill(struct udp *udp)
+{
+        int n;
+#ifdef SYS_LINUX
+        int i;
+#endif
+
+        udp->cnt = 0;
+        udp->idx = 0;
+
+#ifdef SYS_LINUX
+        for(i = 0; i < UDP_BATCH; i++) {
+                struct msghdr *hdr = &(udp->msg[i].msg_hdr);
+
+                udp->iov[i].iov_base = udp->buf[i];
+                udp->iov[i].iov_len = UDP_LENGTH_MAX;
+                hdr->msg_name = NULL;
+                hdr->msg_namelen = 0;
+                hdr->msg_iov = &(udp->iov[i]);
+                hdr->msg_iovlen = 1;
+                hdr->msg_control = (udp->is_timestamp ? udp->ctl[i] : NULL);
+                hdr->msg_controllen = (udp->is_timestamp ? UDP_CTL_SIZE : 0);
+                hdr->msg_flags = 0;
+        }
+
+        n = recvmmsg(udp->sock, udp->msg, UDP_BATCH, MSG_DONTWAIT, NULL);
+        if(n < 0) {
+                if(EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+                        return 0;
+                }
+                report("recvmmsg failed");
+                return -1;
+        }
+
+        for(i = 0; i < n; i++) {
+                struct msghdr *hdr = &(udp->msg[i].msg_hdr);
+                struct cmsghdr *cmsg;
+
+                udp->len[i] = udp->msg[i].msg_len;
+                udp->ns[i] = -1;
+                if(!(udp->is_timestamp)) {
+                        continue;
+                }
+                for(cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+                        struct timespec tp[3]; /* software, legacy, hardware */
+
+                        if(SOL_SOCKET != cmsg->cmsg_level) {
+                                continue;
+                        }
+                        if(SCM_TIMESTAMPING == cmsg->cmsg_type) {
+                                memcpy(tp, CMSG_DATA(cmsg), sizeof(tp));
+                                if(UDP_TS_HW == udp->is_timestamp &&
+                                   (tp[2].tv_sec || tp[2].tv_nsec)) {
+                                        tp[0] = tp[2];
+                                }
+                                if(tp[0].tv_sec || tp[0].tv_nsec) {
+                                        udp->ns[i] = (int64_t)(tp[0].tv_sec) * 1000000000 + tp[0].tv_nsec;
+                                }
+                        }
+                        else if(SCM_TIMESTAMPNS == cmsg->cmsg_type) {
+                                memcpy(tp, CMSG_DATA(cmsg), sizeof(struct timespec));
+                                udp->ns[i] = (int64_t)(tp[0].tv_sec) * 1000000000 + tp[0].tv_nsec;
+                        }
+                }
+        }
+#else
+        /* one datagram each time */
+        n = recvfrom(udp->sock, (char *)(udp->buf[0]), UDP_LENGTH_MAX, 0,
+                     (struct sockaddr *)&(udp->remote),
+                     &(udp->socklen));
+        if(n < 0) {
+#ifdef SYS_WINDOWS
+                if(WSAEWOULDBLOCK == WSAGetLastError()) {
+                        return 0;
+                }
+#else
+                if(EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+                        return 0;
+                }
+#endif
+                report("recvfrom failed");
+                return -1;
+        }
+        udp->len[0] = n;
+        udp->ns[0] = -1;
+        n = 1;
+#endif
+
+        udp->cnt = n;
+        return n;
+}
+
+/* return: 0 if socket can be written now, -1 if it is not a "buffer is full" error */
+static int wait_write(struct udp *udp)
+{
+        fd_set fds;
+
+#ifdef SYS_WINDOWS
+        if(WSAEWOULDBLOCK != WSAGetLastError()) {
+                return -1;
+        }
+#else
+        if(EINTR == errno) {
+                return 0;
+        }
+        if(EAGAIN != errno && EWOULDBLOCK != errno && ENOBUFS != errno) {
+                return -1;
+        }
+#endif
+
+        FD_ZERO(&fds);
+        FD_SET(udp->sock, &fds);
+        if(select(udp->sock + 1, NULL, &fds, NULL, NULL) < 0) {
+                return -1;
+        }
+        return 0;
+}
+
 static int report(const char *str)
 {
         int err;
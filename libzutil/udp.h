@@ -12,11 +12,37 @@ extern "C" {
 
 #include <stdint.h> /* for uint?_t, etc */
 
+#define UDP_LENGTH_MAX (1536) /* size of buf for udp_read() and udp_recv() */
+
+/* cmd of udp_ioctl() */
+#define UDP_RCVBUF      (0) /* arg: receive buffer size of socket(byte) */
+#define UDP_TIMESTAMP   (1) /* arg: UDP_TS_xxx, receive time of each datagram, linux only */
+
+/* arg of UDP_TIMESTAMP */
+#define UDP_TS_OFF      (0)
+#define UDP_TS_SW       (1) /* software time of kernel */
+#define UDP_TS_HW       (2) /* hardware time of NIC, use software time if NIC can not */
+
 intptr_t udp_open(char *src_addr, char *addr, unsigned short port, char *mode);
 int udp_close(intptr_t id);
 size_t udp_read(intptr_t id, void *buf);
+int udp_fd(intptr_t id); /* socket, for select(), epoll_wait(), etc */
+int udp_recv(intptr_t id, void *buf); /* do not wait, return 0 if no data, -1 if failed */
+int udp_ioctl(intptr_t id, int cmd, intptr_t arg);
+
+/* get next datagram without copy, datagrams are received in batch
+ *      buf: point to the datagram, valid until next udp_get(), udp_read() or udp_recv()
+ *      ns: receive time(unit: ns), -1 if unknown, NULL if not needed
+ *      is_wait: 0 means return 0 if no data
+ * return: size of the datagram, 0 if no data, -1 if failed */
+int udp_get(intptr_t id, uint8_t **buf, int64_t *ns, int is_wait);
 size_t udp_write(intptr_t id, const void *buf, int len);
 
+/* send cnt datagrams in batch, wait if socket buffer is full
+ *      buf[i], len[i]: data and size of datagram i
+ * return: count of datagram sent, -1 if failed */
+int udp_send(intptr_t id, uint8_t *buf[], const int len[], int cnt);
+
 #ifdef __cplusplus
 }
 #endif
@@ -32,6 +32,7 @@ struct url *url_open(const char *str, char *mode)
         url->port = 0;
         url->disk = NULL;
         url->path_fname = NULL;
+        url->ns = -1;
 
         if(0 != parse_url(url, str)) {
                 free(url);
@@ -40,7 +41,7 @@ struct url *url_open(const char *str, char *mode)
 
         switch(url->scheme) {
                 case SCH_UDP:
-                        url->pbuf = url->buf;
+                        url->pbuf = NULL;
                         url->ts_cnt = 0;
                         url->udp = udp_open(url->user, url->host, url->port, mode);
                         if(0 == url->udp) {
@@ -137,13 +138,12 @@ size_t url_read(void *buf, size_t size, size_t nobj, struct url *url)
         switch(url->scheme) {
                 case SCH_UDP:
                         if(url->ts_cnt == 0) {
-                                size_t rslt;
+                                int rslt;
 
-                                rslt = udp_read(url->udp, url->buf);
-                                RPT(RPT_INF, "read %zd-byte", rslt);
+                                rslt = udp_get(url->udp, &(url->pbuf), &(url->ns), 1);
+                                RPT(RPT_INF, "read %d-byte", rslt);
                                 if(rslt > 0) {
                                         url->ts_cnt += rslt;
-                                        url->pbuf = url->buf;
                                 }
                         }
                         if(url->ts_cnt >= byte_needed) {
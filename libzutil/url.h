@@ -40,9 +40,9 @@ struct url {
         intptr_t udp;
 
         /* data buffer */
-        char buf[8*188]; /* for UDP data */
-        char *pbuf;
+        uint8_t *pbuf; /* point to UDP data in ring of udp_get() */
         size_t ts_cnt;
+        int64_t ns; /* receive time of the UDP data(unit: ns), -1 if unknown */
 };
 
 struct url *url_open(const char *str, char *mode);
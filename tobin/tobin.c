@@ -15,6 +15,7 @@ static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
 
 static FILE *fd_o = NULL;
 static char file_o[FILENAME_MAX] = "";
+static int is_frame = 0; /* input binary frame, instead of text */
 
 static int deal_with_parameter(int argc, char *argv[]);
 static void show_help();
@@ -38,6 +39,21 @@ int main(int argc, char *argv[])
                 return -1;
         }
 
+        if(is_frame) {
+                struct if_frame frm;
+
+                while(0 == frame_read(&frm, stdin)) {
+                        if(frm.flags & IF_HAS_TS) {
+                                fwrite(frm.TS, 188, 1, fd_o);
+                        }
+                        if(frm.flags & IF_HAS_RS) {
+                                fwrite(frm.RS, 16, 1, fd_o);
+                        }
+                }
+                fclose(fd_o);
+                return 0;
+        }
+
         while(NULL != fgets(tbuf, LINE_LENGTH_MAX, stdin)) {
                 pt = tbuf;
                 while(0 == next_tag(&tag, &pt)) {
@@ -80,6 +96,10 @@ static int deal_with_parameter(int argc, char *argv[])
                                 show_version();
                                 return -1;
                         }
+                        else if(0 == strcmp(argv[i], "-f") ||
+                                0 == strcmp(argv[i], "--frame")) {
+                                is_frame = 1;
+                        }
                         else {
                                 RPT(RPT_ERR, "wrong parameter: %s", argv[i]);
                                 return -1;
@@ -101,6 +121,7 @@ static void show_help()
         puts("");
         puts("Options:");
         puts("");
+        puts(" -f, --frame      read binary frame instead of text");
         puts(" -h, --help       print this information only");
         puts(" -v, --version    print my version only");
         puts("");
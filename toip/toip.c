@@ -0,0 +1,882 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: toip.c
+ * funx: send UDP packet with text data in stdin or binary TS file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* for strcmp, etc */
+#include <inttypes.h> /* for PRId64, etc */
+#include <time.h> /* for clock_gettime(), clock_nanosleep(), etc */
+#include <signal.h> /* for signal() */
+
+#include "config.h" /* for SYS_* macro, generated by configure */
+
+#ifdef SYS_WINDOWS
+#       include <winsock.h> /* for select(), etc */
+#else /* unix-like PLATFORM */
+#       include <sys/select.h> /* for select(), etc */
+#endif
+
+#include "tstool_config.h"
+#include "common.h"
+#include "if.h"
+#include "bin.h"
+#include "url.h"
+#include "buddy.h"
+#include "ts.h"
+
+static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
+
+#define MP_ORDER        (20) /* memory pool arena size for -pcr: (1 << MP_ORDER) */
+#define NPKT_MAX        (7) /* TS packet in each datagram: 7 * 188 + 28 < 1500(MTU) */
+#define BATCH_MAX       (32) /* datagram for each udp_send() */
+#define JUMP_MAX        (100 * MTS_MS) /* time delta out of (-JUMP_MAX, JUMP_MAX) is a jump */
+#define LATE_MAX        (100 * 1000000LL) /* ns, send later than this restarts the schedule */
+#define NS_1S           (1000000000LL)
+
+enum {
+        GOT_RIGHT_PKT,
+        GOT_WRONG_PKT,
+        GOT_EOF
+};
+
+/* for -loop: time stamp and CC of each pass follow the last pass */
+struct toip_loop {
+        int pass; /* 0 for the first pass */
+        int64_t pkt_cnt; /* packet in the first pass */
+        int has_pcr0; /* PCR0 is OK */
+        uint16_t PCR_PID; /* PID of the first PCR */
+        int64_t PCR0; /* the first PCR of PCR_PID */
+        int64_t PCR1; /* the last PCR of PCR_PID */
+        int64_t idx0; /* packet index of PCR0 */
+        int64_t idx1; /* packet index of PCR1 */
+        int64_t dur; /* time of one pass, unit: 27MHz */
+        int64_t ofs; /* add to PCR of this pass, unit: 27MHz, PTS and DTS get (ofs / 300) */
+
+        uint8_t CC[0x2000]; /* last CC sent, 0x10 means unknown */
+        uint8_t CC_ofs[0x2000]; /* add to CC of this pass */
+        int CC_pass[0x2000]; /* pass of CC_ofs */
+};
+
+/* statistic from the last report */
+struct toip_stat {
+        int64_t byte;
+        int64_t due; /* aim time of the last datagram, unit: ns */
+        int64_t sent; /* real time of the last udp_send(), unit: ns */
+        int64_t late_sum; /* ns */
+        int64_t late_max; /* ns */
+        int64_t send_cnt; /* udp_send() count */
+        int64_t resync;
+};
+
+struct toip_obj {
+        char file_o[FILENAME_MAX];
+        struct url *url;
+        int is_pcr; /* schedule according to PCR instead of MTS */
+        int npkt; /* TS packet in each datagram */
+        int batch; /* max datagram for each udp_send() */
+        int64_t burst; /* ns, datagrams due in burst are sent together */
+        int64_t spin; /* ns, busy wait before due time */
+        int is_stat; /* report each second */
+
+        /* binary TS input, PCR is used always */
+        int is_bin;
+        char *file_i; /* NULL means stdin */
+        intptr_t bin;
+        int is_loop;
+        struct toip_loop *loop;
+
+        /* for -pcr: CTS of each packet is interpolated by PCRa and PCRb in libzts */
+        intptr_t mp;
+        struct ts_obj *ts;
+
+        /* schedule */
+        int has_lT; /* lT is OK */
+        int64_t lT; /* last MTS or CTS */
+        int64_t clk; /* stream time since the first packet, unit: 27MHz */
+        int64_t t0; /* real time of clk 0, unit: ns */
+
+        /* datagram queue, dgram[cnt] is filling */
+        int cnt;
+        uint8_t dgram[BATCH_MAX][TS_PKT_SIZE * NPKT_MAX];
+        uint8_t *buf[BATCH_MAX]; /* for udp_send() */
+        int len[BATCH_MAX];
+        int64_t due[BATCH_MAX]; /* aim time, unit: ns */
+
+        int has_stat; /* stat is started by the first datagram */
+        struct toip_stat stat; /* this second */
+        struct toip_stat total; /* from the beginning */
+        int64_t stat_due0; /* for total */
+        int64_t stat_sent0; /* for total */
+};
+
+static volatile int is_exit = 0;
+
+static struct toip_obj *create(int argc, char *argv[]);
+static int destroy(struct toip_obj *obj);
+static int get_txt_pkt(struct toip_obj *obj, uint8_t *TS, int64_t *MTS, int *has_mts);
+static int get_bin_pkt(struct toip_obj *obj, uint8_t *TS);
+static int next_pass(struct toip_obj *obj);
+static void fix_pkt(struct toip_loop *loop, struct ts_obj *ts, uint8_t *TS);
+static int has_pes_opt(uint8_t stream_id);
+static int64_t get_pcr(const uint8_t *p);
+static void set_pcr(uint8_t *p, int64_t PCR);
+static int64_t get_pts(const uint8_t *p);
+static void set_pts(uint8_t *p, int64_t PTS);
+static int put_pkt(struct toip_obj *obj, int64_t T, int64_t ovf);
+static int flush(struct toip_obj *obj, int n);
+static void wait_until(struct toip_obj *obj, int64_t due);
+static void report(struct toip_stat *stat, int64_t due0, int64_t sent0, const char *hint);
+static int64_t now_ns(void);
+static void on_signal(int sig);
+
+static void show_help();
+static void show_version();
+
+int main(int argc, char *argv[])
+{
+        struct toip_obj *obj;
+        int rslt = 0;
+
+        obj = create(argc, argv);
+        if(!obj) {
+                return -1;
+        }
+        signal(SIGINT, on_signal);
+        signal(SIGTERM, on_signal);
+
+        while(!is_exit) {
+                uint8_t *pb = obj->dgram[obj->cnt] + obj->len[obj->cnt];
+                int64_t MTS = 0LL;
+                int has_mts = 0;
+                int got;
+
+                got = (obj->is_bin) ? get_bin_pkt(obj, pb) : get_txt_pkt(obj, pb, &MTS, &has_mts);
+                if(GOT_EOF == got) {
+                        break;
+                }
+                if(GOT_WRONG_PKT == got) {
+                        continue;
+                }
+
+                if(obj->is_pcr) {
+                        struct ts_prog *prog0;
+
+                        if(obj->is_loop) {
+                                fix_pkt(obj->loop, obj->ts, pb);
+                        }
+                        ts_parse_batch(obj->ts, pb, 1, TS_PKT_SIZE, NULL, NULL, NULL, NULL);
+                        prog0 = obj->ts->prog0;
+                        if(prog0 && prog0->is_STC_sync) {
+                                rslt = put_pkt(obj, obj->ts->CTS, STC_OVF);
+                        }
+                        else {
+                                rslt = put_pkt(obj, 0, 0); /* before the 2nd PCR, send it at once */
+                        }
+                }
+                else {
+                        if(!has_mts) {
+                                RPT(RPT_ERR, "TS packet without MTS, try -pcr");
+                                rslt = -1;
+                                break;
+                        }
+                        rslt = put_pkt(obj, MTS, MTS_OVF);
+                }
+                if(0 != rslt) {
+                        break;
+                }
+        }
+
+        /* the last datagram maybe not full */
+        if(0 == rslt) {
+                if(obj->len[obj->cnt]) {
+                        obj->due[obj->cnt] = obj->t0 + obj->clk * 1000 / MTS_US;
+                        obj->cnt++;
+                }
+                if(obj->cnt) {
+                        rslt = flush(obj, obj->cnt);
+                }
+        }
+        if(obj->has_stat) {
+                report(&(obj->total), obj->stat_due0, obj->stat_sent0, "total");
+        }
+
+        destroy(obj);
+        return rslt;
+}
+
+static struct toip_obj *create(int argc, char *argv[])
+{
+        int i;
+        int dat;
+        struct toip_obj *obj;
+
+        obj = (struct toip_obj *)calloc(1, sizeof(struct toip_obj));
+        if(NULL == obj) {
+                RPT(RPT_ERR, "malloc failed");
+                return NULL;
+        }
+
+        obj->file_o[0] = '\0';
+        obj->url = NULL;
+        obj->is_pcr = 0;
+        obj->npkt = NPKT_MAX;
+        obj->batch = 8;
+        obj->burst = 100 * 1000; /* 100us */
+        obj->spin = 200 * 1000; /* 200us */
+        obj->is_stat = 0;
+        obj->is_bin = 0;
+        obj->file_i = NULL;
+        obj->bin = 0;
+        obj->is_loop = 0;
+        obj->loop = NULL;
+        obj->mp = 0;
+        obj->ts = NULL;
+        for(i = 0; i < BATCH_MAX; i++) {
+                obj->buf[i] = obj->dgram[i];
+        }
+
+        if(1 == argc) {
+                /* no parameter */
+                fprintf(stderr, "No URL to process...\n\n");
+                show_help();
+                goto create_failed_with_obj;
+        }
+
+        for(i = 1; i < argc; i++) {
+                if('-' == argv[i][0]) {
+                        if(0 == strcmp(argv[i], "-pcr")) {
+                                obj->is_pcr = 1;
+                        }
+                        else if(0 == strcmp(argv[i], "-npkt")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-npkt'!\n");
+                                        goto create_failed_with_obj;
+                                }
+                                sscanf(argv[i], "%i" , &dat);
+                                if(dat < 1 || dat > NPKT_MAX) {
+                                        fprintf(stderr, "bad variable for '-npkt': %d, use %d instead!\n",
+                                                dat, NPKT_MAX);
+                                        dat = NPKT_MAX;
+                                }
+                                obj->npkt = dat;
+                        }
+                        else if(0 == strcmp(argv[i], "-batch")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-batch'!\n");
+                                        goto create_failed_with_obj;
+                                }
+                                sscanf(argv[i], "%i" , &dat);
+                                if(dat < 1 || dat > BATCH_MAX) {
+                                        fprintf(stderr, "bad variable for '-batch': %d, use 8 instead!\n", dat);
+                                        dat = 8;
+                                }
+                                obj->batch = dat;
+                        }
+                        else if(0 == strcmp(argv[i], "-burst")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-burst'!\n");
+                                        goto create_failed_with_obj;
+                                }
+                                sscanf(argv[i], "%i" , &dat);
+                                if(dat < 0) {
+                                        fprintf(stderr, "bad variable for '-burst': %d, use 100 instead!\n", dat);
+                                        dat = 100;
+                                }
+                                obj->burst = (int64_t)dat * 1000;
+                        }
+                        else if(0 == strcmp(argv[i], "-spin")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-spin'!\n");
+                                        goto create_failed_with_obj;
+                                }
+                                sscanf(argv[i], "%i" , &dat);
+                                if(dat < 0) {
+                                        fprintf(stderr, "bad variable for '-spin': %d, use 200 instead!\n", dat);
+                                        dat = 200;
+                                }
+                                obj->spin = (int64_t)dat * 1000;
+                        }
+                        else if(0 == strcmp(argv[i], "-stat")) {
+                                obj->is_stat = 1;
+                        }
+                        else if(0 == strcmp(argv[i], "-bin")) {
+                                obj->is_bin = 1;
+                        }
+                        else if(0 == strcmp(argv[i], "-i")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-i'!\n");
+                                        goto create_failed_with_obj;
+                                }
+                                obj->file_i = argv[i];
+                                obj->is_bin = 1;
+                        }
+                        else if(0 == strcmp(argv[i], "-loop")) {
+                                obj->is_loop = 1;
+                        }
+                        else if(0 == strcmp(argv[i], "-h") ||
+                                0 == strcmp(argv[i], "--help")) {
+                                show_help();
+                                goto create_failed_with_obj;
+                        }
+                        else if(0 == strcmp(argv[i], "-v") ||
+                                0 == strcmp(argv[i], "--version")) {
+                                show_version();
+                                goto create_failed_with_obj;
+                        }
+                        else {
+                                RPT(RPT_ERR, "wrong parameter: %s", argv[i]);
+                                goto create_failed_with_obj;
+                        }
+                }
+                else {
+                        strcpy(obj->file_o, argv[i]);
+                }
+        }
+
+        if(obj->is_loop && NULL == obj->file_i) {
+                fprintf(stderr, "'-loop' needs a file from '-i'!\n");
+                goto create_failed_with_obj;
+        }
+        /* open input before output, a bad file name is found earlier */
+        if(obj->is_bin) {
+                obj->is_pcr = 1; /* MTS of MTS file is not used, it can not loop */
+                obj->bin = bin_open(obj->file_i);
+                if(0 == obj->bin) {
+                        goto create_failed_with_obj;
+                }
+        }
+
+        obj->url = url_open(obj->file_o, "wb");
+        if(NULL == obj->url) {
+                RPT(RPT_ERR, "open \"%s\" failed", obj->file_o);
+                goto create_failed_with_bin;
+        }
+        if(SCH_UDP != obj->url->scheme) {
+                RPT(RPT_ERR, "\"%s\" is not udp://...", obj->file_o);
+                goto create_failed_with_url;
+        }
+
+        if(obj->is_pcr) {
+                struct ts_cfg cfg;
+
+                obj->mp = buddy_create(MP_ORDER, 6);
+                if(0 == obj->mp) {
+                        RPT(RPT_ERR, "malloc memory pool failed");
+                        goto create_failed_with_url;
+                }
+                buddy_init(obj->mp);
+
+                obj->ts = ts_create(obj->mp);
+                if(NULL == obj->ts) {
+                        RPT(RPT_ERR, "malloc ts object failed");
+                        goto create_failed_with_mp;
+                }
+                memset(&cfg, 0, sizeof(struct ts_cfg));
+                cfg.need_af = 1; /* PCR */
+                cfg.need_timestamp = 1; /* CTS */
+                cfg.need_psi = 1; /* PCR_PID of prog0, and elementary PID for -loop */
+                ts_ioctl(obj->ts, TS_INIT, 0);
+                ts_ioctl(obj->ts, TS_SCFG, (intptr_t)&cfg);
+        }
+
+        if(obj->is_loop) {
+                obj->loop = (struct toip_loop *)calloc(1, sizeof(struct toip_loop));
+                if(NULL == obj->loop) {
+                        RPT(RPT_ERR, "malloc failed");
+                        goto create_failed_with_ts;
+                }
+                memset(obj->loop->CC, 0x10, sizeof(obj->loop->CC));
+        }
+        return obj;
+
+create_failed_with_ts:
+        ts_destroy(obj->ts);
+create_failed_with_mp:
+        buddy_destroy(obj->mp);
+create_failed_with_url:
+        url_close(obj->url);
+create_failed_with_bin:
+        if(obj->bin) {
+                bin_close(obj->bin);
+        }
+create_failed_with_obj:
+        free(obj);
+        return NULL;
+}
+
+static int destroy(struct toip_obj *obj)
+{
+        if(NULL == obj) {
+                return 0;
+        }
+
+        if(obj->ts) {
+                ts_destroy(obj->ts);
+        }
+        if(obj->mp) {
+                buddy_destroy(obj->mp);
+        }
+        if(obj->bin) {
+                bin_close(obj->bin);
+        }
+        if(obj->loop) {
+                free(obj->loop);
+        }
+        url_close(obj->url);
+        free(obj);
+        return 0;
+}
+
+static int get_txt_pkt(struct toip_obj *obj, uint8_t *TS, int64_t *MTS, int *has_mts)
+{
+        char tbuf[LINE_LENGTH_MAX + 10]; /* txt data buffer */
+        char *tag;
+        char *pt = tbuf;
+        long long int data;
+        int cnt = 0;
+
+        if(NULL == fgets(tbuf, LINE_LENGTH_MAX, stdin)) {
+                return GOT_EOF;
+        }
+
+        while(0 == next_tag(&tag, &pt)) {
+                if(0 == strcmp(tag, "*ts")) {
+                        cnt = next_nbyte_hex(TS, &pt, TS_PKT_SIZE);
+                }
+                else if(0 == strcmp(tag, "*mts")) {
+                        next_nuint_hex(&data, &pt, 1);
+                        *MTS = (int64_t)data;
+                        *has_mts = 1;
+                }
+        }
+        if(0 == cnt) {
+                return GOT_WRONG_PKT; /* line without TS packet */
+        }
+        if(TS_PKT_SIZE != cnt) {
+                RPT(RPT_WRN, "bad TS packet: %d-byte, ignore it", cnt);
+                return GOT_WRONG_PKT;
+        }
+        return GOT_RIGHT_PKT;
+}
+
+static int get_bin_pkt(struct toip_obj *obj, uint8_t *TS)
+{
+        struct bin_pkt pkt;
+
+        while(0 != bin_read(obj->bin, &pkt)) {
+                if(!(obj->is_loop) || 0 != next_pass(obj)) {
+                        return GOT_EOF;
+                }
+        }
+        memcpy(TS, pkt.TS, TS_PKT_SIZE);
+        if(obj->is_loop && 0 == obj->loop->pass) {
+                obj->loop->pkt_cnt++;
+        }
+        return GOT_RIGHT_PKT;
+}
+
+/* rewind the file, time of the next pass goes on from this pass
+ * the file is taken as CBR between its first and last PCR */
+static int next_pass(struct toip_obj *obj)
+{
+        struct toip_loop *loop = obj->loop;
+        long double dur;
+
+        if(0 == loop->pass) {
+                if(!(loop->has_pcr0) || loop->idx1 == loop->idx0) {
+                        RPT(RPT_ERR, "less than 2 PCR in \"%s\", can not loop", obj->file_i);
+                        return -1;
+                }
+                dur = (long double)ts_timestamp_diff(loop->PCR1, loop->PCR0, STC_OVF);
+                dur *= loop->pkt_cnt;
+                dur /= (loop->idx1 - loop->idx0);
+                loop->dur = (int64_t)dur;
+                RPT(RPT_INF, "%lld packet, %.3fs each pass",
+                    (long long int)loop->pkt_cnt, (double)dur / STC_1S);
+        }
+
+        bin_close(obj->bin);
+        obj->bin = bin_open(obj->file_i);
+        if(0 == obj->bin) {
+                return -1;
+        }
+        loop->pass++;
+        loop->ofs = ts_timestamp_add(loop->ofs, loop->dur, STC_OVF);
+        return 0;
+}
+
+/* make CC, PCR, PTS and DTS of this pass follow the last pass */
+static void fix_pkt(struct toip_loop *loop, struct ts_obj *ts, uint8_t *TS)
+{
+        uint16_t PID = ((TS[1] & 0x1F) << 8) | TS[2];
+        int has_af = TS[3] & 0x20;
+        int has_payload = TS[3] & 0x10;
+        uint8_t *p = TS + 4; /* payload */
+
+        if(0x1FFF == PID) {
+                return;
+        }
+
+        /* CC: the first packet of each PID in this pass decides CC_ofs */
+        if(loop->pass && loop->CC_pass[PID] != loop->pass) {
+                uint8_t CC = TS[3] & 0x0F;
+
+                loop->CC_pass[PID] = loop->pass;
+                loop->CC_ofs[PID] = 0;
+                if(0x10 != loop->CC[PID]) {
+                        loop->CC_ofs[PID] = (loop->CC[PID] + (has_payload ? 1 : 0) - CC) & 0x0F;
+                }
+        }
+        TS[3] = (TS[3] & 0xF0) | ((TS[3] + loop->CC_ofs[PID]) & 0x0F);
+        loop->CC[PID] = TS[3] & 0x0F;
+
+        /* PCR */
+        if(has_af) {
+                if(TS[4] >= 7 && (TS[5] & 0x10)) {
+                        int64_t PCR = get_pcr(TS + 6);
+
+                        if(0 == loop->pass) {
+                                if(!(loop->has_pcr0)) {
+                                        loop->has_pcr0 = 1;
+                                        loop->PCR_PID = PID;
+                                        loop->PCR0 = PCR;
+                                        loop->idx0 = loop->pkt_cnt;
+                                }
+                                if(PID == loop->PCR_PID) {
+                                        loop->PCR1 = PCR;
+                                        loop->idx1 = loop->pkt_cnt;
+                                }
+                        }
+                        else {
+                                set_pcr(TS + 6, ts_timestamp_add(PCR, loop->ofs, STC_OVF));
+                        }
+                }
+                p += 1 + TS[4];
+        }
+
+        /* PTS and DTS in optional PES head, payload must be clear */
+        if(loop->pass && has_payload && (TS[1] & 0x40) && 0 == (TS[3] & 0xC0) &&
+           ts->pid_table[PID] && ts->pid_table[PID]->elem &&
+           p + 14 <= TS + TS_PKT_SIZE &&
+           0x00 == p[0] && 0x00 == p[1] && 0x01 == p[2] &&
+           has_pes_opt(p[3]) && 0x80 == (p[6] & 0xC0)) {
+                int64_t ofs = loop->ofs / 300;
+                int flags = p[7] >> 6; /* PTS_DTS_flags */
+
+                if(flags & 0x02) {
+                        set_pts(p + 9, ts_timestamp_add(get_pts(p + 9), ofs, STC_BASE_OVF));
+                }
+                if(0x03 == flags && p + 19 <= TS + TS_PKT_SIZE) {
+                        set_pts(p + 14, ts_timestamp_add(get_pts(p + 14), ofs, STC_BASE_OVF));
+                }
+        }
+        return;
+}
+
+/* stream_id with PTS_DTS_flags, etc, see ts_parse_pesh_switch() */
+static int has_pes_opt(uint8_t stream_id)
+{
+        switch(stream_id) {
+                case 0xBC: /* program_stream_map */
+                case 0xBE: /* padding_stream */
+                case 0xBF: /* private_stream_2 */
+                case 0xF0: /* ECM */
+                case 0xF1: /* EMM */
+                case 0xF2: /* DSMCC_stream */
+                case 0xF8: /* ITU-T Rec. H.222.1 type E stream */
+                case 0xFF: /* program_stream_directory */
+                        return 0;
+                default:
+                        return 1;
+        }
+}
+
+/* p: point to program_clock_reference_base */
+static int64_t get_pcr(const uint8_t *p)
+{
+        int64_t base;
+        int64_t ext;
+
+        base = ((int64_t)p[0] << 25) | (p[1] << 17) | (p[2] << 9) | (p[3] << 1) | (p[4] >> 7);
+        ext = ((p[4] & 0x01) << 8) | p[5];
+        return base * 300 + ext;
+}
+
+static void set_pcr(uint8_t *p, int64_t PCR)
+{
+        int64_t base = PCR / 300;
+        int ext = (int)(PCR % 300);
+
+        p[0] = (uint8_t)(base >> 25);
+        p[1] = (uint8_t)(base >> 17);
+        p[2] = (uint8_t)(base >> 9);
+        p[3] = (uint8_t)(base >> 1);
+        p[4] = (uint8_t)(((base & 0x01) << 7) | 0x7E | (ext >> 8));
+        p[5] = (uint8_t)(ext);
+        return;
+}
+
+/* p: point to the 5-byte PTS or DTS, with marker_bit */
+static int64_t get_pts(const uint8_t *p)
+{
+        return ((int64_t)((p[0] >> 1) & 0x07) << 30) | (p[1] << 22) | ((p[2] >> 1) << 15) |
+               (p[3] << 7) | (p[4] >> 1);
+}
+
+static void set_pts(uint8_t *p, int64_t PTS)
+{
+        p[0] = (uint8_t)((p[0] & 0xF1) | ((PTS >> 29) & 0x0E));
+        p[1] = (uint8_t)(PTS >> 22);
+        p[2] = (uint8_t)(((PTS >> 14) & 0xFE) | 0x01);
+        p[3] = (uint8_t)(PTS >> 7);
+        p[4] = (uint8_t)(((PTS << 1) & 0xFE) | 0x01);
+        return;
+}
+
+/* TS packet is in dgram[cnt] already, T is its MTS or CTS, ovf 0 means no time */
+static int put_pkt(struct toip_obj *obj, int64_t T, int64_t ovf)
+{
+        int idx = obj->cnt;
+
+        if(ovf) {
+                if(obj->has_lT) {
+                        int64_t dT = ts_timestamp_diff(T, obj->lT, ovf);
+
+                        if(0 <= dT && dT < JUMP_MAX) {
+                                obj->clk += dT;
+                                obj->lT = T;
+                        }
+                        else if(-JUMP_MAX < dT && dT < 0) {
+                                /* e.g. CTS after a new PCR, wait for T to catch up with lT */
+                        }
+                        else {
+                                RPT(RPT_WRN, "time jump: %" PRId64 "ms", dT / MTS_MS);
+                                obj->lT = T;
+                        }
+                }
+                else {
+                        obj->lT = T;
+                        obj->has_lT = 1;
+                }
+        }
+        if(0 == obj->t0) {
+                obj->t0 = now_ns();
+        }
+
+        obj->len[idx] += TS_PKT_SIZE;
+        if(obj->len[idx] < TS_PKT_SIZE * obj->npkt) {
+                return 0;
+        }
+
+        /* datagram is full, it is due when its last packet is due */
+        obj->due[idx] = obj->t0 + obj->clk * 1000 / MTS_US;
+        obj->cnt++;
+        if(obj->due[idx] - obj->due[0] > obj->burst) {
+                return flush(obj, idx); /* dgram[idx] goes with the next batch */
+        }
+        if(obj->cnt >= obj->batch) {
+                return flush(obj, obj->cnt);
+        }
+        return 0;
+}
+
+/* send the first n datagram in queue at due[0] */
+static int flush(struct toip_obj *obj, int n)
+{
+        struct toip_stat *stat = &(obj->stat);
+        struct toip_stat *total = &(obj->total);
+        int64_t now;
+        int64_t late;
+        int64_t byte = 0;
+        int i;
+
+        wait_until(obj, obj->due[0]);
+        now = now_ns();
+        late = now - obj->due[0];
+        if(late > LATE_MAX) {
+                /* input is too slow, e.g. pipe stall, do not send the rest in a rush */
+                RPT(RPT_WRN, "late %" PRId64 "ms, restart schedule", late / 1000000);
+                obj->t0 += late;
+                for(i = 0; i < obj->cnt; i++) {
+                        obj->due[i] += late;
+                }
+                stat->resync++;
+                total->resync++;
+                late = 0;
+        }
+
+        if(n != udp_send(obj->url->udp, obj->buf, obj->len, n)) {
+                RPT(RPT_ERR, "udp_send failed");
+                return -1;
+        }
+        for(i = 0; i < n; i++) {
+                byte += obj->len[i];
+        }
+
+        /* statistic: rate of [due, sent] of the last datagram in last report, to the last one now */
+        if(!obj->has_stat) {
+                obj->has_stat = 1;
+                obj->stat_due0 = obj->due[n - 1];
+                obj->stat_sent0 = now;
+                stat->due = obj->due[n - 1];
+                stat->sent = now;
+                byte = 0; /* the first batch is the start point */
+        }
+        stat->byte += byte;
+        total->byte += byte;
+        stat->late_sum += late;
+        total->late_sum += late;
+        stat->late_max = (late > stat->late_max) ? late : stat->late_max;
+        total->late_max = (late > total->late_max) ? late : total->late_max;
+        stat->send_cnt++;
+        total->send_cnt++;
+        total->due = obj->due[n - 1];
+        total->sent = now;
+        if(obj->is_stat && now - stat->sent >= NS_1S) {
+                int64_t due0 = stat->due;
+                int64_t sent0 = stat->sent;
+
+                stat->due = obj->due[n - 1];
+                stat->sent = now;
+                report(stat, due0, sent0, "1s");
+                memset(stat, 0, sizeof(struct toip_stat));
+                stat->due = obj->due[n - 1];
+                stat->sent = now;
+        }
+
+        /* move the rest and the filling one to the head of queue */
+        for(i = n; i <= obj->cnt; i++) {
+                if(i < BATCH_MAX) {
+                        memcpy(obj->dgram[i - n], obj->dgram[i], obj->len[i]);
+                        obj->len[i - n] = obj->len[i];
+                        obj->due[i - n] = obj->due[i];
+                }
+                else {
+                        obj->len[i - n] = 0; /* queue was full, no filling one */
+                }
+        }
+        for(i = obj->cnt - n + 1; i <= obj->cnt && i < BATCH_MAX; i++) {
+                obj->len[i] = 0;
+        }
+        obj->cnt -= n;
+        return 0;
+}
+
+/* sleep until (due - spin), then busy wait, timer slack of sleep is tens of us */
+static void wait_until(struct toip_obj *obj, int64_t due)
+{
+        int64_t t = due - obj->spin;
+
+        if(t > now_ns()) {
+#ifdef SYS_LINUX
+                struct timespec ts;
+
+                ts.tv_sec = t / NS_1S;
+                ts.tv_nsec = t % NS_1S;
+                while(0 != clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) {
+                        /* EINTR */
+                }
+#else
+                struct timeval tv;
+
+                t -= now_ns();
+                tv.tv_sec = t / NS_1S;
+                tv.tv_usec = (t % NS_1S) / 1000;
+                select(0, NULL, NULL, NULL, &tv); /* sleep */
+#endif
+        }
+        while(now_ns() < due) {
+                /* busy wait */
+        }
+        return;
+}
+
+/* target rate is from due time, real rate is from send time */
+static void report(struct toip_stat *stat, int64_t due0, int64_t sent0, const char *hint)
+{
+        int64_t d_due = stat->due - due0;
+        int64_t d_sent = stat->sent - sent0;
+
+        fprintf(stderr, "*toip, %s, *rate, %.6f, %.6f, *late, %.1f, %.1f, *resync, %" PRId64 ", \n",
+                hint,
+                (d_due > 0) ? (double)stat->byte * 8 * 1000 / d_due : 0.0, /* Mbps */
+                (d_sent > 0) ? (double)stat->byte * 8 * 1000 / d_sent : 0.0, /* Mbps */
+                (stat->send_cnt) ? (double)stat->late_sum / stat->send_cnt / 1000 : 0.0, /* us */
+                (double)stat->late_max / 1000, /* us */
+                stat->resync);
+        return;
+}
+
+static int64_t now_ns(void)
+{
+        struct timespec tp;
+
+        clock_gettime(CLOCK_MONOTONIC, &tp);
+        return (int64_t)(tp.tv_sec) * NS_1S + tp.tv_nsec;
+}
+
+static void on_signal(int sig)
+{
+        is_exit = 1;
+        return;
+}
+
+static void show_help()
+{
+        puts("'toip' read from stdin or file, convert to UDP, send to IP according to MTS or PCR.");
+        puts("");
+        puts("Usage: toip [OPTION] udp://@xxx.xxx.xxx.xxx:xxxx [OPTION]");
+        puts("");
+        puts("Options:");
+        puts("");
+        puts(" -pcr             send according to PCR of the first program, instead of MTS");
+        puts(" -npkt <n>        TS packet in each datagram, default: 7, [1, 7]");
+        puts(" -batch <n>       max datagram for each send, default: 8, [1, 32]");
+        puts(" -burst <us>      datagrams due in <us> are sent together, default: 100");
+        puts(" -spin <us>       busy wait before due time, default: 200");
+        puts(" -stat            report each second to stderr");
+        puts(" -bin             get binary TS from stdin, instead of text from catts, -pcr is used");
+        puts(" -i <file>        get binary TS from file, -pcr is used");
+        puts(" -loop            send file of '-i' again and again, CC, PCR, PTS and DTS go on");
+        puts(" -h, --help       print this information only");
+        puts(" -v, --version    print my version only");
+        puts("");
+        puts("Report to stderr, each second with -stat, and at the end:");
+        puts("  \"*toip, 1s|total, *rate, target(Mbps), sent(Mbps), *late, average(us), max(us), *resync, n, \"");
+        puts("");
+        puts("Examples:");
+        puts("  catts *.mts | toip udp://@:1234");
+        puts("  catts *.mts | toip udp://@224.165.54.210:1234");
+        puts("  catts *.ts | tsana -ts -mts | toip udp://@:1234");
+        puts("  catts *.ts | toip -pcr -stat udp://@224.165.54.210:1234");
+        puts("  toip -i xxx.ts -loop udp://@224.165.54.210:1234");
+        puts("");
+        puts("Report bugs to <zhoucheng@tsinghua.org.cn>.");
+        return;
+}
+
+static void show_version()
+{
+        char str[100];
+
+        sprintf(str, "toip of tstools v%s (%s)", VERSION_STR, REVISION);
+        puts(str);
+        sprintf(str, "Build time: %s %s", __DATE__, __TIME__);
+        puts(str);
+        puts("");
+        puts("Copyright (C) 2009,2010,2011,2012 ZHOU Cheng.");
+        puts("License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>");
+        puts("This is free software; contact author for additional information.");
+        puts("There is NO warranty; not even for MERCHANTABILITY or FITNESS FOR");
+        puts("A PARTICULAR PURPOSE.");
+        puts("");
+        puts("Written by ZHOU Cheng.");
+        return;
+}
@@ -17,6 +17,7 @@
 #include "tstool_config.h"
 #include "common.h"
 #include "if.h"
+#include "bin.h" /* for bin_read(), etc */
 #include "buddy.h" /* for BUDDY_ORDER_MAX */
 #include "ts.h" /* has "list.h" already */
 #include "UTF_GB.h"
@@ -40,6 +41,7 @@ static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
 
 #define PKT_BBUF                        (256) /* 188 or 204 */
 #define PKT_TBUF                        (PKT_BBUF * 3 + 10)
+#define BATCH_SIZE                      (256) /* packets for each ts_parse_batch() */
 
 #define ANY_PID                         (0x2000) /* any PID of [0x0000,0x1FFF] */
 #define ANY_TABLE                       (0xFF) /* any table_id of [0x00,0xFE] */
@@ -52,7 +54,7 @@ static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
 #define STC_US                          (27) /* 27 clk means 1(us) */
 #define STC_MS                          (27 * 1000) /* uint: do NOT use 1e3  */
 
-#define MP_ORDER_DEFAULT ((size_t)20) /* default memory pool size: (1 << MP_ORDER_DEFAULT) */
+#define MP_ORDER_DEFAULT ((size_t)20) /* default memory pool arena size: (1 << MP_ORDER_DEFAULT) */
 
 struct pid_type_table {
         int   type; /* TS_TYPE_xxx */
@@ -160,6 +162,7 @@ struct aim {
         int cts;
         int stc;
         int pcr;
+        int oj;
         int pts;
         int tsh;
         int ts;
@@ -186,6 +189,11 @@ struct tsana_obj {
         int is_impsi; /* import PSI/SI from psi.xml */
         int is_dump; /* output packet directly */
         int is_mem; /* show memory info */
+        int is_bin; /* binary TS input, instead of text */
+        char *file_i; /* binary TS file, NULL means stdin */
+        intptr_t bin; /* id of binary TS input */
+        int is_frame; /* binary frame input, instead of text */
+        struct if_frame frm; /* binary frame */
         uint64_t aim_start; /* ignore some packets fisrt, default: 0(no ignore) */
         uint64_t aim_count; /* stop after analyse some packets, default: 0(no stop) */
         uint16_t aim_pid;
@@ -204,8 +212,12 @@ struct tsana_obj {
         char *color_white;
         struct timeval tv; /* the arrive time of this packet */
         struct timeval ltv; /* last arrive time */
+        struct timeval tv0; /* arrive time of the first packet with CTS */
+        int64_t lCTS; /* CTS of last packet */
+        int64_t CTS_sum; /* CTS passed from tv0 */
 
         uint64_t cnt; /* packet analysed */
+        int evt; /* (1 << TS_EVT_xxx) of this packet, set by on_event() */
         char tbuf[PKT_TBUF];
         char tbak[PKT_TBUF];
 
@@ -234,6 +246,12 @@ enum {
 
 static struct tsana_obj *obj = NULL;
 
+static int deal_with_pkt(struct tsana_obj *obj);
+static void arrive_time(struct tsana_obj *obj);
+static int parse_bin(struct tsana_obj *obj);
+static int batch_cb(struct ts_obj *ts, void *arg);
+static void on_event(struct ts_obj *ts, int evt, void *arg);
+
 static void state_parse_psi(struct tsana_obj *obj);
 static int state_parse_each(struct tsana_obj *obj);
 
@@ -249,6 +267,8 @@ static void show_help();
 static void show_version();
 
 static int get_one_pkt(struct tsana_obj *obj);
+static int get_bin_pkt(struct tsana_obj *obj);
+static int get_frame_pkt(struct tsana_obj *obj);
 static const struct pid_type_table *ts_pid_type(int type);
 static const struct stream_type_table *elem_type(int stream_type);
 
@@ -267,6 +287,7 @@ static void show_addr(struct tsana_obj *obj);
 static void show_cts(struct tsana_obj *obj);
 static void show_stc(struct tsana_obj *obj);
 static void show_pcr(struct tsana_obj *obj);
+static void show_oj(struct tsana_obj *obj);
 static void show_pts(struct tsana_obj *obj);
 static void show_tsh(struct tsana_obj *obj);
 static void show_ts(struct tsana_obj *obj);
@@ -281,6 +302,7 @@ static void show_rate(struct tsana_obj *obj);
 static void show_rats(struct tsana_obj *obj);
 static void show_ratp(struct tsana_obj *obj);
 static int show_error(struct tsana_obj *obj);
+static void clear_error(struct tsana_obj *obj);
 
 static void table_info_PAT(struct ts_sect *sect, uint8_t *section);
 static void table_info_CAT(struct ts_sect *sect, uint8_t *section);
@@ -320,7 +342,12 @@ int main(int argc, char *argv[])
                 import_psi(obj);
         }
 
-        while(STATE_EXIT != obj->state && GOT_EOF != (get_rslt = get_one_pkt(obj))) {
+        if(obj->is_bin) {
+                if(-1 == parse_bin(obj)) {
+                        goto main_return;
+                }
+        }
+        else while(STATE_EXIT != obj->state && GOT_EOF != (get_rslt = get_one_pkt(obj))) {
                 if(GOT_WRONG_PKT == get_rslt) {
                         break;
                 }
@@ -328,33 +355,16 @@ int main(int argc, char *argv[])
                         break;
                 }
                 if(ts->cnt < obj->aim_start) {
+                        obj->evt = 0; /* ignore event of this packet */
                         continue;
                 }
 
-                gettimeofday(&(obj->tv), NULL); /* record the arrive time */
                 ts_parse_tsb(obj->ts);
-                switch(obj->state) {
-                        case STATE_PARSE_PSI:
-                                state_parse_psi(obj);
-                                break;
-                        case STATE_PARSE_EACH:
-                                if(0 != state_parse_each(obj)) {
-                                        goto main_return;
-                                }
-                                break;
-                        case STATE_EXIT:
-                                break;
-                        default:
-                                fprintf(stderr, "Wrong state(%d)!\n", obj->state);
-                                obj->state = STATE_EXIT;
-                                break;
-                }
-
-                if(obj->is_dump) {
-                        show_pkt(obj);
+                get_rslt = deal_with_pkt(obj);
+                if(-1 == get_rslt) {
+                        goto main_return;
                 }
-                obj->cnt++;
-                if((0 != obj->aim_count) && (obj->cnt >= obj->aim_count)) {
+                if(1 == get_rslt) {
                         break;
                 }
         }
@@ -384,6 +394,132 @@ main_return:
         return 0;
 }
 
+/* after ts_parse_tsb() of each packet
+ * return: 0 for next packet, 1 to stop, -1 to exit directly */
+static int deal_with_pkt(struct tsana_obj *obj)
+{
+        arrive_time(obj); /* record the arrive time */
+        switch(obj->state) {
+                case STATE_PARSE_PSI:
+                        state_parse_psi(obj);
+                        break;
+                case STATE_PARSE_EACH:
+                        if(0 != state_parse_each(obj)) {
+                                return -1;
+                        }
+                        break;
+                case STATE_EXIT:
+                        break;
+                default:
+                        fprintf(stderr, "Wrong state(%d)!\n", obj->state);
+                        obj->state = STATE_EXIT;
+                        break;
+        }
+
+        if(obj->is_dump) {
+                show_pkt(obj);
+        }
+        if(obj->ts->err.mask) {
+                clear_error(obj); /* error not reported, e.g. filtered, do not report it with later packet */
+        }
+        obj->evt = 0;
+        obj->cnt++;
+        if((0 != obj->aim_count) && (obj->cnt >= obj->aim_count)) {
+                return 1;
+        }
+        if(STATE_EXIT == obj->state) {
+                return 1;
+        }
+        return 0;
+}
+
+/* record the event of this packet, only the events needed by aim are registered */
+static void on_event(struct ts_obj *ts, int evt, void *arg)
+{
+        struct tsana_obj *obj = (struct tsana_obj *)arg;
+
+        obj->evt |= (1 << evt);
+        return;
+}
+
+/* arrive time of this packet: by CTS from input(e.g. "catip -t") if possible */
+static void arrive_time(struct tsana_obj *obj)
+{
+        struct ts_ipt *ipt = &(obj->ts->ipt);
+        int64_t us;
+
+        if(!(ipt->has_cts)) {
+                gettimeofday(&(obj->tv), NULL);
+                return;
+        }
+
+        if(!timerisset(&(obj->tv0))) {
+                gettimeofday(&(obj->tv0), NULL);
+                obj->lCTS = ipt->CTS;
+                obj->CTS_sum = 0;
+        }
+        obj->CTS_sum += ts_timestamp_diff(ipt->CTS, obj->lCTS, STC_OVF);
+        obj->lCTS = ipt->CTS;
+
+        us = obj->tv0.tv_usec + obj->CTS_sum / STC_US;
+        obj->tv.tv_sec = obj->tv0.tv_sec + us / 1000000;
+        obj->tv.tv_usec = us % 1000000;
+        return;
+}
+
+/* parse binary TS input in batch, without copy packets into ipt.TS[]
+ * return: 0 for EOF or stop, -1 to exit directly */
+static int parse_bin(struct tsana_obj *obj)
+{
+        struct ts_obj *ts = obj->ts;
+        int type;
+        uint8_t *TS;
+        int64_t ADDR[BATCH_SIZE];
+        int64_t MTS[BATCH_SIZE];
+        int n;
+        int rslt;
+
+        /* ignore some packets fisrt, only TS head is needed */
+        while(STATE_EXIT != obj->state && (uint64_t)(ts->cnt + 1) < obj->aim_start) {
+                if(GOT_RIGHT_PKT != get_bin_pkt(obj)) {
+                        return 0;
+                }
+                if(0 != ts_parse_tsh(ts)) {
+                        return 0;
+                }
+                obj->evt = 0; /* ignore event of this packet */
+        }
+
+        while(STATE_EXIT != obj->state) {
+                n = bin_read_batch(obj->bin, &TS, BATCH_SIZE, ADDR, MTS);
+                if(0 == n) {
+                        break; /* EOF */
+                }
+
+                /* bin_type() is known after the first read */
+                type = bin_type(obj->bin);
+                rslt = ts_parse_batch(ts, TS, n, type, ADDR,
+                                      ((BIN_TYPE_MTS == type) ? MTS : NULL),
+                                      batch_cb, obj);
+                if(2 == rslt) {
+                        return -1;
+                }
+                if(0 != rslt) {
+                        break; /* parse failed or stop */
+                }
+        }
+        return 0;
+}
+
+static int batch_cb(struct ts_obj *ts, void *arg)
+{
+        struct tsana_obj *obj = (struct tsana_obj *)arg;
+        int rslt;
+
+        rslt = deal_with_pkt(obj);
+        return ((-1 == rslt) ? 2 : rslt); /* -1 of ts_parse_batch() means parse failed */
+}
+
 static void state_parse_psi(struct tsana_obj *obj)
 {
         struct ts_obj *ts = obj->ts;
@@ -396,8 +532,11 @@ static void state_parse_psi(struct tsana_obj *obj)
 
 static int state_parse_each(struct tsana_obj *obj)
 {
-        int i;
-        int has_err;
+        int has_pcr = (obj->evt & (1 << TS_EVT_PCR));
+        int has_pts = (obj->evt & (1 << TS_EVT_PTS));
+        int has_sect = (obj->evt & (1 << TS_EVT_SECT));
+        int has_err = (0 != obj->ts->err.mask);
+        int has_rate = (obj->evt & (1 << TS_EVT_RATE));
         int has_report;
         struct ts_obj *ts = obj->ts;
         struct ts_pid *pid = ts->pid;
@@ -407,6 +546,7 @@ static int state_parse_each(struct tsana_obj *obj)
         if(obj->aim.sec         ||
            obj->aim.si          ||
            obj->aim.pcr         ||
+           obj->aim.oj          ||
            obj->aim.pts         ||
            obj->aim.af          ||
            obj->aim.pesh        ||
@@ -421,7 +561,7 @@ static int state_parse_each(struct tsana_obj *obj)
 
                 /* filter: table_id */
                 if(ANY_TABLE != obj->aim_table &&
-                   sect->table_id != obj->aim_table) {
+                   (!sect || sect->table_id != obj->aim_table)) {
                         return 0;
                 }
 
@@ -449,20 +589,15 @@ static int state_parse_each(struct tsana_obj *obj)
                 }
         }
 
-        /* error for this TS packet? */
-        has_err = 0;
-        for(i = 0; i < sizeof(struct ts_err); i++) {
-                if(*((uint8_t *)&(ts->err) + i)) {
-                        has_err = 1;
-                }
-        }
-
         /* report for this TS packet? */
         has_report = 0;
-        if(obj->aim.pts && ts->has_pts) {
+        if(obj->aim.pts && has_pts) {
+                has_report = 1;
+        }
+        if(obj->aim.pcr && has_pcr) {
                 has_report = 1;
         }
-        if(obj->aim.pcr && ts->has_pcr) {
+        if(obj->aim.oj && ts->has_oj) {
                 has_report = 1;
         }
         if(obj->aim.ts) {
@@ -480,19 +615,19 @@ static int state_parse_each(struct tsana_obj *obj)
         if(obj->aim.es && ts->ES_len) {
                 has_report = 1;
         }
-        if(obj->aim.sec && ts->sect) {
+        if(obj->aim.sec && has_sect) {
                 has_report = 1;
         }
-        if(obj->aim.si && ts->sect) {
+        if(obj->aim.si && has_sect) {
                 has_report = 1;
         }
-        if(obj->aim.rate && ts->has_rate) {
+        if(obj->aim.rate && has_rate) {
                 has_report = 1;
         }
-        if(obj->aim.rats && ts->has_rate) {
+        if(obj->aim.rats && has_rate) {
                 has_report = 1;
         }
-        if(obj->aim.ratp && ts->has_rate) {
+        if(obj->aim.ratp && has_rate) {
                 has_report = 1;
         }
         if(obj->aim.err && has_err) {
@@ -518,6 +653,9 @@ static int state_parse_each(struct tsana_obj *obj)
         if(obj->aim.pcr && has_report) {
                 show_pcr(obj);
         }
+        if(obj->aim.oj && has_report) {
+                show_oj(obj);
+        }
         if(obj->aim.tsh && has_report) {
                 show_tsh(obj);
         }
@@ -539,19 +677,19 @@ static int state_parse_each(struct tsana_obj *obj)
         if(obj->aim.es && ts->ES_len) {
                 show_es(obj);
         }
-        if(obj->aim.sec && ts->sect) {
+        if(obj->aim.sec && has_sect) {
                 show_sec(obj);
         }
-        if(obj->aim.si && ts->sect) {
+        if(obj->aim.si && has_sect) {
                 show_si(obj);
         }
-        if(obj->aim.rate && ts->has_rate) {
+        if(obj->aim.rate && has_rate) {
                 show_rate(obj);
         }
-        if(obj->aim.rats && ts->has_rate) {
+        if(obj->aim.rats && has_rate) {
                 show_rats(obj);
         }
-        if(obj->aim.ratp && ts->has_rate) {
+        if(obj->aim.ratp && has_rate) {
                 show_ratp(obj);
         }
         if(obj->aim.err && has_err) {
@@ -571,6 +709,7 @@ static struct tsana_obj *create(int argc, char *argv[])
         int i;
         int dat;
         size_t mp_order;
+        int crc_sample;
         struct tsana_obj *obj;
         struct ts_cfg cfg;
 
@@ -581,6 +720,7 @@ static struct tsana_obj *create(int argc, char *argv[])
         }
 
         mp_order = MP_ORDER_DEFAULT; /* big memory for memory pool */
+        crc_sample = 1; /* check CRC_32 of each repeated section */
         obj->mode = MODE_LST;
         obj->state = STATE_PARSE_PSI;
         memset(&(obj->aim), 0, sizeof(struct aim));
@@ -589,6 +729,10 @@ static struct tsana_obj *create(int argc, char *argv[])
         obj->is_impsi = 0;
         obj->is_dump = 0;
         obj->is_mem = 0;
+        obj->is_bin = 0;
+        obj->file_i = NULL;
+        obj->bin = (intptr_t)NULL;
+        obj->is_frame = 0;
         obj->cnt = 0;
         obj->aim_start = 0;
         obj->aim_count = 0;
@@ -608,6 +752,9 @@ static struct tsana_obj *create(int argc, char *argv[])
         obj->color_white = "";
         timerclear(&(obj->tv));
         timerclear(&(obj->ltv));
+        timerclear(&(obj->tv0));
+        obj->lCTS = 0;
+        obj->CTS_sum = 0;
 
         for(i = 1; i < argc; i++) {
                 if('-' == argv[i][0]) {
@@ -630,6 +777,12 @@ static struct tsana_obj *create(int argc, char *argv[])
                         else if(0 == strcmp(argv[i], "-mem")) {
                                 obj->is_mem = 1;
                         }
+                        else if(0 == strcmp(argv[i], "-bin")) {
+                                obj->is_bin = 1;
+                        }
+                        else if(0 == strcmp(argv[i], "-frame")) {
+                                obj->is_frame = 1;
+                        }
                         else if(0 == strcmp(argv[i], "-time")) {
                                 obj->aim.time = 1;
                                 obj->mode = MODE_ALL;
@@ -650,6 +803,10 @@ static struct tsana_obj *create(int argc, char *argv[])
                                 obj->aim.pcr = 1;
                                 obj->mode = MODE_ALL;
                         }
+                        else if(0 == strcmp(argv[i], "-oj")) {
+                                obj->aim.oj = 1;
+                                obj->mode = MODE_ALL;
+                        }
                         else if(0 == strcmp(argv[i], "-pts")) {
                                 obj->aim.pts = 1;
                                 obj->mode = MODE_ALL;
@@ -842,6 +999,20 @@ static struct tsana_obj *create(int argc, char *argv[])
                                                 dat, MP_ORDER_DEFAULT);
                                 }
                         }
+                        else if(0 == strcmp(argv[i], "-crc")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-crc'!\n");
+                                        goto create_failed_with_obj;
+                                }
+                                sscanf(argv[i], "%i" , &dat);
+                                if(0 <= dat) {
+                                        crc_sample = dat;
+                                }
+                                else {
+                                        fprintf(stderr, "bad variable for '-crc': %d, use 1 instead!\n", dat);
+                                }
+                        }
                         else if(0 == strcmp(argv[i], "-h") ||
                                 0 == strcmp(argv[i], "--help")) {
                                 show_help();
@@ -862,7 +1033,15 @@ static struct tsana_obj *create(int argc, char *argv[])
                         }
                 }
                 else {
-                        fprintf(stderr, "Wrong parameter: %s\n", argv[i]);
+                        obj->file_i = argv[i];
+                        obj->is_bin = 1;
+                }
+        }
+
+        /* binary TS input */
+        if(obj->is_bin) {
+                obj->bin = bin_open(obj->file_i);
+                if(0 == obj->bin) {
                         goto create_failed_with_obj;
                 }
         }
@@ -871,7 +1050,7 @@ static struct tsana_obj *create(int argc, char *argv[])
         mp = buddy_create(mp_order, 6); /* borrow a big memory from OS */
         if(0 == mp) {
                 RPT(RPT_ERR, "malloc memory pool failed");
-                goto create_failed_with_obj;
+                goto create_failed_with_bin;
         }
         buddy_init(mp); /* now, we can use xx_malloc() */
         buddy_status(mp, obj->is_mem, "after buddy init");
@@ -892,12 +1071,32 @@ static struct tsana_obj *create(int argc, char *argv[])
                 RPT(RPT_ERR, "malloc ts object failed");
                 goto create_failed_with_mp;
         }
+        cfg.crc_sample = ((0 == crc_sample) ? -1 : crc_sample); /* -crc 0: never */
         ts_ioctl(obj->ts, TS_INIT, 0);
         ts_ioctl(obj->ts, TS_SCFG, (intptr_t)&cfg);
+
+        /* only the events needed */
+        obj->evt = 0;
+        if(obj->aim.pcr) {
+                ts_event(obj->ts, TS_EVT_PCR, on_event, obj);
+        }
+        if(obj->aim.pts) {
+                ts_event(obj->ts, TS_EVT_PTS, on_event, obj);
+        }
+        if(obj->aim.sec || obj->aim.si) {
+                ts_event(obj->ts, TS_EVT_SECT, on_event, obj);
+        }
+        if(obj->aim.rate || obj->aim.rats || obj->aim.ratp) {
+                ts_event(obj->ts, TS_EVT_RATE, on_event, obj);
+        }
         return obj;
 
 create_failed_with_mp:
         buddy_destroy(mp); /* return the memory to OS */
+create_failed_with_bin:
+        if(obj->bin) {
+                bin_close(obj->bin);
+        }
 create_failed_with_obj:
         free(obj);
         return NULL;
@@ -910,11 +1109,15 @@ static int destroy(struct tsana_obj *obj)
         }
 
         buddy_status(mp, obj->is_mem, "before ts destroy");
+        ts_ioctl(obj->ts, TS_MEM, obj->is_mem);
         ts_destroy(obj->ts);
         buddy_status(mp, obj->is_mem, "after ts destroy");
 
         buddy_destroy(mp); /* return the memory to OS */
 
+        if(obj->bin) {
+                bin_close(obj->bin);
+        }
         free(obj);
 
         return 1;
@@ -958,9 +1161,11 @@ static char *xstrdup(const char *SRC)
 static void show_help()
 {
         fprintf(stdout,
-                "'tsana' get TS packet from stdin, analyse, then send the result to stdout.\n"
+                "'tsana' get TS packet from stdin or file, analyse, then send the result to stdout.\n"
                 "\n"
-                "Usage: tsana [OPTION]...\n"
+                "Usage: tsana [OPTION]... [FILE]\n"
+                "\n"
+                "FILE is a binary TS file(188, 192 or 204-byte packet), it means -bin.\n"
                 "\n"
                 "Options:\n"
                 " -lst             show PID list information, default option\n"
@@ -972,12 +1177,15 @@ static void show_help()
 #endif
                 " -dump            dump cared packet\n"
                 " -mem             show memory status\n"
+                " -bin             get binary TS from stdin, instead of text from catts\n"
+                " -frame           get binary frame from stdin, e.g. \"catts -f\", dump as frame too\n"
                 "\n"
                 " -time            \"*time, YYYY-mm-dd HH:MM:SS, second, usecond, delta_time(ms), \"\n"
                 " -addr            \"*addr, address(hex), address(dec), PID, \"\n"
                 " -cts             \"*cts, CTS, BASE, \"\n"
                 " -stc             \"*stc, STC, BASE, \"\n"
                 " -pcr             \"*pcr, PCR, BASE, EXT, interval(ms), continuity(ms), jitter(ns), \"\n"
+                " -oj              \"*oj, PCR_OJ(ns), PCR_FO(ppm), \", need CTS, e.g. \"catip -t\"\n"
                 " -pts             \"*pts, PTS, dPTS(ms), PTS-PCR(ms), DTS, dDTS(ms), DTS-PCR(ms), \"\n"
                 " -tsh             \"*tsh, 47, xx, xx, xx, \"\n"
                 " -ts              \"*ts, 47, ..., xx, \"\n"
@@ -1001,13 +1209,15 @@ static void show_help()
                 " -prog <prog>     set cared prog, default: any program(0x0000)\n"
                 " -type <type>     set cared PID type, default: any type(0)\n"
                 " -iv <iv>         set cared interval(1ms-70,000ms), default: 1000ms\n"
-                " -mp <mp>         set memory pool size order(16-%zd), default: %zd, means 2^%zd bytes\n"
+                " -mp <mp>         set memory pool arena size order(16-%zd), default: %zd, means 2^%zd bytes, more arena is added if needed\n"
+                " -crc <n>         check CRC_32 of 1 in n repeated section, 0: never, default: 1\n"
                 "\n"
                 " -h, --help       display this information\n"
                 " -v, --version    display my version\n"
                 "\n"
                 "Examples:\n"
                 "  \"catts xxx.ts | tsana -c -time -addr -pcr -pts\" -- report all PCR/PTS/DTS information\n"
+                "  \"tsana -c -addr -pcr xxx.ts\" -- the same, but read binary TS file directly\n"
                 "\n"
                 "Report bugs to <zhoucheng@tsinghua.org.cn>.\n",
                 BUDDY_ORDER_MAX, MP_ORDER_DEFAULT, MP_ORDER_DEFAULT);
@@ -1035,17 +1245,25 @@ static void show_version()
 
 static int get_one_pkt(struct tsana_obj *obj)
 {
-        char *tag;
         char *pt = (char *)(obj->tbuf);
         struct ts_obj *ts = obj->ts;
         struct ts_ipt *ipt = &(ts->ipt);
         long long int data;
 
+        if(obj->is_bin) {
+                return get_bin_pkt(obj);
+        }
+        if(obj->is_frame) {
+                return get_frame_pkt(obj);
+        }
+
         if(NULL == fgets(obj->tbuf, PKT_TBUF, stdin)) {
                 return GOT_EOF;
         }
 
-        strcpy(obj->tbak, obj->tbuf); /* for dump */
+        if(obj->is_dump) {
+                strcpy(obj->tbak, obj->tbuf); /* tbuf is cut by the tag parse below */
+        }
 
         ipt->has_ts = 0;
         ipt->has_rs = 0;
@@ -1053,34 +1271,82 @@ static int get_one_pkt(struct tsana_obj *obj)
         ipt->has_mts = 0;
         ipt->has_cts = 0;
 
-        while(0 == next_tag(&tag, &pt)) {
-                if(0 == strcmp(tag, "*ts")) {
-                        next_nbyte_hex(ipt->TS, &pt, 188);
-                        ipt->has_ts = 1;
-                }
-                else if(0 == strcmp(tag, "*rs")) {
-                        next_nbyte_hex(ipt->RS, &pt, 16);
-                        ipt->has_rs = 1;
-                }
-                else if(0 == strcmp(tag, "*addr")) {
-                        next_nuint_hex(&data, &pt, 1);
-                        ipt->ADDR = data;
-                        ipt->has_addr = 1;
-                }
-                else if(0 == strcmp(tag, "*mts")) {
-                        next_nuint_hex(&data, &pt, 1);
-                        ipt->MTS = (int64_t)data;
-                        ipt->has_mts = 1;
-                }
-                else if(0 == strcmp(tag, "*cts")) {
-                        next_nuint_hex(&data, &pt, 1);
-                        ipt->CTS = (int64_t)data;
-                        ipt->has_cts = 1;
-                }
-                else {
-                        RPT(RPT_ERR, "wrong tag: \"%s\"\n", tag);
+        while(1) {
+                switch(next_tag_id(&pt)) {
+                        case IF_TAG_TS:
+                                next_nbyte_hex(ipt->TS, &pt, 188);
+                                ipt->has_ts = 1;
+                                break;
+                        case IF_TAG_RS:
+                                next_nbyte_hex(ipt->RS, &pt, 16);
+                                ipt->has_rs = 1;
+                                break;
+                        case IF_TAG_ADDR:
+                                next_nuint_hex(&data, &pt, 1);
+                                ipt->ADDR = data;
+                                ipt->has_addr = 1;
+                                break;
+                        case IF_TAG_MTS:
+                                next_nuint_hex(&data, &pt, 1);
+                                ipt->MTS = (int64_t)data;
+                                ipt->has_mts = 1;
+                                break;
+                        case IF_TAG_CTS:
+                                next_nuint_hex(&data, &pt, 1);
+                                ipt->CTS = (int64_t)data;
+                                ipt->has_cts = 1;
+                                break;
+                        case IF_TAG_BAD:
+                                break; /* skip it */
+                        default: /* IF_TAG_EOL */
+                                return GOT_RIGHT_PKT;
                 }
         }
+}
+
+static int get_bin_pkt(struct tsana_obj *obj)
+{
+        struct ts_ipt *ipt = &(obj->ts->ipt);
+        struct bin_pkt pkt;
+
+        if(0 != bin_read(obj->bin, &pkt)) {
+                return GOT_EOF;
+        }
+
+        memcpy(ipt->TS, pkt.TS, 188);
+        ipt->has_ts = 1;
+        ipt->has_rs = 0;
+        if(pkt.RS) {
+                memcpy(ipt->RS, pkt.RS, 16);
+                ipt->has_rs = 1;
+        }
+        ipt->ADDR = pkt.ADDR;
+        ipt->has_addr = 1;
+        ipt->MTS = pkt.MTS;
+        ipt->has_mts = pkt.has_mts;
+        ipt->has_cts = 0;
+        return GOT_RIGHT_PKT;
+}
+
+static int get_frame_pkt(struct tsana_obj *obj)
+{
+        struct ts_ipt *ipt = &(obj->ts->ipt);
+        struct if_frame *frm = &(obj->frm);
+
+        if(0 != frame_read(frm, stdin)) {
+                return GOT_EOF;
+        }
+
+        memcpy(ipt->TS, frm->TS, 188);
+        memcpy(ipt->RS, frm->RS, 16);
+        ipt->ADDR = frm->ADDR;
+        ipt->MTS = frm->MTS;
+        ipt->CTS = frm->CTS;
+        ipt->has_ts = ((frm->flags & IF_HAS_TS) ? 1 : 0);
+        ipt->has_rs = ((frm->flags & IF_HAS_RS) ? 1 : 0);
+        ipt->has_addr = ((frm->flags & IF_HAS_ADDR) ? 1 : 0);
+        ipt->has_mts = ((frm->flags & IF_HAS_MTS) ? 1 : 0);
+        ipt->has_cts = ((frm->flags & IF_HAS_CTS) ? 1 : 0);
         return GOT_RIGHT_PKT;
 }
 
@@ -1218,6 +1484,27 @@ static void show_pkt(struct tsana_obj *obj)
         if(ANY_PID != obj->aim_pid && ts->PID != obj->aim_pid) {
                 return;
         }
+        if(obj->is_frame) {
+                frame_write(&(obj->frm), stdout);
+                return;
+        }
+        if(obj->is_bin) {
+                struct ts_ipt *ipt = &(ts->ipt);
+
+                /* the same format as catts */
+                b2t(obj->tbak, ts->TS, 188);
+                fprintf(stdout, "*ts, %s", obj->tbak);
+                if(ipt->has_rs) {
+                        b2t(obj->tbak, ipt->RS, 16);
+                        fprintf(stdout, "*rs, %s", obj->tbak);
+                }
+                fprintf(stdout, "*addr, %llX, ", (long long int)(ipt->ADDR));
+                if(ipt->has_mts) {
+                        fprintf(stdout, "*mts, %llX, ", (long long int)(ipt->MTS));
+                }
+                fprintf(stdout, "\n");
+                return;
+        }
         fprintf(stdout, "%s", obj->tbak);
 }
 
@@ -1432,6 +1719,23 @@ static void show_pcr(struct tsana_obj *obj)
         return;
 }
 
+static void show_oj(struct tsana_obj *obj)
+{
+        struct ts_obj *ts = obj->ts;
+
+        if(ts->has_oj) {
+                fprintf(stdout, "%s*oj%s, %+9.0f, %+8.3f, ",
+                        obj->color_green, obj->color_off,
+                        (double)(ts->PCR_OJ) * 1e3 / STC_US,
+                        ts->PCR_FO);
+        }
+        else {
+                fprintf(stdout, "%s*oj%s,          ,         , ",
+                        obj->color_green, obj->color_off);
+        }
+        return;
+}
+
 static void show_pts(struct tsana_obj *obj)
 {
         struct ts_obj *ts = obj->ts;
@@ -1465,7 +1769,7 @@ static void show_tsh(struct tsana_obj *obj)
 
         fprintf(stdout, "%s*tsh%s, ",
                 obj->color_green, obj->color_off);
-        b2t(str, ts->ipt.TS, 4);
+        b2t(str, ts->TS, 4);
         fprintf(stdout, "%s", str);
         return;
 }
@@ -1477,7 +1781,7 @@ static void show_ts(struct tsana_obj *obj)
 
         fprintf(stdout, "%s*ts%s, ",
                 obj->color_green, obj->color_off);
-        b2t(str, ts->ipt.TS, 188);
+        b2t(str, ts->TS, 188);
         fprintf(stdout, "%s", str);
         return;
 }
@@ -1676,11 +1980,12 @@ static void show_si(struct tsana_obj *obj)
 static void show_rate(struct tsana_obj *obj)
 {
         struct ts_obj *ts = obj->ts;
+        struct ts_rate *rate = ts->rate_last;
         struct znode *znode;
 
         fprintf(stdout, "%s*rate%s, %.3f, ",
                 obj->color_green, obj->color_off,
-                ts->last_interval / 27000.0);
+                rate->interval / 27000.0);
         for(znode = (struct znode *)(ts->pid0); znode; znode = znode->next) {
                 struct ts_pid *pid = (struct ts_pid *)znode;
 
@@ -1722,35 +2027,36 @@ static void show_rate(struct tsana_obj *obj)
 
                 fprintf(stdout, "%s0x%04X%s, %9.6f, ",
                         obj->color_yellow, pid->PID, obj->color_off,
-                        pid->lcnt * 188.0 * 8 * 27 / (ts->last_interval));
+                        ts_rate_cnt(rate, pid->PID) * 188.0 * 8 * 27 / (rate->interval));
         }
         return;
 }
 
 static void show_rats(struct tsana_obj *obj)
 {
-        struct ts_obj *ts = obj->ts;
+        struct ts_rate *rate = obj->ts->rate_last;
 
         fprintf(stdout, "%s*rats%s, %.3f, ",
                 obj->color_green, obj->color_off,
-                ts->last_interval / 27000.0);
+                rate->interval / 27000.0);
         fprintf(stdout, "%ssys%s, %9.6f, %spsi-si%s, %9.6f, %s0x1FFF%s, %9.6f, ",
-                obj->color_yellow, obj->color_off, ts->last_sys_cnt * 188.0 * 8 * 27 / (ts->last_interval),
-                obj->color_yellow, obj->color_off, ts->last_psi_cnt * 188.0 * 8 * 27 / (ts->last_interval),
-                obj->color_yellow, obj->color_off, ts->last_nul_cnt * 188.0 * 8 * 27 / (ts->last_interval));
+                obj->color_yellow, obj->color_off, rate->sys_cnt * 188.0 * 8 * 27 / (rate->interval),
+                obj->color_yellow, obj->color_off, rate->psi_cnt * 188.0 * 8 * 27 / (rate->interval),
+                obj->color_yellow, obj->color_off, rate->nul_cnt * 188.0 * 8 * 27 / (rate->interval));
         return;
 }
 
 static void show_ratp(struct tsana_obj *obj)
 {
         struct ts_obj *ts = obj->ts;
+        struct ts_rate *rate = ts->rate_last;
         struct znode *znode;
 
         fprintf(stdout, "%s*ratp%s, %.3f, ",
                 obj->color_green, obj->color_off,
-                ts->last_interval / 27000.0);
+                rate->interval / 27000.0);
         fprintf(stdout, "%spsi-si%s, %9.6f, ",
-                obj->color_yellow, obj->color_off, ts->last_psi_cnt * 188.0 * 8 * 27 / (ts->last_interval));
+                obj->color_yellow, obj->color_off, rate->psi_cnt * 188.0 * 8 * 27 / (rate->interval));
 
         for(znode = (struct znode *)(ts->pid0); znode; znode = znode->next) {
                 struct ts_pid *pid_item = (struct ts_pid *)znode;
@@ -1763,7 +2069,7 @@ static void show_ratp(struct tsana_obj *obj)
                 /* without PMT */
                 fprintf(stdout, "%s0x%04X%s, %9.6f, ",
                         obj->color_yellow, pid_item->PID, obj->color_off,
-                        pid_item->lcnt * 188.0 * 8 * 27 / (ts->last_interval));
+                        ts_rate_cnt(rate, pid_item->PID) * 188.0 * 8 * 27 / (rate->interval));
         }
         return;
 }
@@ -1848,16 +2154,102 @@ static int show_error(struct tsana_obj *obj)
                 err->PTS_error = 0;
         }
         if(err->CAT_error) {
-                fprintf(stdout, "2.6 , CAT, ");
+                if((1<<0) & err->CAT_error) {
+                        fprintf(stdout, "2.6 , CAT(scrambled packet without CAT), ");
+                }
+                if((1<<1) & err->CAT_error) {
+                        fprintf(stdout, "2.6 , CAT(table_id != 0x01), ");
+                }
                 err->CAT_error = 0;
         }
 
         /* Third priority: application dependant monitoring */
-        /* ... */
+        if(err->NIT_actual_error) {
+                fprintf(stdout, "3.1a, NIT_actual, ");
+        }
+        if(err->NIT_other_error) {
+                fprintf(stdout, "3.1b, NIT_other, ");
+        }
+        if(err->SI_repetition_error) {
+                fprintf(stdout, "3.2 , SI_repetition, ");
+        }
+        if(err->Buffer_error) {
+                fprintf(stdout, "3.3 , Buffer(TB_n overflow), ");
+        }
+        if(err->Unreferenced_PID) {
+                fprintf(stdout, "3.4 , Unreferenced_PID, ");
+        }
+        if(err->Unreferenced_PID_2) {
+                fprintf(stdout, "3.4a, Unreferenced_PID_2, ");
+        }
+        if(err->SDT_actual_error) {
+                fprintf(stdout, "3.5a, SDT_actual, ");
+        }
+        if(err->SDT_other_error) {
+                fprintf(stdout, "3.5b, SDT_other, ");
+        }
+        if(err->EIT_actual_error) {
+                fprintf(stdout, "3.6a, EIT_actual, ");
+        }
+        if(err->EIT_other_error) {
+                fprintf(stdout, "3.6b, EIT_other, ");
+        }
+        if(err->EIT_PF_error) {
+                fprintf(stdout, "3.6c, EIT_PF, ");
+        }
+        if(err->RST_error) {
+                fprintf(stdout, "3.7 , RST, ");
+        }
+        if(err->TDT_error) {
+                fprintf(stdout, "3.8 , TDT, ");
+        }
+        if(err->Empty_buffer_error) {
+                fprintf(stdout, "3.9 , Empty_buffer, ");
+        }
+        if(err->Data_delay_error) {
+                fprintf(stdout, "3.10, Data_delay(%+7.3f ms), ",
+                        (double)(ts->DTS_minus_STC) / STC_BASE_MS);
+        }
 
         return 0;
 }
 
+/* clear the error kept until reported, see show_error() */
+static void clear_error(struct tsana_obj *obj)
+{
+        struct ts_err *err = &(obj->ts->err);
+
+        err->PAT_error = 0;
+        err->PMT_error = 0;
+        err->PID_error = 0;
+        err->Transport_error = 0;
+        err->CRC_error = 0;
+        err->PCR_repetition_error = 0;
+        err->PCR_discontinuity_indicator_error = 0;
+        err->PCR_accuracy_error = 0;
+        err->PTS_error = 0;
+        err->CAT_error = 0;
+        err->NIT_error = 0;
+        err->NIT_actual_error = 0;
+        err->NIT_other_error = 0;
+        err->SI_repetition_error = 0;
+        err->Buffer_error = 0;
+        err->Unreferenced_PID = 0;
+        err->Unreferenced_PID_2 = 0;
+        err->SDT_error = 0;
+        err->SDT_actual_error = 0;
+        err->SDT_other_error = 0;
+        err->EIT_error = 0;
+        err->EIT_actual_error = 0;
+        err->EIT_other_error = 0;
+        err->EIT_PF_error = 0;
+        err->RST_error = 0;
+        err->TDT_error = 0;
+        err->Empty_buffer_error = 0;
+        err->Data_delay_error = 0;
+        return;
+}
+
 static void table_info_PAT(struct ts_sect *psi, uint8_t *section)
 {
         uint8_t *p = section + 3;
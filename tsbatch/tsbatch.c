@@ -0,0 +1,738 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: tsbatch.c
+ * funx: analyse many TS files with a pool of worker threads, one report line for each file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* for strcmp(), etc */
+#include <stdarg.h> /* for va_list, etc */
+#include <time.h> /* for clock_gettime(), etc */
+#include <pthread.h> /* for pthread_create(), etc */
+#include <dirent.h> /* for opendir(), etc */
+#include <sys/stat.h> /* for stat(), etc */
+#include <unistd.h> /* for sysconf() */
+
+#include "config.h" /* for SYS_* macro, generated by configure */
+
+#include "tstool_config.h"
+#include "common.h"
+#include "bin.h"
+#include "buddy.h"
+#include "ts.h"
+
+static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
+
+#define MP_ORDER_DEFAULT ((size_t)20) /* memory pool arena size of each worker: (1 << MP_ORDER_DEFAULT) */
+#define WORKER_MAX                      (256) /* max worker thread */
+#define BATCH_SIZE                      (256) /* packet for each ts_parse_batch() */
+#define NAME_MAX_LEN                    (4096) /* max length of file name in list */
+#define STC_MS                          (27 * 1000) /* uint: do NOT use 1e3  */
+
+/* report line in memory, print it in file order */
+struct text {
+        char *buf;
+        size_t len;
+        size_t size;
+};
+
+struct job {
+        char *name; /* file name */
+        char *txt; /* report line, NULL if not done */
+        int is_done;
+
+        /* for the total line */
+        int is_fail;
+        int64_t pkt;
+        int64_t byte;
+        int64_t err[TS_ERR_MAX];
+};
+
+struct worker {
+        pthread_t tid;
+        struct tsbatch_obj *obj;
+
+        /* sum of closed rate window of current file */
+        int64_t dur; /* 27MHz clock */
+        int64_t cnt[0x2000]; /* packet of each PID */
+        double rate_min; /* Mbps, -1 if no rate window */
+        double rate_max; /* Mbps */
+};
+
+struct tsbatch_obj {
+        intptr_t mp; /* buddy memory pool shared by workers */
+        size_t mp_order;
+        int crc_sample; /* check CRC_32 of 1 in crc_sample repeated section */
+        int worker_cnt;
+        struct worker *worker;
+
+        int cnt; /* count of job */
+        int size; /* size of job[] */
+        struct job *job;
+        int next; /* next job for worker */
+        pthread_mutex_t lock; /* for next and job[].is_done */
+        pthread_cond_t done; /* signal when one job is done */
+};
+
+static struct tsbatch_obj *create(int argc, char *argv[]);
+static int destroy(struct tsbatch_obj *obj);
+static int add_path(struct tsbatch_obj *obj, const char *path);
+static int add_dir(struct tsbatch_obj *obj, const char *path);
+static int add_list(struct tsbatch_obj *obj, const char *list);
+static int add_job(struct tsbatch_obj *obj, const char *name);
+static int cmp_job(const void *a, const void *b);
+
+static void *worker_thread(void *arg);
+static void analyse(struct worker *w, struct job *job);
+static void report(struct worker *w, struct job *job, struct ts_obj *ts, struct text *txt);
+static void on_rate(struct ts_obj *ts, int evt, void *arg);
+static void add_text(struct text *txt, const char *fmt, ...);
+static int64_t now_ms(void);
+
+static void show_help();
+static void show_version();
+
+int main(int argc, char *argv[])
+{
+        struct tsbatch_obj *obj;
+        int i;
+        int k;
+        int n;
+        int fail = 0;
+        int rslt = 0;
+        int64_t pkt = 0;
+        int64_t byte = 0;
+        int64_t err[TS_ERR_MAX];
+        int64_t t0;
+        double t;
+
+        obj = create(argc, argv);
+        if(!obj) {
+                return -1;
+        }
+        t0 = now_ms();
+
+        for(n = 0; n < obj->worker_cnt; n++) {
+                struct worker *w = &(obj->worker[n]);
+
+                if(0 != pthread_create(&(w->tid), NULL, worker_thread, w)) {
+                        RPT(RPT_ERR, "create worker thread failed");
+                        break;
+                }
+        }
+        if(0 == n) {
+                rslt = -1;
+                goto main_return;
+        }
+
+        /* print report line in file order, as soon as it is ready */
+        memset(err, 0, sizeof(err));
+        for(i = 0; i < obj->cnt; i++) {
+                struct job *job = &(obj->job[i]);
+
+                pthread_mutex_lock(&(obj->lock));
+                while(!(job->is_done)) {
+                        pthread_cond_wait(&(obj->done), &(obj->lock));
+                }
+                pthread_mutex_unlock(&(obj->lock));
+
+                fputs(job->txt, stdout);
+                free(job->txt);
+                job->txt = NULL;
+
+                fail += job->is_fail;
+                pkt += job->pkt;
+                byte += job->byte;
+                for(k = 0; k < TS_ERR_MAX; k++) {
+                        err[k] += job->err[k];
+                }
+        }
+
+        while(n--) {
+                pthread_join(obj->worker[n].tid, NULL);
+        }
+
+        t = (now_ms() - t0) / 1000.0;
+        fprintf(stdout, "*total, %d, *fail, %d, *pkt, %lld, *err, ",
+                obj->cnt, fail, (long long int)pkt);
+        for(k = 0; k < TS_ERR_MAX; k++) {
+                fprintf(stdout, "%lld, ", (long long int)(err[k]));
+        }
+        fprintf(stdout, "*time, %.3f, *speed, %.3f, \n",
+                t, ((t > 0) ? (byte / t / 1e6) : 0.0));
+
+main_return:
+        destroy(obj);
+        return rslt;
+}
+
+static struct tsbatch_obj *create(int argc, char *argv[])
+{
+        int i;
+        int dat;
+        struct tsbatch_obj *obj;
+
+        obj = (struct tsbatch_obj *)malloc(sizeof(struct tsbatch_obj));
+        if(NULL == obj) {
+                RPT(RPT_ERR, "malloc failed");
+                return NULL;
+        }
+
+        obj->mp = 0;
+        obj->mp_order = MP_ORDER_DEFAULT;
+        obj->crc_sample = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+        obj->worker_cnt = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+        obj->worker_cnt = 1;
+#endif
+        if(obj->worker_cnt < 1) {
+                obj->worker_cnt = 1;
+        }
+        if(obj->worker_cnt > WORKER_MAX) {
+                obj->worker_cnt = WORKER_MAX;
+        }
+        obj->worker = NULL;
+        obj->cnt = 0;
+        obj->size = 0;
+        obj->job = NULL;
+        obj->next = 0;
+
+        if(1 == argc) {
+                /* no parameter */
+                fprintf(stderr, "No file to process...\n\n");
+                show_help();
+                goto create_failed_with_obj;
+        }
+
+        for(i = 1; i < argc; i++) {
+                if('-' == argv[i][0]) {
+                        if(0 == strcmp(argv[i], "-j")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-j'!\n");
+                                        goto create_failed_with_job;
+                                }
+                                sscanf(argv[i], "%i" , &dat);
+                                if(dat < 1 || dat > WORKER_MAX) {
+                                        fprintf(stderr, "bad variable for '-j': %d, use %d instead!\n",
+                                                dat, obj->worker_cnt);
+                                        dat = obj->worker_cnt;
+                                }
+                                obj->worker_cnt = dat;
+                        }
+                        else if(0 == strcmp(argv[i], "-l")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-l'!\n");
+                                        goto create_failed_with_job;
+                                }
+                                if(0 != add_list(obj, argv[i])) {
+                                        goto create_failed_with_job;
+                                }
+                        }
+                        else if(0 == strcmp(argv[i], "-mp")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-mp'!\n");
+                                        goto create_failed_with_job;
+                                }
+                                sscanf(argv[i], "%i" , &dat);
+                                if(dat < 12 || dat > 30) {
+                                        fprintf(stderr, "bad variable for '-mp': %d, use %zu instead!\n",
+                                                dat, MP_ORDER_DEFAULT);
+                                        dat = MP_ORDER_DEFAULT;
+                                }
+                                obj->mp_order = dat;
+                        }
+                        else if(0 == strcmp(argv[i], "-crc")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-crc'!\n");
+                                        goto create_failed_with_job;
+                                }
+                                sscanf(argv[i], "%i" , &dat);
+                                if(dat < 0) {
+                                        fprintf(stderr, "bad variable for '-crc': %d, use 1 instead!\n", dat);
+                                        dat = 1;
+                                }
+                                obj->crc_sample = dat;
+                        }
+                        else if(0 == strcmp(argv[i], "-h") ||
+                                0 == strcmp(argv[i], "--help")) {
+                                show_help();
+                                goto create_failed_with_job;
+                        }
+                        else if(0 == strcmp(argv[i], "-v") ||
+                                0 == strcmp(argv[i], "--version")) {
+                                show_version();
+                                goto create_failed_with_job;
+                        }
+                        else {
+                                fprintf(stderr, "Wrong parameter: %s\n", argv[i]);
+                                goto create_failed_with_job;
+                        }
+                }
+                else {
+                        if(0 != add_path(obj, argv[i])) {
+                                goto create_failed_with_job;
+                        }
+                }
+        }
+
+        if(0 == obj->cnt) {
+                fprintf(stderr, "No file to process...\n");
+                goto create_failed_with_job;
+        }
+
+        /* no idle worker */
+        if(obj->worker_cnt > obj->cnt) {
+                obj->worker_cnt = obj->cnt;
+        }
+
+        obj->worker = (struct worker *)calloc(obj->worker_cnt, sizeof(struct worker));
+        if(NULL == obj->worker) {
+                RPT(RPT_ERR, "malloc failed");
+                goto create_failed_with_job;
+        }
+        pthread_mutex_init(&(obj->lock), NULL);
+        pthread_cond_init(&(obj->done), NULL);
+        for(i = 0; i < obj->worker_cnt; i++) {
+                obj->worker[i].obj = obj;
+        }
+
+        /* one pool for all workers, arena is added and returned as files come and go */
+        obj->mp = buddy_create_mt(obj->mp_order, 6);
+        if(0 == obj->mp) {
+                RPT(RPT_ERR, "malloc memory pool failed");
+                destroy(obj);
+                return NULL;
+        }
+        buddy_init(obj->mp);
+        return obj;
+
+create_failed_with_job:
+        destroy(obj);
+        return NULL;
+create_failed_with_obj:
+        free(obj);
+        return NULL;
+}
+
+static int destroy(struct tsbatch_obj *obj)
+{
+        int i;
+
+        if(NULL == obj) {
+                return 0;
+        }
+
+        if(obj->mp) {
+                buddy_destroy(obj->mp);
+        }
+        if(obj->worker) {
+                free(obj->worker);
+                pthread_mutex_destroy(&(obj->lock));
+                pthread_cond_destroy(&(obj->done));
+        }
+        for(i = 0; i < obj->cnt; i++) {
+                free(obj->job[i].name);
+                free(obj->job[i].txt);
+        }
+        free(obj->job);
+        free(obj);
+        return 1;
+}
+
+/* file, or all regular file in directory */
+static int add_path(struct tsbatch_obj *obj, const char *path)
+{
+        struct stat st;
+
+        if(0 == stat(path, &st) && S_ISDIR(st.st_mode)) {
+                return add_dir(obj, path);
+        }
+        return add_job(obj, path); /* bad file is reported by worker */
+}
+
+/* regular file in dir, sorted by name, not recursive */
+static int add_dir(struct tsbatch_obj *obj, const char *path)
+{
+        DIR *dir;
+        struct dirent *ent;
+        struct stat st;
+        char *name;
+        int cnt0 = obj->cnt;
+        int rslt = 0;
+
+        dir = opendir(path);
+        if(NULL == dir) {
+                RPT(RPT_ERR, "open directory \"%s\" failed", path);
+                return -1;
+        }
+
+        while(NULL != (ent = readdir(dir))) {
+                if('.' == ent->d_name[0]) {
+                        continue; /* ".", ".." and hidden file */
+                }
+                name = (char *)malloc(strlen(path) + strlen(ent->d_name) + 2);
+                if(NULL == name) {
+                        RPT(RPT_ERR, "malloc failed");
+                        rslt = -1;
+                        break;
+                }
+                sprintf(name, "%s/%s", path, ent->d_name);
+                if(0 == stat(name, &st) && S_ISREG(st.st_mode)) {
+                        rslt = add_job(obj, name);
+                }
+                free(name);
+                if(0 != rslt) {
+                        break;
+                }
+        }
+        closedir(dir);
+
+        qsort(obj->job + cnt0, obj->cnt - cnt0, sizeof(struct job), cmp_job);
+        return rslt;
+}
+
+/* one path in each line, "-" for stdin */
+static int add_list(struct tsbatch_obj *obj, const char *list)
+{
+        FILE *fd;
+        char line[NAME_MAX_LEN];
+        size_t len;
+        int rslt = 0;
+
+        if(0 == strcmp(list, "-")) {
+                fd = stdin;
+        }
+        else {
+                fd = fopen(list, "r");
+                if(NULL == fd) {
+                        RPT(RPT_ERR, "open list \"%s\" failed", list);
+                        return -1;
+                }
+        }
+
+        while(0 == rslt && NULL != fgets(line, NAME_MAX_LEN, fd)) {
+                len = strlen(line);
+                while(len && ('\n' == line[len - 1] || '\r' == line[len - 1])) {
+                        line[--len] = '\0';
+                }
+                if(0 == len) {
+                        continue;
+                }
+                rslt = add_path(obj, line);
+        }
+
+        if(stdin != fd) {
+                fclose(fd);
+        }
+        return rslt;
+}
+
+static int add_job(struct tsbatch_obj *obj, const char *name)
+{
+        struct job *job;
+
+        if(obj->cnt >= obj->size) {
+                int size = (obj->size ? (obj->size * 2) : 64);
+
+                job = (struct job *)realloc(obj->job, size * sizeof(struct job));
+                if(NULL == job) {
+                        RPT(RPT_ERR, "malloc failed");
+                        return -1;
+                }
+                obj->job = job;
+                obj->size = size;
+        }
+
+        job = &(obj->job[obj->cnt]);
+        memset(job, 0, sizeof(struct job));
+        job->name = strdup(name);
+        if(NULL == job->name) {
+                RPT(RPT_ERR, "malloc failed");
+                return -1;
+        }
+        obj->cnt++;
+        return 0;
+}
+
+static int cmp_job(const void *a, const void *b)
+{
+        return strcmp(((const struct job *)a)->name, ((const struct job *)b)->name);
+}
+
+/* take the next file until no more */
+static void *worker_thread(void *arg)
+{
+        struct worker *w = (struct worker *)arg;
+        struct tsbatch_obj *obj = w->obj;
+        struct job *job;
+
+        while(1) {
+                pthread_mutex_lock(&(obj->lock));
+                if(obj->next >= obj->cnt) {
+                        pthread_mutex_unlock(&(obj->lock));
+                        break;
+                }
+                job = &(obj->job[obj->next]);
+                obj->next++;
+                pthread_mutex_unlock(&(obj->lock));
+
+                analyse(w, job);
+
+                pthread_mutex_lock(&(obj->lock));
+                job->is_done = 1;
+                pthread_cond_signal(&(obj->done));
+                pthread_mutex_unlock(&(obj->lock));
+        }
+        return NULL;
+}
+
+/* the whole file with one ts_obj, regular file is mapped and read in sequence */
+static void analyse(struct worker *w, struct job *job)
+{
+        struct tsbatch_obj *obj = w->obj;
+        struct text txt = {NULL, 0, 0};
+        intptr_t bin;
+        struct ts_obj *ts;
+        struct ts_cfg cfg;
+        uint8_t *TS;
+        int64_t ADDR[BATCH_SIZE];
+        int64_t MTS[BATCH_SIZE];
+        int type;
+        int n;
+
+        add_text(&txt, "*file, %s, ", job->name);
+        job->is_fail = 1;
+
+        bin = bin_open(job->name);
+        if(0 == bin) {
+                goto analyse_return;
+        }
+
+        ts = ts_create(obj->mp); /* ts_destroy() returns all of it to the shared pool */
+        if(NULL == ts) {
+                RPT(RPT_ERR, "malloc ts object for \"%s\" failed", job->name);
+                goto analyse_failed_with_bin;
+        }
+        memset(&cfg, 1, sizeof(struct ts_cfg));
+        cfg.crc_sample = ((0 == obj->crc_sample) ? -1 : obj->crc_sample); /* -crc 0: never */
+        ts_ioctl(ts, TS_INIT, 0);
+        ts_ioctl(ts, TS_SCFG, (intptr_t)&cfg);
+        ts->aim_interval = 1000 * STC_MS;
+        ts_event(ts, TS_EVT_RATE, on_rate, w);
+
+        w->dur = 0;
+        memset(w->cnt, 0, sizeof(w->cnt));
+        w->rate_min = -1.0;
+        w->rate_max = 0.0;
+
+        job->is_fail = 0;
+        while(0 != (n = bin_read_batch(bin, &TS, BATCH_SIZE, ADDR, MTS))) {
+                /* bin_type() is known after the first read */
+                type = bin_type(bin);
+                if(0 != ts_parse_batch(ts, TS, n, type, ADDR,
+                                       ((BIN_TYPE_MTS == type) ? MTS : NULL), NULL, NULL)) {
+                        RPT(RPT_ERR, "parse \"%s\" failed", job->name);
+                        job->is_fail = 1; /* report what is parsed, but as a failed file */
+                        break;
+                }
+                job->pkt += n;
+                job->byte += (int64_t)n * type;
+        }
+
+        memcpy(job->err, ts->err.cnt, sizeof(job->err));
+        report(w, job, ts, &txt);
+        ts_destroy(ts);
+
+analyse_failed_with_bin:
+        bin_close(bin);
+analyse_return:
+        if(job->is_fail) {
+                add_text(&txt, "*fail, ");
+        }
+        add_text(&txt, "\n");
+        job->txt = txt.buf;
+        return;
+}
+
+static void report(struct worker *w, struct job *job, struct ts_obj *ts, struct text *txt)
+{
+        struct znode *znode;
+        int64_t cnt = 0;
+        double k;
+        int i;
+
+        /* Mbps of packet count in closed rate window */
+        k = ((w->dur > 0) ? (188.0 * 8 * 27 / w->dur) : 0.0);
+        for(i = 0; i < 0x2000; i++) {
+                cnt += w->cnt[i];
+        }
+
+        add_text(txt, "*pkt, %lld, *dur, %.3f, *rate, %.6f, %.6f, %.6f, ",
+                 (long long int)(job->pkt), w->dur / (1000.0 * STC_MS),
+                 cnt * k, ((w->rate_min < 0) ? 0.0 : w->rate_min), w->rate_max);
+
+        add_text(txt, "*err, ");
+        for(i = 0; i < TS_ERR_MAX; i++) {
+                add_text(txt, "%lld, ", (long long int)(job->err[i]));
+        }
+
+        if(ts->has_got_transport_stream_id) {
+                add_text(txt, "*tsid, 0x%04X, ", ts->transport_stream_id);
+        }
+        for(znode = (struct znode *)(ts->prog0); znode; znode = znode->next) {
+                struct ts_prog *prog = (struct ts_prog *)znode;
+                struct znode *enode;
+
+                add_text(txt, "*prog, %d, 0x%04X, 0x%04X, ",
+                         prog->program_number, prog->PMT_PID, prog->PCR_PID);
+                for(enode = (struct znode *)(prog->elem0); enode; enode = enode->next) {
+                        struct ts_elem *elem = (struct ts_elem *)enode;
+
+                        add_text(txt, "*elem, 0x%04X, 0x%02X, ", elem->PID, elem->stream_type);
+                }
+        }
+
+        for(znode = (struct znode *)(ts->pid0); znode; znode = znode->next) {
+                struct ts_pid *pid = (struct ts_pid *)znode;
+
+                add_text(txt, "*pid, 0x%04X, 0x%04X, %.6f, ",
+                         pid->PID, pid->type, w->cnt[pid->PID] * k);
+        }
+        return;
+}
+
+/* sum of each rate window */
+static void on_rate(struct ts_obj *ts, int evt, void *arg)
+{
+        struct worker *w = (struct worker *)arg;
+        struct ts_rate *rate = ts->rate_last;
+        struct znode *znode;
+        int64_t cnt = 0;
+        double mbps;
+
+        if(rate->interval <= 0) {
+                return;
+        }
+        for(znode = (struct znode *)(ts->pid0); znode; znode = znode->next) {
+                struct ts_pid *pid = (struct ts_pid *)znode;
+                uint32_t n = ts_rate_cnt(rate, pid->PID);
+
+                w->cnt[pid->PID] += n;
+                cnt += n;
+        }
+        w->dur += rate->interval;
+
+        mbps = cnt * 188.0 * 8 * 27 / rate->interval;
+        if(w->rate_min < 0 || mbps < w->rate_min) {
+                w->rate_min = mbps;
+        }
+        if(mbps > w->rate_max) {
+                w->rate_max = mbps;
+        }
+        return;
+}
+
+static void add_text(struct text *txt, const char *fmt, ...)
+{
+        va_list ap;
+        int len;
+        size_t size;
+        char *buf;
+
+        while(1) {
+                va_start(ap, fmt);
+                len = vsnprintf(txt->buf + txt->len, txt->size - txt->len, fmt, ap);
+                va_end(ap);
+                if(len < 0) {
+                        return;
+                }
+                if(txt->len + len < txt->size) {
+                        txt->len += len;
+                        return;
+                }
+
+                /* not enough room, make it bigger and try again */
+                size = (txt->size ? txt->size * 2 : 1024);
+                while(size <= txt->len + len) {
+                        size *= 2;
+                }
+                buf = (char *)realloc(txt->buf, size);
+                if(NULL == buf) {
+                        RPT(RPT_ERR, "malloc failed");
+                        return;
+                }
+                txt->buf = buf;
+                txt->size = size;
+        }
+}
+
+static int64_t now_ms(void)
+{
+        struct timespec tp;
+
+        clock_gettime(CLOCK_MONOTONIC, &tp);
+        return (int64_t)(tp.tv_sec) * 1000 + tp.tv_nsec / 1000000;
+}
+
+static void show_help()
+{
+        puts("'tsbatch' analyse many TS files with a pool of worker threads, one report line for each file to stdout.");
+        puts("");
+        puts("Usage: tsbatch [OPTION]... [FILE|DIR]...");
+        puts("");
+        puts("Options:");
+        puts("");
+        puts(" -j <n>           worker thread, default: count of online CPU, [1, 256]");
+        puts(" -l <list>        read FILE or DIR from list, one in each line, '-' for stdin");
+        puts(" -mp <order>      arena size of memory pool shared by workers: 2^order byte, default: 20, [12, 30]");
+        puts(" -crc <n>         check CRC_32 of 1 in n repeated section, 0: never, default: 1");
+        puts(" -h, --help       print this information only");
+        puts(" -v, --version    print my version only");
+        puts("");
+        puts("DIR means each regular file in it, sorted by name, not recursive.");
+        puts("");
+        puts("Report for each file, in the order of FILE:");
+        puts("  \"*file, name, *pkt, count, *dur, second, *rate, avg, min, max, \"");
+        puts("      bitrate(Mbps) in 1s window after PCR is OK");
+        puts("  \"*err, 1.1, 1.2, 1.3, 1.4, 1.5, 1.6, 2.1, 2.2, 2.3a, 2.3b, 2.4, 2.5, 2.6, \"");
+        puts("  \"      3.1a, 3.1b, 3.2, 3.3, 3.4, 3.4a, 3.5a, 3.5b, 3.6a, 3.6b, 3.6c, 3.7, 3.8, 3.9, 3.10, \"");
+        puts("      packet count of each TR 101 290 error");
+        puts("  \"*tsid, transport_stream_id, \"");
+        puts("  \"*prog, program_number, PMT_PID, PCR_PID, \" for each program, followed by");
+        puts("  \"*elem, PID, stream_type, \" for each elementary stream of the program");
+        puts("  \"*pid, PID, type, bitrate(Mbps), \" for each PID, type is TS_TYPE_xxx of libzts");
+        puts("  \"*fail, \" if the file can not be opened");
+        puts("Then the total line:");
+        puts("  \"*total, file, *fail, file, *pkt, count, *err, ..., *time, second, *speed, MB/s, \"");
+        puts("");
+        puts("Examples:");
+        puts("  tsbatch /data/rec");
+        puts("  find /data -name '*.ts' | tsbatch -j 8 -l -");
+        puts("");
+        puts("Report bugs to <zhoucheng@tsinghua.org.cn>.");
+        return;
+}
+
+static void show_version()
+{
+        char str[100];
+
+        sprintf(str, "tsbatch of tstools v%s (%s)", VERSION_STR, REVISION);
+        puts(str);
+        sprintf(str, "Build time: %s %s", __DATE__, __TIME__);
+        puts(str);
+        puts("");
+        puts("Copyright (C) 2009,2010,2011,2012,2013 ZHOU Cheng.");
+        puts("License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>");
+        puts("This is free software; contact author for additional information.");
+        puts("There is NO warranty; not even for MERCHANTABILITY or FITNESS FOR");
+        puts("A PARTICULAR PURPOSE.");
+        puts("");
+        puts("Written by ZHOU Cheng.");
+        return;
+}
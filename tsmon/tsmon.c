@@ -0,0 +1,420 @@
+/* vim: set tabstop=8 shiftwidth=8:
+ * name: tsmon.c
+ * funx: monitor many TS over IP in one process, report error and bit-rate
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* for strcmp(), etc */
+#include <signal.h> /* for signal() */
+#include <time.h> /* for clock_gettime(), etc */
+
+#include "config.h" /* for SYS_* macro, generated by configure */
+
+#ifdef SYS_LINUX
+#include <sys/epoll.h> /* for epoll_wait(), etc */
+#include <unistd.h> /* for close() */
+#endif
+
+#include "tstool_config.h"
+#include "common.h"
+#include "url.h"
+#include "buddy.h"
+#include "ts.h"
+
+static int rpt_lvl = RPT_WRN; /* report level: ERR, WRN, INF, DBG */
+
+#define MP_ORDER_DEFAULT ((size_t)20) /* memory pool arena size of each stream: (1 << MP_ORDER_DEFAULT) */
+#define STREAM_MAX                      (1024) /* max stream in one process */
+#define EVENT_MAX                       (64) /* events for each epoll_wait() */
+#define STC_MS                          (27 * 1000) /* uint: do NOT use 1e3  */
+
+struct stream {
+        char *name; /* URL string */
+        struct url *url;
+        intptr_t mp; /* buddy memory pool of this stream */
+        struct ts_obj *ts;
+
+        int64_t byte; /* bytes in this report interval */
+        int64_t drop; /* bytes not in 188-byte packet */
+        int64_t lcnt[TS_ERR_MAX]; /* ts->err.cnt[] of last report */
+};
+
+struct tsmon_obj {
+        int interval; /* report interval(ms) */
+        size_t mp_order;
+        int crc_sample; /* check CRC_32 of 1 in crc_sample repeated section */
+        int cnt; /* count of stream */
+        struct stream stream[STREAM_MAX];
+};
+
+static volatile int is_exit = 0;
+
+static struct tsmon_obj *create(int argc, char *argv[]);
+static int destroy(struct tsmon_obj *obj);
+static int open_stream(struct tsmon_obj *obj, struct stream *s);
+static int close_stream(struct stream *s);
+static int recv_stream(struct stream *s);
+static void report(struct tsmon_obj *obj, double interval);
+static int64_t now_ms(void);
+static void on_signal(int sig);
+
+static void show_help();
+static void show_version();
+
+int main(int argc, char *argv[])
+{
+        struct tsmon_obj *obj;
+
+        obj = create(argc, argv);
+        if(!obj) {
+                return -1;
+        }
+
+#ifdef SYS_LINUX
+        int i;
+        int n;
+        int epfd;
+        int64_t last;
+        int64_t now;
+        struct epoll_event ev;
+        struct epoll_event events[EVENT_MAX];
+
+        epfd = epoll_create(obj->cnt);
+        if(epfd < 0) {
+                RPT(RPT_ERR, "epoll_create failed");
+                goto main_return;
+        }
+        for(i = 0; i < obj->cnt; i++) {
+                struct stream *s = &(obj->stream[i]);
+
+                ev.events = EPOLLIN;
+                ev.data.ptr = s;
+                if(0 != epoll_ctl(epfd, EPOLL_CTL_ADD, udp_fd(s->url->udp), &ev)) {
+                        RPT(RPT_ERR, "epoll_ctl for \"%s\" failed", s->name);
+                        goto main_close;
+                }
+        }
+
+        signal(SIGINT, on_signal);
+        signal(SIGTERM, on_signal);
+
+        last = now_ms();
+        while(!is_exit) {
+                now = now_ms();
+                if(now - last >= obj->interval) {
+                        report(obj, (double)(now - last) / 1000.0);
+                        last = now;
+                }
+
+                n = epoll_wait(epfd, events, EVENT_MAX, (int)(last + obj->interval - now));
+                for(i = 0; i < n; i++) {
+                        recv_stream((struct stream *)(events[i].data.ptr));
+                }
+        }
+
+main_close:
+        close(epfd);
+main_return:
+#else
+        RPT(RPT_ERR, "tsmon need epoll, only for linux now");
+#endif
+        destroy(obj);
+        return 0;
+}
+
+/* get all datagram in socket buffer, parse TS packets in them directly */
+static int recv_stream(struct stream *s)
+{
+        uint8_t *buf;
+        int len;
+        int off;
+        int n;
+
+        while(0 < (len = udp_get(s->url->udp, &buf, NULL, 0))) {
+                s->byte += len;
+
+                /* datagram should be N * 188-byte TS packets */
+                off = 0;
+                while(off < len && 0x47 != buf[off]) {
+                        off++;
+                }
+                n = (len - off) / 188;
+                s->drop += len - n * 188;
+                if(0 == n) {
+                        continue;
+                }
+
+                ts_parse_batch(s->ts, buf + off, n, 188, NULL, NULL, NULL, NULL); /* error is counted in libzts */
+        }
+        return len;
+}
+
+/* one line for each stream, then clear the count */
+static void report(struct tsmon_obj *obj, double interval)
+{
+        int i;
+
+        for(i = 0; i < obj->cnt; i++) {
+                struct stream *s = &(obj->stream[i]);
+                int64_t *cnt = s->ts->err.cnt;
+                int k;
+
+                fprintf(stdout, "*mon, %s, ", s->name);
+                fprintf(stdout, "*rate, %.3f, %.6f, ", interval * 1000.0, s->byte * 8 / interval / 1e6);
+                fprintf(stdout, "*err, ");
+                for(k = 0; k < TS_ERR_MAX; k++) {
+                        fprintf(stdout, "%lld, ", (long long int)(cnt[k] - s->lcnt[k]));
+                        s->lcnt[k] = cnt[k];
+                }
+                if(s->drop) {
+                        fprintf(stdout, "*drop, %lld, ", (long long int)(s->drop));
+                }
+                fprintf(stdout, "\n");
+
+                s->byte = 0;
+                s->drop = 0;
+        }
+        fflush(stdout);
+        return;
+}
+
+static struct tsmon_obj *create(int argc, char *argv[])
+{
+        int i;
+        int dat;
+        struct tsmon_obj *obj;
+
+        obj = (struct tsmon_obj *)malloc(sizeof(struct tsmon_obj));
+        if(NULL == obj) {
+                RPT(RPT_ERR, "malloc failed");
+                return NULL;
+        }
+
+        obj->interval = 1000;
+        obj->mp_order = MP_ORDER_DEFAULT;
+        obj->crc_sample = 1;
+        obj->cnt = 0;
+
+        if(1 == argc) {
+                /* no parameter */
+                fprintf(stderr, "No URL to process...\n\n");
+                show_help();
+                goto create_failed_with_obj;
+        }
+
+        for(i = 1; i < argc; i++) {
+                if('-' == argv[i][0]) {
+                        if(0 == strcmp(argv[i], "-interval")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-interval'!\n");
+                                        goto create_failed_with_obj;
+                                }
+                                sscanf(argv[i], "%i" , &dat);
+                                if(dat < 1) {
+                                        fprintf(stderr, "bad variable for '-interval': %d, use 1000 instead!\n", dat);
+                                        dat = 1000;
+                                }
+                                obj->interval = dat;
+                        }
+                        else if(0 == strcmp(argv[i], "-mp")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-mp'!\n");
+                                        goto create_failed_with_obj;
+                                }
+                                sscanf(argv[i], "%i" , &dat);
+                                if(dat < 12 || dat > 30) {
+                                        fprintf(stderr, "bad variable for '-mp': %d, use %zu instead!\n",
+                                                dat, MP_ORDER_DEFAULT);
+                                        dat = MP_ORDER_DEFAULT;
+                                }
+                                obj->mp_order = dat;
+                        }
+                        else if(0 == strcmp(argv[i], "-crc")) {
+                                i++;
+                                if(i >= argc) {
+                                        fprintf(stderr, "no parameter for '-crc'!\n");
+                                        goto create_failed_with_obj;
+                                }
+                                sscanf(argv[i], "%i" , &dat);
+                                if(dat < 0) {
+                                        fprintf(stderr, "bad variable for '-crc': %d, use 1 instead!\n", dat);
+                                        dat = 1;
+                                }
+                                obj->crc_sample = dat;
+                        }
+                        else if(0 == strcmp(argv[i], "-h") ||
+                                0 == strcmp(argv[i], "--help")) {
+                                show_help();
+                                goto create_failed_with_obj;
+                        }
+                        else if(0 == strcmp(argv[i], "-v") ||
+                                0 == strcmp(argv[i], "--version")) {
+                                show_version();
+                                goto create_failed_with_obj;
+                        }
+                        else {
+                                fprintf(stderr, "Wrong parameter: %s\n", argv[i]);
+                                goto create_failed_with_obj;
+                        }
+                }
+                else {
+                        if(obj->cnt >= STREAM_MAX) {
+                                fprintf(stderr, "Too many URL, %d at most!\n", STREAM_MAX);
+                                goto create_failed_with_obj;
+                        }
+                        obj->stream[obj->cnt].name = argv[i];
+                        obj->cnt++;
+                }
+        }
+
+        if(0 == obj->cnt) {
+                fprintf(stderr, "No URL to process...\n");
+                goto create_failed_with_obj;
+        }
+
+        for(i = 0; i < obj->cnt; i++) {
+                if(0 != open_stream(obj, &(obj->stream[i]))) {
+                        obj->cnt = i; /* close the opened streams only */
+                        destroy(obj);
+                        return NULL;
+                }
+        }
+        return obj;
+
+create_failed_with_obj:
+        free(obj);
+        return NULL;
+}
+
+static int destroy(struct tsmon_obj *obj)
+{
+        int i;
+
+        if(NULL == obj) {
+                return 0;
+        }
+
+        for(i = 0; i < obj->cnt; i++) {
+                close_stream(&(obj->stream[i]));
+        }
+        free(obj);
+        return 1;
+}
+
+static int open_stream(struct tsmon_obj *obj, struct stream *s)
+{
+        struct ts_cfg cfg;
+
+        s->url = url_open(s->name, "rb");
+        if(NULL == s->url) {
+                RPT(RPT_ERR, "open \"%s\" failed", s->name);
+                return -1;
+        }
+        if(SCH_UDP != s->url->scheme) {
+                RPT(RPT_ERR, "\"%s\" is not udp://...", s->name);
+                goto open_failed_with_url;
+        }
+
+        /* each stream has its own memory pool, so one stream can not use up memory of others */
+        s->mp = buddy_create(obj->mp_order, 6);
+        if(0 == s->mp) {
+                RPT(RPT_ERR, "malloc memory pool for \"%s\" failed", s->name);
+                goto open_failed_with_url;
+        }
+        buddy_init(s->mp);
+
+        s->ts = ts_create(s->mp);
+        if(0 == s->ts) {
+                RPT(RPT_ERR, "malloc ts object for \"%s\" failed", s->name);
+                goto open_failed_with_mp;
+        }
+        memset(&cfg, 1, sizeof(struct ts_cfg));
+        cfg.crc_sample = ((0 == obj->crc_sample) ? -1 : obj->crc_sample); /* -crc 0: never */
+        ts_ioctl(s->ts, TS_INIT, 0);
+        ts_ioctl(s->ts, TS_SCFG, (intptr_t)&cfg);
+        s->ts->aim_interval = 1000 * STC_MS;
+
+        s->byte = 0;
+        s->drop = 0;
+        memset(s->lcnt, 0, sizeof(s->lcnt));
+        return 0;
+
+open_failed_with_mp:
+        buddy_destroy(s->mp);
+open_failed_with_url:
+        url_close(s->url);
+        return -1;
+}
+
+static int close_stream(struct stream *s)
+{
+        ts_destroy(s->ts);
+        buddy_destroy(s->mp);
+        url_close(s->url);
+        return 0;
+}
+
+static int64_t now_ms(void)
+{
+        struct timespec tp;
+
+        clock_gettime(CLOCK_MONOTONIC, &tp);
+        return (int64_t)(tp.tv_sec) * 1000 + tp.tv_nsec / 1000000;
+}
+
+static void on_signal(int sig)
+{
+        is_exit = 1;
+        return;
+}
+
+static void show_help()
+{
+        puts("'tsmon' monitor many TS over IP in one process, report error and bit-rate to stdout.");
+        puts("");
+        puts("Usage: tsmon [OPTION]... udp://*@*:*...");
+        puts("");
+        puts("Options:");
+        puts("");
+        puts(" -interval <iv>   report interval, default: 1000ms, [1, ...]");
+        puts(" -mp <order>      memory pool arena size of each stream: 2^order byte, default: 20, [12, 30]");
+        puts(" -crc <n>         check CRC_32 of 1 in n repeated section, 0: never, default: 1");
+        puts(" -h, --help       print this information only");
+        puts(" -v, --version    print my version only");
+        puts("");
+        puts("Report for each stream in each interval:");
+        puts("  \"*mon, URL, *rate, interval(ms), bitrate(Mbps), \"");
+        puts("  \"*err, 1.1, 1.2, 1.3, 1.4, 1.5, 1.6, 2.1, 2.2, 2.3a, 2.3b, 2.4, 2.5, 2.6, \"");
+        puts("  \"      3.1a, 3.1b, 3.2, 3.3, 3.4, 3.4a, 3.5a, 3.5b, 3.6a, 3.6b, 3.6c, 3.7, 3.8, 3.9, 3.10, \"");
+        puts("      packet count of each TR 101 290 error");
+        puts("  \"*drop, byte, \" if some data in datagram is not TS packet");
+        puts("");
+        puts("Examples:");
+        puts("  tsmon udp://224.165.54.31:1234 udp://224.165.54.32:1234");
+        puts("  tsmon -interval 5000 udp://192.165.54.36@224.165.54.31:1234");
+        puts("");
+        puts("Report bugs to <zhoucheng@tsinghua.org.cn>.");
+        return;
+}
+
+static void show_version()
+{
+        char str[100];
+
+        sprintf(str, "tsmon of tstools v%s (%s)", VERSION_STR, REVISION);
+        puts(str);
+        sprintf(str, "Build time: %s %s", __DATE__, __TIME__);
+        puts(str);
+        puts("");
+        puts("Copyright (C) 2009,2010,2011,2012,2013 ZHOU Cheng.");
+        puts("License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>");
+        puts("This is free software; contact author for additional information.");
+        puts("There is NO warranty; not even for MERCHANTABILITY or FITNESS FOR");
+        puts("A PARTICULAR PURPOSE.");
+        puts("");
+        puts("Written by ZHOU Cheng.");
+        return;
+}
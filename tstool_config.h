@@ -0,0 +1,9 @@
+#define TSTOOL_XML 1
+
+#define VER_MAJOR 1
+#define VER_MINOR 0
+#define VER_RELEA 0
+#define VERSION 1.0.0
+#define VERSION_STR "1.0.0"
+#define LOCALVER 1
+#define REVISION "git_not_found"